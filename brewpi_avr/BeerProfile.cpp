@@ -0,0 +1,118 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "BeerProfile.h"
+#include "EepromAccess.h"
+#include <stddef.h>
+
+void BeerProfile::unload(void){
+	address = INVALID_EPTR;
+	count = 0;
+	segment = 0;
+	minutes = 0;
+	millis = 0;
+	lastUpdate = 0;
+	from.minutes = 0;
+	from.temp = INVALID_TEMP;
+	to = from;
+}
+
+void BeerProfile::load(eptr_t address, ticks_millis_t now){
+	unload();
+	this->address = address;
+	lastUpdate = now;
+	uint8_t stored = eepromAccess.readByte(address+offsetof(ProfileBlock, count));
+	if(stored == 0 || stored > ProfileBlock::MAX_POINTS){
+		return;	// no profile, or an erased eeprom
+	}
+	count = stored;
+	eepromAccess.readBlock(&minutes, address+offsetof(ProfileBlock, minutes), sizeof(minutes));
+	seek();
+}
+
+void BeerProfile::getPoint(uint8_t index, ProfilePoint& point){
+	eepromAccess.readBlock(&point, address+offsetof(ProfileBlock, points)+index*sizeof(ProfilePoint), sizeof(ProfilePoint));
+}
+
+// Finds the segment the profile time is in. Before the first point that is the first segment, after the last point
+// both points are the last one.
+void BeerProfile::seek(void){
+	segment = 0;
+	getPoint(0, from);
+	for(uint8_t i=1; i<count; i++){
+		getPoint(i, to);
+		if(to.minutes > minutes){
+			return;
+		}
+		segment = i;
+		from = to;
+	}
+	to = from;
+}
+
+temperature BeerProfile::interpolate(void){
+	if(minutes <= from.minutes || to.minutes == from.minutes){
+		return from.temp;
+	}
+	// the profile time is within the segment, so the step is at most the difference of the points. The difference
+	// and the time into the segment are both below 2^16, so their product fits in an unsigned 32 bit number.
+	int32_t difference = int32_t(to.temp) - from.temp;
+	uint32_t step = uint32_t(difference < 0 ? -difference : difference)*uint16_t(minutes - from.minutes);
+	step /= uint16_t(to.minutes - from.minutes);
+	return temperature(difference < 0 ? from.temp - int32_t(step) : from.temp + int32_t(step));
+}
+
+temperature BeerProfile::update(ticks_millis_t now){
+	uint32_t elapsed = millis + (now - lastUpdate);
+	lastUpdate = now;
+	if(elapsed < 60000){
+		millis = elapsed;
+		return interpolate();
+	}
+	millis = elapsed % 60000;
+	uint32_t newMinutes = minutes + elapsed/60000;
+	if(newMinutes > 0xFFFF){
+		newMinutes = 0xFFFF;
+	}
+	bool store = newMinutes/BEER_PROFILE_STORE_MINUTES != minutes/BEER_PROFILE_STORE_MINUTES;
+	minutes = newMinutes;
+	if(store){
+		storeMinutes();
+	}
+	if(minutes >= to.minutes && !isFinished()){
+		seek();
+	}
+	return interpolate();
+}
+
+void BeerProfile::setMinutes(uint16_t minutes){
+	this->minutes = minutes;
+	millis = 0;
+	storeMinutes();
+	if(count){
+		seek();
+	}
+}
+
+void BeerProfile::storeMinutes(void){
+	if(address != INVALID_EPTR){
+		eepromAccess.writeBlock(address+offsetof(ProfileBlock, minutes), &minutes, sizeof(minutes));
+	}
+}
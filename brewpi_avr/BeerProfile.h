@@ -0,0 +1,109 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+#include "EepromTypes.h"
+#include "Ticks.h"
+
+// The progress of a running profile is written to the eeprom this often. A power failure loses at most this much.
+// Once an hour wears an eeprom cell out in about 11 years of profiles running back to back.
+#define BEER_PROFILE_STORE_MINUTES 60
+
+struct ProfilePoint{
+	uint16_t minutes;	// since the start of the profile
+	temperature temp;
+};
+
+/*
+ * The eeprom block of a profile. It was unused, so it reads as an empty profile in existing eeproms.
+ */
+struct ProfileBlock{
+	static const uint8_t MAX_POINTS = 15;
+	uint8_t count;		// number of points, 0 when there is no profile
+	uint8_t reserved;
+	uint16_t minutes;	// progress, stored every BEER_PROFILE_STORE_MINUTES
+	ProfilePoint points[MAX_POINTS];	// in increasing time
+};
+
+/*
+ * BeerProfile follows a beer temperature profile stored in the eeprom: the beer setting is interpolated linearly between
+ * the points on each side of the profile time, and holds at the last point once the profile is finished.
+ * Only the two points of the active segment are kept in RAM, the others are read from the eeprom when the profile
+ * moves on to the next segment.
+ * The profile time runs on the controller clock while the controller runs, whatever the mode, like a profile run by
+ * the script runs from its start date.
+ */
+class BeerProfile{
+	public:
+	BeerProfile(){
+		unload();
+	}
+
+	// Reads the profile stored at address and continues it from the progress stored with it.
+	void load(eptr_t address, ticks_millis_t now);
+
+	void unload(void);
+
+	bool isActive(void){
+		return count != 0;
+	}
+
+	// Advances the profile time to now and returns the beer setting for it.
+	temperature update(ticks_millis_t now);
+
+	// Moves the profile to the given time, for example to where the script knows it should be after a power failure.
+	void setMinutes(uint16_t minutes);
+
+	uint16_t getMinutes(void){
+		return minutes;
+	}
+
+	uint8_t getCount(void){
+		return count;
+	}
+
+	// The active segment runs from this point to the next, counted from 0.
+	uint8_t getSegment(void){
+		return segment;
+	}
+
+	bool isFinished(void){
+		return segment+1 >= count && minutes >= from.minutes;
+	}
+
+	// Reads a point from the eeprom. index must be below getCount().
+	void getPoint(uint8_t index, ProfilePoint& point);
+
+	private:
+	void seek(void);
+	temperature interpolate(void);
+	void storeMinutes(void);
+
+	eptr_t address;		// INVALID_EPTR when not loaded from the eeprom
+	uint8_t count;
+	uint8_t segment;
+	ProfilePoint from;	// the points around the profile time
+	ProfilePoint to;
+	uint16_t minutes;	// profile time
+	uint16_t millis;	// into the current minute
+	ticks_millis_t lastUpdate;
+};
@@ -40,11 +40,17 @@
 #include "Ticks.h"
 #include "Sensor.h"
 #include "SettingsManager.h"
+#include "ChamberManager.h"
+#include "LoopTiming.h"
 
 #if BREWPI_SIMULATE
 	#include "Simulator.h"
 #endif
 
+#if BREWPI_TRACE
+	#include "TraceRecorder.h"
+#endif
+
 // global class objects static and defined in class cpp and h files
 
 // instantiate and configure the sensors, actuators and controllers we want to use
@@ -73,7 +79,7 @@ void setup()
 	piLink.init();
 
 	logDebug("started");	
-	tempControl.init();
+	chamberManager.init();
 	settingsManager.loadSettings();
 	
 #if BREWPI_SIMULATE
@@ -98,22 +104,35 @@ void brewpiLoop(void)
 	static unsigned long lastUpdate = 0;
 	uint8_t oldState;
 			
-	if(ticks.millis() - lastUpdate >= (1000)) { //update settings every second
+	if(ticks.millis() - lastUpdate >= tempControl.getTickTime()) { //update settings every tick, a second by default
 		lastUpdate = ticks.millis();
+#if BREWPI_LOOP_TIMING
+		uint32_t tickStart = micros();
+#endif
 
 #if BREWPI_BUZZER
 		buzzer.setActive(alarm.isActive() && !buzzer.isActive());
 #endif			
 			
-		tempControl.updateTemperatures();
-		tempControl.detectPeaks();
-		tempControl.updatePID();
-		oldState = tempControl.getState();
-		tempControl.updateState();
-		if(oldState != tempControl.getState()){
-			piLink.printTemperatures(); // add a data point at every state transition
+		for (uint8_t chamber=0; chamber<chamberManager.count(); chamber++) {
+			chamberManager.switchTo(chamber);
+			LOOP_TIMED(PHASE_TEMPERATURES, tempControl.updateTemperatures());
+			LOOP_TIMED(PHASE_PEAKS, tempControl.detectPeaks());
+			LOOP_TIMED(PHASE_PID, tempControl.updatePID());
+			oldState = tempControl.getState();
+			LOOP_TIMED(PHASE_STATE, tempControl.updateState());
+			if(oldState != tempControl.getState()){
+				piLink.printTemperatures(); // add a data point at every state transition
+			}
+			LOOP_TIMED(PHASE_OUTPUTS, tempControl.updateOutputs());
+
+#if BREWPI_TRACE
+			if (chamber==0)		// the trace follows the first chamber
+				traceRecorder.record(tempControl, ticks.millis());
+#endif
 		}
-		tempControl.updateOutputs();
+		// the serial link, menu and display work on the selected chamber until the next tick
+		chamberManager.switchTo(chamberManager.getSelected());
 
 #if BREWPI_MENU
 		if(rotaryEncoder.pushed()){
@@ -123,14 +142,21 @@ void brewpiLoop(void)
 #endif
 
 		// update the lcd for the chamber being displayed
-		display.printState();
-		display.printAllTemperatures();
-		display.printMode();
-		display.updateBacklight();		
+		LOOP_TIMED(PHASE_DISPLAY,
+			display.printState();
+			display.printAllTemperatures();
+			display.printMode();
+			display.updateBacklight();
+		);
+#if BREWPI_LOOP_TIMING
+		loopTiming.record(PHASE_TICK, micros()-tickStart);
+#endif
 	}	
 
 	//listen for incoming serial connections while waiting to update
-	piLink.receive();
+	//only passes with input are timed, the idle ones would fill the histogram
+	if(piLink.hasInput())
+		LOOP_TIMED(PHASE_RECEIVE, piLink.receive());
 
 }
 
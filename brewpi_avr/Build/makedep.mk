@@ -6,12 +6,18 @@ Actuator.cpp
 
 ArduinoFunctions.cpp
 
+BeerProfile.cpp
+
 Brewpi.cpp
 
 BrewpiStrings.cpp
 
 Buzzer.cpp
 
+ChamberManager.cpp
+
+ControlKpi.cpp
+
 DallasTemperature.cpp
 
 DeviceManager.cpp
@@ -30,6 +36,8 @@ FilterFixed.cpp
 
 Logger.cpp
 
+LoopTiming.cpp
+
 Main.cpp
 
 Menu.cpp
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "ChamberManager.h"
+#include "EepromFormat.h"
+#include "EepromManager.h"
+#include "DeviceManager.h"
+#include "TempSensorDisconnected.h"
+
+ChamberManager chamberManager;
+
+// the chambers must fit in the eeprom layout
+typedef char chambersFitInEeprom[BREWPI_CHAMBERS<=EepromFormat::MAX_CHAMBERS ? 1 : -1];
+
+extern ValueSensor<bool> defaultSensor;
+extern ValueActuator defaultActuator;
+extern DisconnectedTempSensor defaultTempSensor;
+
+uint8_t ChamberManager::currentChamber = 0;
+uint8_t ChamberManager::selectedChamber = 0;
+uint8_t ChamberManager::activeBeers[BREWPI_CHAMBERS];
+ChamberContext ChamberManager::contexts[BREWPI_CHAMBERS];
+
+void TempControlState::save(TempControl& control)
+{
+	cc = control.cc;
+	cs = control.cs;
+	cv = control.cv;
+	storedBeerSetting = control.storedBeerSetting;
+	lastIdleTime = control.lastIdleTime;
+	lastHeatTime = control.lastHeatTime;
+	lastCoolTime = control.lastCoolTime;
+	waitTime = control.waitTime;
+	integralUpdateCounter = control.integralUpdateCounter;
+	state = control.state;
+	doPosPeakDetect = control.doPosPeakDetect;
+	doNegPeakDetect = control.doNegPeakDetect;
+	doorOpen = control.doorOpen;
+#if BREWPI_ENERGY_METER
+	heaterOnTime = control.heaterOnTime;
+	coolerOnTime = control.coolerOnTime;
+	lastMeterTime = control.lastMeterTime;
+#endif
+#if BREWPI_CONTROL_KPI
+	kpi = control.kpi;
+#endif
+#if BREWPI_BEER_PROFILE
+	profile = control.profile;
+#endif
+#if BREWPI_INCREMENTAL_CONTROL
+	pidInputs = control.pidInputs;
+	stateInputs = control.stateInputs;
+	stateEvaluated = control.stateEvaluated;
+	stateStableTime = control.stateStableTime;
+	stateWaitTime = control.stateWaitTime;
+	stateWaitCounts = control.stateWaitCounts;
+#endif
+}
+
+void TempControlState::restore(TempControl& control) const
+{
+	control.cc = cc;
+	control.cs = cs;
+	control.cv = cv;
+	control.storedBeerSetting = storedBeerSetting;
+	control.lastIdleTime = lastIdleTime;
+	control.lastHeatTime = lastHeatTime;
+	control.lastCoolTime = lastCoolTime;
+	control.waitTime = waitTime;
+	control.integralUpdateCounter = integralUpdateCounter;
+	control.state = state;
+	control.doPosPeakDetect = doPosPeakDetect;
+	control.doNegPeakDetect = doNegPeakDetect;
+	control.doorOpen = doorOpen;
+#if BREWPI_ENERGY_METER
+	control.heaterOnTime = heaterOnTime;
+	control.coolerOnTime = coolerOnTime;
+	control.lastMeterTime = lastMeterTime;
+#endif
+#if BREWPI_CONTROL_KPI
+	control.kpi = kpi;
+#endif
+#if BREWPI_BEER_PROFILE
+	control.profile = profile;
+#endif
+#if BREWPI_INCREMENTAL_CONTROL
+	control.pidInputs = pidInputs;
+	control.stateInputs = stateInputs;
+	control.stateEvaluated = stateEvaluated;
+	control.stateStableTime = stateStableTime;
+	control.stateWaitTime = stateWaitTime;
+	control.stateWaitCounts = stateWaitCounts;
+#endif
+}
+
+ChamberContext::ChamberContext()
+	: beerSensor(NULL), fridgeSensor(NULL), ambientSensor(&defaultTempSensor),
+	heater(&defaultActuator), cooler(&defaultActuator), light(&defaultActuator), fan(&defaultActuator),
+	door(&defaultSensor)
+{
+}
+
+void ChamberManager::init()
+{
+	// a chamber without sensors gets its own TempSensor wrappers from init(), so the filters are not shared
+	for (uint8_t c=0; c<count(); c++) {
+		switchTo(c);
+		tempControl.init();
+	}
+	selectedChamber = 0;
+	switchTo(0);
+}
+
+bool ChamberManager::select(uint8_t chamber)
+{
+	if (chamber>=count())
+		return false;
+	selectedChamber = chamber;
+	switchTo(chamber);
+	return true;
+}
+
+void ChamberManager::swap(uint8_t chamber)
+{
+	ChamberContext& out = contexts[currentChamber];
+	out.control.save(tempControl);
+	out.beerSensor = tempControl.beerSensor;
+	out.fridgeSensor = tempControl.fridgeSensor;
+	out.ambientSensor = tempControl.ambientSensor;
+	out.heater = tempControl.heater;
+	out.cooler = tempControl.cooler;
+	out.light = tempControl.light;
+	out.fan = tempControl.fan;
+	out.door = tempControl.door;
+	
+	const ChamberContext& in = contexts[chamber];
+	in.control.restore(tempControl);
+	tempControl.beerSensor = in.beerSensor;
+	tempControl.fridgeSensor = in.fridgeSensor;
+	tempControl.ambientSensor = in.ambientSensor;
+	tempControl.heater = in.heater;
+	tempControl.cooler = in.cooler;
+	tempControl.light = in.light;
+	tempControl.fan = in.fan;
+	tempControl.door = in.door;
+	currentChamber = chamber;
+}
+
+void ChamberManager::loadActiveBeers()
+{
+	for (uint8_t c=0; c<count(); c++) {
+		uint8_t beer = eepromAccess.readByte(eepromManager.activeBeerOffset(c));
+		activeBeers[c] = beer<ChamberBlock::MAX_BEERS ? beer : 0;
+	}
+}
+
+bool ChamberManager::setActiveBeer(uint8_t beer)
+{
+	if (beer>=ChamberBlock::MAX_BEERS || !eepromManager.hasSettings())
+		return false;
+	uint8_t chamber = currentChamber;
+	if (beer==activeBeers[chamber])
+		return true;
+	
+	eepromManager.storeTempSettings();
+	
+	// remove the devices of the old beer while it is still active, so they are found
+	DeviceConfig cfg;
+	clear((uint8_t*)&cfg, sizeof(cfg));
+	cfg.chamber = chamber+1;
+	cfg.beer = activeBeers[chamber]+1;
+	for (uint8_t f=DEVICE_BEER_FIRST; f<DEVICE_MAX; f++) {
+		cfg.deviceFunction = DeviceFunction(f);
+		deviceManager.uninstallDevice(cfg);
+	}
+	
+	activeBeers[chamber] = beer;
+	eepromAccess.writeByte(eepromManager.activeBeerOffset(chamber), beer);
+	tempControl.loadSettings(eepromManager.beerSettingsOffset(chamber, beer));
+	eepromManager.installDevices(chamber+1, beer+1);
+	return true;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TempControl.h"
+
+/**
+ * Everything a TempControl carries from one control tick to the next: constants, settings, variables, timers,
+ * the state machine and the control quality indicators. The sensors, actuators and clock it points to are not included.
+ */
+class TempControlState
+{
+public:
+	void save(TempControl& control);
+
+	/**
+	 * Restores the state into a controller, which can be another controller than the one it was saved from.
+	 */
+	void restore(TempControl& control) const;
+
+private:
+	ControlConstants cc;
+	ControlSettings cs;
+	ControlVariables cv;
+	temperature storedBeerSetting;
+	uint16_t lastIdleTime;
+	uint16_t lastHeatTime;
+	uint16_t lastCoolTime;
+	uint16_t waitTime;
+	uint16_t integralUpdateCounter;
+	uint8_t state;
+	bool doPosPeakDetect;
+	bool doNegPeakDetect;
+	bool doorOpen;
+#if BREWPI_ENERGY_METER
+	uint32_t heaterOnTime;
+	uint32_t coolerOnTime;
+	ticks_seconds_t lastMeterTime;
+#endif
+#if BREWPI_CONTROL_KPI
+	ControlKpi kpi;
+#endif
+#if BREWPI_BEER_PROFILE
+	BeerProfile profile;
+#endif
+#if BREWPI_INCREMENTAL_CONTROL
+	PidInputs pidInputs;
+	StateInputs stateInputs;
+	ticks_seconds_t stateEvaluated;
+	uint16_t stateStableTime;
+	uint16_t stateWaitTime;
+	bool stateWaitCounts;
+#endif
+};
+
+/**
+ * A chamber while it is not swapped into tempControl: its control state and its devices.
+ * The device fields have the same names as in TempControl, so the device manager can install into either.
+ */
+struct ChamberContext
+{
+	ChamberContext();
+
+	TempControlState control;
+	TempSensor* beerSensor;
+	TempSensor* fridgeSensor;
+	BasicTempSensor* ambientSensor;
+	Actuator* heater;
+	Actuator* cooler;
+	Actuator* light;
+	Actuator* fan;
+	Sensor<bool>* door;
+};
+
+/**
+ * Runs several chambers on the single tempControl. The chamber being controlled is swapped into tempControl and the
+ * others wait in a ChamberContext, so the control code keeps working against compile-time resolvable memory (see the
+ * MDM note in TempControl.h). Each control tick visits every chamber. In between, the selected chamber is swapped in,
+ * so the serial link, display and menu work on the chamber that was last addressed with the '@' command.
+ *
+ * Each chamber controls one beer at a time. The active beer picks the beer settings block in the eeprom and which
+ * beer devices are installed.
+ */
+class ChamberManager
+{
+public:
+	/**
+	 * Initializes the controller of every chamber and selects the first.
+	 */
+	static void init();
+
+	static uint8_t count() { return BREWPI_CHAMBERS; }
+
+	/**
+	 * The chamber that is swapped into tempControl, counted from 0.
+	 */
+	static uint8_t current() { return currentChamber; }
+
+	/**
+	 * Swaps the given chamber into tempControl.
+	 */
+	static void switchTo(uint8_t chamber) {
+		if (chamber!=currentChamber)
+			swap(chamber);
+	}
+
+	static uint8_t getSelected() { return selectedChamber; }
+
+	/**
+	 * Selects and swaps in the chamber that the serial link, display and menu work on.
+	 * @return false when there is no such chamber.
+	 */
+	static bool select(uint8_t chamber);
+
+	/**
+	 * The waiting state of a chamber that is not swapped in.
+	 */
+	static ChamberContext& context(uint8_t chamber) { return contexts[chamber]; }
+
+	/**
+	 * The beer a chamber controls, counted from 0.
+	 */
+	static uint8_t activeBeer(uint8_t chamber) { return activeBeers[chamber]; }
+
+	/**
+	 * Reads the active beer of every chamber from the eeprom.
+	 */
+	static void loadActiveBeers();
+
+	/**
+	 * Changes the beer of the current chamber: the settings of the old beer are stored, its devices removed and the
+	 * settings and devices of the new beer loaded from the eeprom.
+	 * @return false when the beer is out of range or the eeprom has no settings.
+	 */
+	static bool setActiveBeer(uint8_t beer);
+
+private:
+	static void swap(uint8_t chamber);
+
+	static uint8_t currentChamber;
+	static uint8_t selectedChamber;
+	static uint8_t activeBeers[BREWPI_CHAMBERS];
+	static ChamberContext contexts[BREWPI_CHAMBERS];
+};
+
+extern ChamberManager chamberManager;
@@ -97,6 +97,35 @@
 #define BREWPI_SIMULATE 0
 #endif
 
+/**
+ * Record every control tick to a binary trace file. Only available in host builds, which have a file system.
+ */
+#ifndef BREWPI_TRACE
+#define BREWPI_TRACE 0
+#endif
+
+/**
+ * Keep control quality indicators (beer error, overshoot, settling, cycles, duty and state times) and report them with the 'k' command. Costs flash and RAM, so off by default.
+ */
+#ifndef BREWPI_CONTROL_KPI
+#define BREWPI_CONTROL_KPI 0
+#endif
+
+/**
+ * Time each phase of the main loop and keep a histogram of the durations, reported with the 'm' command. Costs about
+ * 400 bytes of RAM, so off by default.
+ */
+#ifndef BREWPI_LOOP_TIMING
+#define BREWPI_LOOP_TIMING 0
+#endif
+
+/**
+ * Meter the energy used by the heater and cooler, from their on-time and the power set in the control constants.
+ */
+#ifndef BREWPI_ENERGY_METER
+#define BREWPI_ENERGY_METER 0
+#endif
+
 /**
  * Enable DS2413 Actuators. 
  */
@@ -166,6 +195,50 @@
 
 #endif // ifndef BREWPI_BOARD
 
+/**
+ * Number of chambers controlled, each with its own sensors, actuators and settings. At most the 4 chambers in the
+ * eeprom, and every chamber costs RAM for its swapped out control state, so more than one fits only on the Mega.
+ * With more than one, the temperature reports carry the chamber number, so the script has to support that.
+ */
+#ifndef BREWPI_CHAMBERS
+#define BREWPI_CHAMBERS 1
+#endif
+
+/**
+ * Skip the work of updatePID and updateState when none of their inputs changed and no wait time ran out since they
+ * last ran. The outcome is the same as evaluating every tick. Costs about 60 bytes of RAM per chamber, so it is on by
+ * default only with several chambers.
+ */
+#ifndef BREWPI_INCREMENTAL_CONTROL
+#define BREWPI_INCREMENTAL_CONTROL (BREWPI_CHAMBERS>1)
+#endif
+
+/**
+ * Time between two runs of the control loop in milliseconds, from 100 to 1000 and best a divisor of 1000. The slope,
+ * integrator, filters and timers are derived from it, so the control behaves the same in time, except that the fridge
+ * air is followed more closely with a shorter tick. A 12 bit DS18B20 needs 750 ms for a conversion, so ticks shorter
+ * than that need the sensors at a lower resolution to see a new value every tick.
+ */
+#ifndef BREWPI_TICK_MILLIS
+#define BREWPI_TICK_MILLIS 1000
+#endif
+
+// A DS18B20 needs about 100 ms for a conversion even at 9 bits, so a shorter tick only repeats values
+#define MIN_TICK_MILLIS 100
+#define MAX_TICK_MILLIS 1000
+#if BREWPI_TICK_MILLIS < MIN_TICK_MILLIS || BREWPI_TICK_MILLIS > MAX_TICK_MILLIS
+#error "BREWPI_TICK_MILLIS must be from 100 to 1000"
+#endif
+
+/**
+ * Follow a beer temperature profile stored in the eeprom in beer profile mode, so the profile keeps running when the
+ * script or the serial link is down. Each chamber has room for one profile, uploaded with the 'P' command and reported
+ * with 'p'. The eeprom space is reserved either way. Costs flash, so on by default only on the Mega.
+ */
+#ifndef BREWPI_BEER_PROFILE
+#define BREWPI_BEER_PROFILE (BREWPI_BOARD==BREWPI_BOARD_MEGA)
+#endif
+
 #ifndef OPTIMIZE_GLOBAL
 #define OPTIMIZE_GLOBAL 1
 #endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Brewpi.h"
+#include "ControlKpi.h"
+#include "TempControl.h"
+#include <math.h>
+#include <string.h>
+
+// stateTicks is indexed by the TempControl states
+typedef char kpiStatesMatch[(KPI_NUM_STATES == NUM_STATES) ? 1 : -1];
+
+void ControlKpi::reset(void){
+	memset(this, 0, sizeof(*this));
+	// the current setting is seen as a new setting on the next tick, settling is measured from the reset
+	lastSetting = INVALID_TEMP;
+	lastError = INVALID_TEMP;
+}
+
+void ControlKpi::update(temperature beerTemp, temperature beerSetting, uint8_t state, bool heating, bool cooling){
+	ticks++;
+	if(beerSetting != lastSetting){
+		// a new setting restarts overshoot and settling
+		lastSetting = beerSetting;
+		fromBelow = beerTemp < beerSetting;
+		overshoot = 0;
+		settingTick = ticks - 1;
+		settledTick = settingTick;
+	}
+
+	lastError = INVALID_TEMP;
+	if(beerSetting != INVALID_TEMP && beerTemp != INVALID_TEMP){
+		long_temperature error = long_temperature(beerTemp) - beerSetting;
+		lastError = error;
+		errorTicks++;
+		sumSquaredError += uint64_t(int64_t(error)*error);
+
+		long_temperature past = fromBelow ? error : -error;
+		if(past > overshoot){
+			overshoot = past;
+		}
+		if(error > KPI_SETTLE_BAND || error < -KPI_SETTLE_BAND){
+			settledTick = ticks;
+		}
+	}
+
+	if(heating && !wasHeating){
+		heatCycles++;
+	}
+	if(cooling && !wasCooling){
+		coolCycles++;
+	}
+	wasHeating = heating;
+	wasCooling = cooling;
+	if(heating){
+		heatTicks++;
+	}
+	if(cooling){
+		coolTicks++;
+	}
+	if(state < KPI_NUM_STATES){
+		stateTicks[state]++;
+	}
+	lastState = state;
+}
+
+void ControlKpi::repeat(uint32_t count){
+	if(!ticks){
+		return; // no tick to repeat
+	}
+	ticks += count;
+	if(lastError != INVALID_TEMP){
+		errorTicks += count;
+		sumSquaredError += uint64_t(int64_t(lastError)*lastError)*count;
+		if(lastError > KPI_SETTLE_BAND || lastError < -KPI_SETTLE_BAND){
+			settledTick = ticks;
+		}
+	}
+	if(wasHeating){
+		heatTicks += count;
+	}
+	if(wasCooling){
+		coolTicks += count;
+	}
+	if(lastState < KPI_NUM_STATES){
+		stateTicks[lastState] += count;
+	}
+}
+
+long_temperature ControlKpi::getRmsError(void){
+	if(!errorTicks){
+		return 0;
+	}
+	return long_temperature(sqrt(double(sumSquaredError)/errorTicks) + 0.5);
+}
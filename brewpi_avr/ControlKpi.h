@@ -0,0 +1,117 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+
+// The beer has settled when it stays within this distance of the setting: 0.25 degree
+#define KPI_SETTLE_BAND (TEMP_FIXED_POINT_SCALE/4)
+
+// Number of states tracked. Must match NUM_STATES in TempControl.h, which includes this file.
+#define KPI_NUM_STATES 10
+
+/*
+ * ControlKpi keeps running control quality indicators. It is updated once per control tick in constant time and
+ * memory, so it can run on the controller itself and in long simulations without storing any history.
+ * All times are counted in control ticks, which are seconds unless BREWPI_TICK_MILLIS is set shorter.
+ */
+class ControlKpi{
+	public:
+	ControlKpi(){
+		reset();
+	}
+
+	void reset(void);
+
+	// Accounts one control tick. The beer error is only tracked when beerSetting is valid, so in beer modes.
+	void update(temperature beerTemp, temperature beerSetting, uint8_t state, bool heating, bool cooling);
+
+	// Accounts count more ticks that are identical to the last one, for simulations that skip quiet ticks.
+	void repeat(uint32_t count);
+
+	uint32_t getTicks(void){
+		return ticks;
+	}
+
+	// Root mean square of the beer error, over all ticks with a valid beer setting and temperature.
+	long_temperature getRmsError(void);
+
+	// Largest excursion of the beer temperature past the setting since the setting last changed.
+	long_temperature getOvershoot(void){
+		return overshoot;
+	}
+
+	// Ticks from the last setting change until the beer last left the settle band. 0 if it never did.
+	uint32_t getSettlingTime(void){
+		return settledTick - settingTick;
+	}
+
+	uint16_t getHeatCycles(void){
+		return heatCycles;
+	}
+	uint16_t getCoolCycles(void){
+		return coolCycles;
+	}
+
+	uint32_t getHeatTime(void){
+		return heatTicks;
+	}
+	uint32_t getCoolTime(void){
+		return coolTicks;
+	}
+
+	// duty cycles in 1/1000
+	uint16_t getHeatDuty(void){
+		return permille(heatTicks);
+	}
+	uint16_t getCoolDuty(void){
+		return permille(coolTicks);
+	}
+
+	uint32_t getStateTime(uint8_t state){
+		return stateTicks[state];
+	}
+
+	private:
+	uint16_t permille(uint32_t part){
+		return ticks ? uint16_t((uint64_t(part)*1000)/ticks) : 0;
+	}
+
+	uint32_t ticks;
+	uint32_t errorTicks;
+	uint64_t sumSquaredError;	// in (1/512 degree)^2, 32 bits would overflow within hours of a large error
+
+	temperature lastSetting;
+	long_temperature lastError;	// INVALID_TEMP when the last tick had no beer error
+	long_temperature overshoot;
+	bool fromBelow;			// the beer approached the last setting from below
+	uint32_t settingTick;	// tick of the last setting change
+	uint32_t settledTick;	// tick after the last one outside the settle band
+
+	uint8_t lastState;
+	bool wasHeating;
+	bool wasCooling;
+	uint16_t heatCycles;
+	uint16_t coolCycles;
+	uint32_t heatTicks;
+	uint32_t coolTicks;
+	uint32_t stateTicks[KPI_NUM_STATES];
+};
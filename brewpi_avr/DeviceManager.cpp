@@ -28,6 +28,7 @@
 #include "TempSensorExternal.h"
 #include "PiLink.h"
 #include "EepromFormat.h"
+#include "ChamberManager.h"
 
 #define CALIBRATION_OFFSET_PRECISION (4)
 
@@ -86,14 +87,15 @@ bool DeviceManager::isDefaultTempSensor(BasicTempSensor* sensor) {
  */
 void DeviceManager::setupUnconfiguredDevices()
 {	
-	// right now, uninstall doesn't care about chamber/beer distinction.
-	// but this will need to match beer/function when multiferment is available
+	// the devices of every chamber, and of the beer each chamber controls
 	DeviceConfig cfg;	
-	cfg.chamber = 1; cfg.beer = 1;		
-	for (uint8_t i=0; i<DEVICE_MAX; i++) {
-		cfg.deviceFunction = DeviceFunction(i);
-		uninstallDevice(cfg);
-	}			
+	for (uint8_t c=0; c<chamberManager.count(); c++) {
+		cfg.chamber = c+1; cfg.beer = chamberManager.activeBeer(c)+1;
+		for (uint8_t i=0; i<DEVICE_MAX; i++) {
+			cfg.deviceFunction = DeviceFunction(i);
+			uninstallDevice(cfg);
+		}
+	}
 }
 
 
@@ -143,43 +145,37 @@ void* DeviceManager::createDevice(DeviceConfig& config, DeviceType dt)
 }
 
 /**
- * Returns the pointer to where the device pointer resides. This can be used to delete the current device and install a new one. 
- * For Temperature sensors, the returned pointer points to a TempSensor*. The basic device can be fetched by calling
- * TempSensor::getSensor().
+ * Returns the pointer to where the device pointer of a function resides in a TempControl or a ChamberContext, which
+ * name their device fields the same.
  */
-inline void** deviceTarget(DeviceConfig& config)
+template<class Devices> void** deviceField(Devices& devices, DeviceFunction function)
 {
-	// for multichamber, will write directly to the multi-chamber managed storage.
-	// later...	
-	if (config.chamber>1 || config.beer>1)
-		return NULL;
-	
 	void** ppv;
-	switch (config.deviceFunction) {
+	switch (function) {
 	case DEVICE_CHAMBER_ROOM_TEMP:
-		ppv = (void**)&tempControl.ambientSensor;
+		ppv = (void**)&devices.ambientSensor;
 		break;
 	case DEVICE_CHAMBER_DOOR:
-		ppv = (void**)&tempControl.door;
+		ppv = (void**)&devices.door;
 		break;
 	case DEVICE_CHAMBER_LIGHT:
-		ppv = (void**)&tempControl.light;
+		ppv = (void**)&devices.light;
 		break;
 	case DEVICE_CHAMBER_HEAT:
-		ppv = (void**)&tempControl.heater;
+		ppv = (void**)&devices.heater;
 		break;
 	case DEVICE_CHAMBER_COOL:
-		ppv = (void**)&tempControl.cooler;
+		ppv = (void**)&devices.cooler;
 		break;
 	case DEVICE_CHAMBER_TEMP:
-		ppv = (void**)&tempControl.fridgeSensor;
+		ppv = (void**)&devices.fridgeSensor;
 		break;
 	case DEVICE_CHAMBER_FAN:
-		ppv = (void**)&tempControl.fan;
+		ppv = (void**)&devices.fan;
 		break;		
 	
 	case DEVICE_BEER_TEMP:
-		ppv = (void**)&tempControl.beerSensor;
+		ppv = (void**)&devices.beerSensor;
 		break;
 	default:
 		ppv = NULL;
@@ -187,6 +183,26 @@ inline void** deviceTarget(DeviceConfig& config)
 	return ppv;
 }
 
+/**
+ * Returns the pointer to where the device pointer resides. This can be used to delete the current device and install a new one. 
+ * For Temperature sensors, the returned pointer points to a TempSensor*. The basic device can be fetched by calling
+ * TempSensor::getSensor().
+ * Devices of the chamber in tempControl are installed there, those of other chambers in their context. Beer devices
+ * are only installed for the beer their chamber controls.
+ */
+inline void** deviceTarget(DeviceConfig& config)
+{
+	uint8_t chamber = config.chamber ? config.chamber-1 : 0;
+	if (chamber>=chamberManager.count())
+		return NULL;
+	if (config.beer && config.beer-1!=chamberManager.activeBeer(chamber))
+		return NULL;
+	
+	if (chamber==chamberManager.current())
+		return deviceField(tempControl, config.deviceFunction);
+	return deviceField(chamberManager.context(chamber), config.deviceFunction);
+}
+
 // A pointer to a "temp sensor" may be a TempSensor* or a BasicTempSensor* .
 // These functions allow uniform treatment.
 inline bool isBasicSensor(DeviceFunction function) {
@@ -222,6 +238,8 @@ void DeviceManager::uninstallDevice(DeviceConfig& config)
 		case DEVICETYPE_NONE:
 			break;
 		case DEVICETYPE_TEMP_SENSOR:
+			if (*ppv==NULL)		// the wrapper of a chamber that is not initialized yet, so nothing is installed
+				break;
 			// sensor may be wrapped in a TempSensor class, or may stand alone.
 			s = &unwrapSensor(config.deviceFunction, *ppv);
 			if (s!=&defaultTempSensor) {
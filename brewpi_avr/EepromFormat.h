@@ -23,12 +23,13 @@
 #include "Brewpi.h"
 #include "DeviceManager.h"
 #include "TempControl.h"
+#include "BeerProfile.h"
 
 
 struct ChamberSettings
 {
 	ControlConstants cc;
-	byte reserved[1];	// was 3, but added pidMax
+	uint8_t activeBeer;	// the beer this chamber controls, counted from 0. Was reserved, so it reads 0 in existing eeproms
 };
 
 struct BeerBlock {
@@ -54,6 +55,7 @@ struct EepromFormat
 	byte reserved[4];	
 	ChamberBlock chambers[MAX_CHAMBERS];
 	DeviceConfig devices[MAX_DEVICES];
+	ProfileBlock profiles[MAX_CHAMBERS];	// the beer profile of each chamber, for whichever beer it controls
 };
 
 
@@ -81,7 +83,7 @@ void eepromSizeCheck() {
  * Increment this value each time a change is made that is not backwardly-compatible.
  * Either the eeprom will be reset to defaults, or external code will re-establish the values via the piLink interface. 
  */
-#define EEPROM_FORMAT_VERSION 4
+#define EEPROM_FORMAT_VERSION 5
 
 /*
  * Version history:
@@ -90,4 +92,7 @@ void eepromSizeCheck() {
  * rev 2: initial version dynaconfig
  * rev 3: deactivate flag in DeviceConfig, and additinoal padding to allow for some future expansion.
  * rev 4: added padding at start and reduced device count to 16. We can always increase later.
+ * rev 5: added heaterPower and coolerPower to the control constants, for energy metering.
+ *        Later the beer profiles were added in the unused space at the end. initializeEeprom clears all of the eeprom,
+ *        so they read as empty in existing eeproms and the version did not change.
  */
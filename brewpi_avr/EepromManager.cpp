@@ -25,6 +25,7 @@
 #include "TempControl.h"
 #include "EepromFormat.h"
 #include "PiLink.h"
+#include "ChamberManager.h"
 
 EepromManager eepromManager;
 EepromAccess eepromAccess;
@@ -100,10 +101,17 @@ bool EepromManager::applySettings()
 		
 	logDebug("Applying settings");
 
-	// load the one chamber and one beer for now
-	eptr_t pv = pointerOffset(chambers);
-	tempControl.loadConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));	
-	tempControl.loadSettings(pv+offsetof(ChamberBlock, beer[0].cs));
+	// load the constants and the settings of the active beer of each chamber
+	chamberManager.loadActiveBeers();
+	for (uint8_t c=0; c<chamberManager.count(); c++) {
+		chamberManager.switchTo(c);
+		tempControl.loadConstants(chamberConstantsOffset(c));
+		tempControl.loadSettings(beerSettingsOffset(c, chamberManager.activeBeer(c)));
+#if BREWPI_BEER_PROFILE
+		tempControl.loadProfile(profileOffset(c));
+#endif
+	}
+	chamberManager.switchTo(chamberManager.getSelected());
 	
 	logDebug("Applied settings");
 	
@@ -123,21 +131,59 @@ bool EepromManager::applySettings()
 
 void EepromManager::storeTempConstantsAndSettings()
 {
-	uint8_t chamber = 0;
-	eptr_t pv = pointerOffset(chambers);
-	pv += sizeof(ChamberBlock)*chamber;
-	tempControl.storeConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));
+	tempControl.storeConstants(chamberConstantsOffset(chamberManager.current()));
 		
 	storeTempSettings();
 }
 
 void EepromManager::storeTempSettings()
 {
-	uint8_t chamber = 0;
-	eptr_t pv = pointerOffset(chambers);
-	pv += sizeof(ChamberBlock)*chamber;
-	// for now assume just one beer. 
-	tempControl.storeSettings(pv+offsetof(ChamberBlock, beer[0].cs));	
+	uint8_t chamber = chamberManager.current();
+	tempControl.storeSettings(beerSettingsOffset(chamber, chamberManager.activeBeer(chamber)));	
+}
+
+eptr_t EepromManager::chamberConstantsOffset(uint8_t chamber)
+{
+	return pointerOffset(chambers)+sizeof(ChamberBlock)*chamber+offsetof(ChamberBlock, chamberSettings.cc);
+}
+
+eptr_t EepromManager::activeBeerOffset(uint8_t chamber)
+{
+	return pointerOffset(chambers)+sizeof(ChamberBlock)*chamber+offsetof(ChamberBlock, chamberSettings.activeBeer);
+}
+
+eptr_t EepromManager::beerSettingsOffset(uint8_t chamber, uint8_t beer)
+{
+	return pointerOffset(chambers)+sizeof(ChamberBlock)*chamber+offsetof(ChamberBlock, beer)+sizeof(BeerBlock)*beer
+		+offsetof(BeerBlock, cs);
+}
+
+eptr_t EepromManager::profileOffset(uint8_t chamber)
+{
+	return pointerOffset(profiles)+sizeof(ProfileBlock)*chamber;
+}
+
+#if BREWPI_BEER_PROFILE
+bool EepromManager::storeProfile(const ProfileBlock& profile)
+{
+	if (!hasSettings())
+		return false;
+	eptr_t offset = profileOffset(chamberManager.current());
+	eepromAccess.writeBlock(offset, &profile, sizeof(ProfileBlock));
+	tempControl.loadProfile(offset);
+	return true;
+}
+#endif
+
+void EepromManager::installDevices(uint8_t chamber, uint8_t beer)
+{
+	DeviceConfig deviceConfig;
+	for (uint8_t index = 0; fetchDevice(deviceConfig, index); index++)
+	{
+		if (deviceConfig.chamber==chamber && deviceConfig.beer==beer
+			&& deviceManager.isDeviceValid(deviceConfig, deviceConfig, index))
+			deviceManager.installDevice(deviceConfig);
+	}
 }
 
 bool EepromManager::fetchDevice(DeviceConfig& config, uint8_t deviceIndex)
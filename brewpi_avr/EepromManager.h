@@ -29,6 +29,7 @@ void fill(int8_t* p, uint8_t size);
 void clear(uint8_t* p, uint8_t size);
 
 class DeviceConfig;
+struct ProfileBlock;
 
 
 // todo - the Eeprom manager should avoid too frequent saves to the eeprom since it supports 100,000 writes. 
@@ -69,6 +70,28 @@ public:
 	 * Save just the beer temp settings.
 	 */
 	static void storeTempSettings();
+	
+	/**
+	 * Eeprom locations of the constants of a chamber, its active beer and the settings of one of its beers.
+	 * Chambers and beers are counted from 0.
+	 */
+	static eptr_t chamberConstantsOffset(uint8_t chamber);
+	static eptr_t activeBeerOffset(uint8_t chamber);
+	static eptr_t beerSettingsOffset(uint8_t chamber, uint8_t beer);
+	static eptr_t profileOffset(uint8_t chamber);
+
+#if BREWPI_BEER_PROFILE
+	/**
+	 * Replaces the beer profile of the current chamber and starts it at the time stored with it.
+	 * @return false when the eeprom has no settings.
+	 */
+	static bool storeProfile(const ProfileBlock& profile);
+#endif
+	
+	/**
+	 * Installs the devices in the eeprom that belong to the given chamber and beer, both counted from 1.
+	 */
+	static void installDevices(uint8_t chamber, uint8_t beer);
 
 	static bool fetchDevice(DeviceConfig& config, uint8_t deviceIndex);
 	static bool storeDevice(const DeviceConfig& config, uint8_t deviceIndex);
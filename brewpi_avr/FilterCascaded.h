@@ -55,6 +55,12 @@ class CascadedFilter{
 	temperature detectNegPeak(void){
 		return sections[NUM_SECTIONS-1].detectNegPeak(); // detect peaks in last section
 	}
+	
+	void shift(temperature_precise offset){
+		for(uint8_t i=0; i<NUM_SECTIONS; i++){
+			sections[i].shift(offset); // DC gain of each section is 1, so all move by the same amount
+		}
+	}
 };
 
 
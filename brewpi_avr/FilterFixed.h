@@ -108,5 +108,13 @@ class FixedFilter{
 		temperature detectPosPeak(void); //returns positive peak or INVALID_TEMP when no peak has been found
 		temperature detectNegPeak(void); //returns negative peak or INVALID_TEMP when no peak has been found
 		
+		// Moves all inputs and outputs by offset. For a ramp input, this is the same as running the filter for the
+		// number of samples it takes the ramp to rise by offset.
+		void shift(temperature_precise offset){
+			for(uint8_t i=0; i<3; i++){
+				xv[i] += offset;
+				yv[i] += offset;
+			}
+		}
 };
 
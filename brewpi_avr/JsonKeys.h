@@ -56,6 +56,8 @@ static const char JSONKEY_beerSlowFilter[] PROGMEM = "beerSlowFilt";
 static const char JSONKEY_beerSlopeFilter[] PROGMEM = "beerSlopeFilt";
 static const char JSONKEY_lightAsHeater[] PROGMEM = "lah";
 static const char JSONKEY_rotaryHalfSteps[] PROGMEM = "hs";
+static const char JSONKEY_heaterPower[] PROGMEM = "heatPwr";
+static const char JSONKEY_coolerPower[] PROGMEM = "coolPwr";
 
 // variable;
 static const char JSONKEY_beerDiff[] PROGMEM = "beerDiff";
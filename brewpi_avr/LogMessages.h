@@ -29,7 +29,7 @@
 */
 
 /* bump this version number when changing this file and copy the new version to the brewpi-script repository. */
-#define BREWPI_LOG_MESSAGES_VERSION 1
+#define BREWPI_LOG_MESSAGES_VERSION 2
 
 #define MSG(errorID, errorString, ...) errorID
 
@@ -51,6 +51,7 @@ enum errorMessages{
 
 // PiLink.cpp
 	MSG(ERROR_EXPECTED_BRACKET, "Expected { got %c", character),
+	MSG(ERROR_INVALID_PROFILE_POINT, "Invalid profile point %d, times must be increasing whole minutes and at most 15 points fit", point),
 	
 }; // END enum errorMessages
 
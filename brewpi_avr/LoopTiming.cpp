@@ -0,0 +1,52 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Brewpi.h"
+#include "LoopTiming.h"
+#include <string.h>
+
+LoopTiming loopTiming;
+
+void LoopTiming::reset(void){
+	memset(this, 0, sizeof(*this));
+}
+
+uint8_t LoopTiming::bucketOf(uint32_t micros){
+	uint8_t bucket = 0;
+	while(micros > 1 && bucket < LOOP_TIMING_BUCKETS-1){
+		micros >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void LoopTiming::record(uint8_t phase, uint32_t micros){
+	if(!count[phase] || micros < minimum[phase]){
+		minimum[phase] = micros;
+	}
+	if(micros > maximum[phase]){
+		maximum[phase] = micros;
+	}
+	count[phase]++;
+	uint16_t& bucket = buckets[phase][bucketOf(micros)];
+	if(bucket != 0xFFFF){
+		bucket++;
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2012-2013 BrewPi/Elco Jacobs.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+// Durations of 2^20 us (about a second, the control tick) and longer all go in the last bucket
+#define LOOP_TIMING_BUCKETS 21
+
+// The parts of the main loop that are timed. Control phases are timed for each chamber.
+enum LoopPhase {
+	PHASE_TEMPERATURES,		// updateTemperatures, reads the sensors
+	PHASE_PEAKS,			// detectPeaks
+	PHASE_PID,				// updatePID
+	PHASE_STATE,			// updateState
+	PHASE_OUTPUTS,			// updateOutputs
+	PHASE_DISPLAY,			// the display updates
+	PHASE_RECEIVE,			// piLink.receive, when there is input
+	PHASE_TICK,				// the whole control tick, all chambers and the display
+	NUM_LOOP_PHASES
+};
+
+/*
+ * LoopTiming keeps the minimum, maximum and a histogram of the duration of each phase of the main loop, in
+ * microseconds. Bucket b of the histogram counts durations from 2^b up to 2^(b+1) us, bucket 0 also counts 0 and 1 us.
+ * Recording is a handful of shifts, so the loop it measures hardly changes.
+ */
+class LoopTiming{
+	public:
+	LoopTiming(){
+		reset();
+	}
+
+	void reset(void);
+
+	void record(uint8_t phase, uint32_t micros);
+
+	uint32_t getCount(uint8_t phase){
+		return count[phase];
+	}
+	// 0 when nothing was recorded
+	uint32_t getMin(uint8_t phase){
+		return count[phase] ? minimum[phase] : 0;
+	}
+	uint32_t getMax(uint8_t phase){
+		return maximum[phase];
+	}
+	// saturates at 65535
+	uint16_t getBucket(uint8_t phase, uint8_t bucket){
+		return buckets[phase][bucket];
+	}
+
+	static uint8_t bucketOf(uint32_t micros);
+
+	private:
+	uint32_t count[NUM_LOOP_PHASES];
+	uint32_t minimum[NUM_LOOP_PHASES];
+	uint32_t maximum[NUM_LOOP_PHASES];
+	uint16_t buckets[NUM_LOOP_PHASES][LOOP_TIMING_BUCKETS];
+};
+
+extern LoopTiming loopTiming;
+
+/*
+ * Runs the statement and records its duration for the phase. Without BREWPI_LOOP_TIMING it only runs the statement.
+ */
+#if BREWPI_LOOP_TIMING
+#define LOOP_TIMED(phase, statement) { uint32_t phaseStart = micros(); statement; loopTiming.record(phase, micros()-phaseStart); }
+#else
+#define LOOP_TIMED(phase, statement) { statement; }
+#endif
@@ -200,12 +200,23 @@ void pickTempSetting(ReadTemp readTemp, WriteTemp writeTemp, const char* tempNam
 	// Time Out. Setting is not written
 }
 
+#if TEMP_CONTROL_STATIC
+	#define TEMP_CONTROL_FUNCTION(name) (&TempControl::name)
+#else
+	// members of an instance cannot be passed as plain function pointers, so wrap them
+	static temperature getFridgeSetting() { return tempControl.getFridgeSetting(); }
+	static void setFridgeTemp(temperature t) { tempControl.setFridgeTemp(t); }
+	static temperature getBeerSetting() { return tempControl.getBeerSetting(); }
+	static void setBeerTemp(temperature t) { tempControl.setBeerTemp(t); }
+	#define TEMP_CONTROL_FUNCTION(name) (&name)
+#endif
+
 void Menu::pickFridgeSetting(void){
-	pickTempSetting(tempControl.getFridgeSetting, tempControl.setFridgeTemp, PSTR("Fridge"), piLink.printFridgeAnnotation, 2);
+	pickTempSetting(TEMP_CONTROL_FUNCTION(getFridgeSetting), TEMP_CONTROL_FUNCTION(setFridgeTemp), PSTR("Fridge"), piLink.printFridgeAnnotation, 2);
 }
 
 void Menu::pickBeerSetting(void){
-	pickTempSetting(tempControl.getBeerSetting, tempControl.setBeerTemp, PSTR("Beer"), piLink.printBeerAnnotation, 1);
+	pickTempSetting(TEMP_CONTROL_FUNCTION(getBeerSetting), TEMP_CONTROL_FUNCTION(setBeerTemp), PSTR("Beer"), piLink.printBeerAnnotation, 1);
 }
 
 
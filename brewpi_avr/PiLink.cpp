@@ -35,6 +35,8 @@
 #include "SettingsManager.h"
 #include "Buzzer.h"
 #include "Display.h"
+#include "ChamberManager.h"
+#include "LoopTiming.h"
 
 #ifdef ARDUINO
 #include "util/delay.h"
@@ -114,6 +116,10 @@ void printNibble(uint8_t n)
 	piStream.print((char)(n>=10 ? n-10+'A' : n+'0'));
 }
 
+bool PiLink::hasInput(void){
+	return piStream.available() > 0;
+}
+
 void PiLink::receive(void){
 	while (piStream.available() > 0) {
 		char inByte = piStream.read();              
@@ -124,11 +130,16 @@ void PiLink::receive(void){
 			break;
 
 #if BREWPI_SIMULATE==1
+		// the simulated fridge is the first chamber
 		case 'y':
+			chamberManager.switchTo(0);
 			parseJson(HandleSimulatorConfig);
+			chamberManager.switchTo(chamberManager.getSelected());
 			break;
 		case 'Y':
+			chamberManager.switchTo(0);
 			printSimulatorSettings();
+			chamberManager.switchTo(chamberManager.getSelected());
 			break;		
 #endif						
 		case 'A': // alarm on
@@ -161,6 +172,32 @@ void PiLink::receive(void){
 		case 'v': // Control variables requested
 			sendControlVariables();
 			break;
+#if BREWPI_CONTROL_KPI
+		case 'k': // Control quality indicators requested
+			sendControlKpi();
+			break;
+		case 'K': // Reset control quality indicators
+			tempControl.kpi.reset();
+			sendControlKpi();
+			break;
+#endif
+#if BREWPI_LOOP_TIMING
+		case 'm': // Loop timing requested
+			sendLoopTiming();
+			break;
+		case 'M': // Reset loop timing
+			loopTiming.reset();
+			sendLoopTiming();
+			break;
+#endif
+#if BREWPI_BEER_PROFILE
+		case 'P': // Receive a beer profile as {"minutes":temperature,...}, or move it with {"m":minutes}
+			receiveBeerProfile();
+			break;
+		case 'p': // Beer profile and its progress requested
+			sendBeerProfile();
+			break;
+#endif
 		case 'n':
 			// v version
 			// s shield type
@@ -191,6 +228,9 @@ void PiLink::receive(void){
 		case 'j': // Receive settings as json
 			receiveJson();
 			break;
+		case '@': // address a chamber and optionally its beer for the commands that follow: @c or @c.b, counted from 1
+			addressChamber();
+			break;
 
 #if BREWPI_EEPROM_HELPER_COMMANDS
 		case 'e': // dump contents of eeprom						
@@ -265,15 +305,29 @@ void PiLink::receive(void){
 	#define JSON_STATE		"s"
 	#define JSON_TIME		"t"
 	#define JSON_ROOM_TEMP  "rt"
+	#define JSON_HEAT_TIME  "ht"
+	#define JSON_COOL_TIME  "ct"
+	#define JSON_CHAMBER	"c"
 	
 	temperature beerTemp = -1, beerSet = -1, fridgeTemp = -1, fridgeSet = -1;
 	double roomTemp = -1;
 	uint8_t state = 0xFF;
+	uint32_t heatTime = 0xFFFFFFFF, coolTime = 0xFFFFFFFF;
 	char* beerAnn; char* fridgeAnn;
+	uint8_t printedChamber = 0;
+	
+	// the values of another chamber were printed last, so send everything
+	inline void forgetPrintedValues() {
+		beerTemp = beerSet = fridgeTemp = fridgeSet = -1;
+		roomTemp = -1;
+		state = 0xFF;
+		heatTime = coolTime = 0xFFFFFFFF;
+	}
 	
 	typedef char* PChar;
 	inline bool changed(uint8_t &a, uint8_t b) { uint8_t c = a; a=b; return b!=c; }
 	inline bool changed(temperature &a, temperature b) { temperature c = a; a=b; return b!=c; }
+	inline bool changed(uint32_t &a, uint32_t b) { uint32_t c = a; a=b; return b!=c; }
 	inline bool changed(double &a, double b) { double c = a; a=b; return b!=c; }
 	inline bool changed(PChar &a, PChar b) { PChar c = a; a=b; return b!=c; }
 #else
@@ -286,6 +340,9 @@ void PiLink::receive(void){
 	#define JSON_STATE		"State"
 	#define JSON_TIME		"Time"
 	#define JSON_ROOM_TEMP  "RoomTemp"
+	#define JSON_HEAT_TIME  "HeatTime"
+	#define JSON_COOL_TIME  "CoolTime"
+	#define JSON_CHAMBER	"Chamber"
 	
 	#define changed(a,b)  1
 #endif
@@ -293,6 +350,15 @@ void PiLink::receive(void){
 void PiLink::printTemperaturesJSON(char * beerAnnotation, char * fridgeAnnotation){
 	printResponse('T');	
 
+#if BREWPI_CHAMBERS>1
+	uint8_t chamber = chamberManager.current();
+#if COMPACT_SERIAL
+	if (changed(printedChamber, chamber))
+		forgetPrintedValues();
+#endif
+	sendJsonPair(PSTR(JSON_CHAMBER), uint8_t(chamber+1));
+#endif
+
 	temperature t;
 	t = tempControl.getBeerTemp();
 	if (changed(beerTemp, t))
@@ -323,6 +389,16 @@ void PiLink::printTemperaturesJSON(char * beerAnnotation, char * fridgeAnnotatio
 	if (changed(state, tempControl.getState()))
 		sendJsonPair(PSTR(JSON_STATE), tempControl.getState());		
 
+#if BREWPI_ENERGY_METER
+	// on-time in seconds, the script multiplies it by heatPwr and coolPwr for the energy
+	uint32_t onTime = tempControl.getHeaterOnTime();
+	if (changed(heatTime, onTime))
+		sendJsonPair(PSTR(JSON_HEAT_TIME), onTime);
+	onTime = tempControl.getCoolerOnTime();
+	if (changed(coolTime, onTime))
+		sendJsonPair(PSTR(JSON_COOL_TIME), onTime);
+#endif
+
 #if BREWPI_SIMULATE	
 	printJsonName(PSTR(JSON_TIME));
 	print_P(PSTR("%lu"), ticks.millis()/1000);
@@ -508,7 +584,10 @@ const PiLink::JsonOutput PiLink::jsonOutputCCMap[] PROGMEM = {
 	JSON_OUTPUT_CC_MAP(beerSlopeFilter, JOCC_UINT8),
 	
 	JSON_OUTPUT_CC_MAP(lightAsHeater, JOCC_UINT8),
-	JSON_OUTPUT_CC_MAP(rotaryHalfSteps, JOCC_UINT8)
+	JSON_OUTPUT_CC_MAP(rotaryHalfSteps, JOCC_UINT8),
+
+	JSON_OUTPUT_CC_MAP(heaterPower, JOCC_UINT16),
+	JSON_OUTPUT_CC_MAP(coolerPower, JOCC_UINT16)
 	
 };
 
@@ -548,6 +627,149 @@ void PiLink::sendControlVariables(void){
 	sendJsonValues('V', jsonOutputCVMap, sizeof(jsonOutputCVMap)/sizeof(jsonOutputCVMap[0]));
 }
 
+#if BREWPI_CONTROL_KPI
+void PiLink::sendJsonKpiTemp(const char* name, long_temperature val){
+	char tempString[12];
+	tempDiffToString(tempString, val, 3, 12);
+	printJsonName(name);
+	piStream.print(tempString);
+}
+
+void PiLink::sendJsonKpiDuty(const char* name, uint16_t permille){
+	printJsonName(name);
+	print_P(PSTR("%u.%u"), permille/10, permille%10);
+}
+
+// The indicators count control ticks
+static unsigned long kpiSeconds(uint32_t ticks){
+	// ticks*tick/1000, split so the product doesn't overflow
+	uint16_t tick = tempControl.getTickTime();
+	return (ticks/1000)*tick + (ticks%1000)*tick/1000;
+}
+
+// Send the control quality indicators as JSON. Times are in seconds, duty cycles in percent.
+void PiLink::sendControlKpi(void){
+	ControlKpi& kpi = tempControl.kpi;
+	printResponse('K');
+	printJsonName(PSTR("n"));
+	print_P(PSTR("%lu"), kpiSeconds(kpi.getTicks()));
+	sendJsonKpiTemp(PSTR("rms"), kpi.getRmsError());
+	sendJsonKpiTemp(PSTR("os"), kpi.getOvershoot());
+	printJsonName(PSTR("st"));
+	print_P(PSTR("%lu"), kpiSeconds(kpi.getSettlingTime()));
+	sendJsonPair(PSTR("hc"), kpi.getHeatCycles());
+	sendJsonPair(PSTR("cc"), kpi.getCoolCycles());
+	sendJsonKpiDuty(PSTR("hd"), kpi.getHeatDuty());
+	sendJsonKpiDuty(PSTR("cd"), kpi.getCoolDuty());
+	printJsonName(PSTR("s"));
+	for(uint8_t i=0; i<NUM_STATES; i++){
+		piStream.print(i ? ',' : '[');
+		print_P(PSTR("%lu"), kpiSeconds(kpi.getStateTime(i)));
+	}
+	piStream.print(']');
+	sendJsonClose();
+}
+#endif
+
+#if BREWPI_LOOP_TIMING
+static const char loopPhaseNames[NUM_LOOP_PHASES][6] PROGMEM = {
+	"temp", "peak", "pid", "state", "out", "disp", "recv", "tick"
+};
+
+// Each phase as "name":{"n":count,"min":us,"max":us,"h":[histogram up to the last bucket used]}
+void PiLink::sendLoopTiming(void){
+	printResponse('M');
+	for(uint8_t phase=0; phase<NUM_LOOP_PHASES; phase++){
+		printJsonName(loopPhaseNames[phase]);
+		print_P(PSTR("{\"n\":%lu,\"min\":%lu,\"max\":%lu,\"h\":"), (unsigned long)loopTiming.getCount(phase),
+			(unsigned long)loopTiming.getMin(phase), (unsigned long)loopTiming.getMax(phase));
+		uint8_t used = LOOP_TIMING_BUCKETS;
+		while(used && !loopTiming.getBucket(phase, used-1)){
+			used--;
+		}
+		piStream.print('[');
+		for(uint8_t b=0; b<used; b++){
+			print_P(b ? PSTR(",%u") : PSTR("%u"), loopTiming.getBucket(phase, b));
+		}
+		piStream.print(']');
+		piStream.print('}');
+	}
+	sendJsonClose();
+}
+#endif
+
+#if BREWPI_BEER_PROFILE
+struct ProfileUpload {
+	ProfileBlock block;
+	uint16_t minutes;
+	bool moved;
+	bool valid;
+};
+
+// A point has its time in minutes from the start of the profile as key. The "m" key sets the profile time.
+static void handleProfilePoint(const char* key, const char* val, void* data){
+	ProfileUpload* upload = (ProfileUpload*)data;
+	if(key[0]=='m' && key[1]==0){
+		upload->minutes = atol(val);
+		upload->moved = true;
+		return;
+	}
+	ProfileBlock& block = upload->block;
+	char* end;
+	unsigned long minutes = strtoul(key, &end, 10);
+	bool number = key[0] >= '0' && key[0] <= '9' && *end == 0 && minutes <= 0xFFFF;
+	if(!number || block.count >= ProfileBlock::MAX_POINTS || (block.count && minutes <= block.points[block.count-1].minutes)){
+		logErrorInt(ERROR_INVALID_PROFILE_POINT, block.count+1);
+		upload->valid = false;
+		return;
+	}
+	ProfilePoint& point = block.points[block.count++];
+	point.minutes = minutes;
+	point.temp = constrainTemp(stringToTemp(val), tempControl.cc.tempSettingMin, tempControl.cc.tempSettingMax);
+}
+
+// Points replace the profile of the current chamber, which starts at "m" or at 0. Without points, "m" moves the
+// profile and an empty object removes it.
+void PiLink::receiveBeerProfile(void){
+	ProfileUpload upload;
+	clear((uint8_t*)&upload, sizeof(upload));
+	upload.valid = true;
+	if(parseJson(&handleProfilePoint, &upload) && upload.valid){
+		if(upload.block.count || !upload.moved){
+			upload.block.minutes = upload.minutes;
+			eepromManager.storeProfile(upload.block);
+		}
+		else{
+			tempControl.profile.setMinutes(upload.minutes);
+		}
+	}
+	sendBeerProfile();
+}
+
+// P:{"n":points,"s":active segment,"m":profile time,"f":finished,"p":[[minutes,temperature],...]}
+// The active segment runs from point s to the next, counted from 0. Times are in minutes from the start.
+void PiLink::sendBeerProfile(void){
+	BeerProfile& profile = tempControl.profile;
+	printResponse('P');
+	sendJsonPair(PSTR("n"), profile.getCount());
+	if(profile.isActive()){
+		sendJsonPair(PSTR("s"), profile.getSegment());
+		sendJsonPair(PSTR("m"), profile.getMinutes());
+		sendJsonPair(PSTR("f"), uint8_t(profile.isFinished()));
+		printJsonName(PSTR("p"));
+		char tempString[9];
+		for(uint8_t i=0; i<profile.getCount(); i++){
+			ProfilePoint point;
+			profile.getPoint(i, point);
+			tempToString(tempString, point.temp, 2, 9);
+			print_P(PSTR("%c[%u,%s]"), i ? ',' : '[', point.minutes, tempString);
+		}
+		piStream.print(']');
+	}
+	sendJsonClose();
+}
+#endif
+
 void PiLink::printJsonName(const char * name)
 {
 	printJsonSeparator();
@@ -583,6 +805,11 @@ void PiLink::sendJsonPair(const char * name, uint8_t val) {
 	sendJsonPair(name, (uint16_t)val);
 }
 
+void PiLink::sendJsonPair(const char * name, uint32_t val){
+	printJsonName(name);
+	print_P(PSTR("%lu"), (unsigned long)val);
+}
+
 int readNext()
 {
 	uint8_t retries = 0;
@@ -622,7 +849,7 @@ bool parseJsonToken(char* val) {
 	return result;	
 }
 
-void PiLink::parseJson(ParseJsonCallback fn, void* data) 
+bool PiLink::parseJson(ParseJsonCallback fn, void* data) 
 {
 	char key[30];
 	char val[30];
@@ -634,13 +861,40 @@ void PiLink::parseJson(ParseJsonCallback fn, void* data)
 	if (c!='{')
 	{
 		logErrorInt(ERROR_EXPECTED_BRACKET, c);
-		return;
+		return false;
 	}
 	do {
 		next = parseJsonToken(key) && parseJsonToken(val);
 		if (val[0] && key[0])
 			fn(key, val, data);
 	} while (next);
+	return true;
+}
+
+void PiLink::addressChamber()
+{
+	int chamber = readNext()-'1';
+	if (!chamberManager.select(chamber)) {
+		logErrorInt(ERROR_INVALID_CHAMBER, chamber+1);
+		return;
+	}
+	if (piStream.peek()=='.') {
+		piStream.read();
+		int beer = readNext()-'1';
+		if (!chamberManager.setActiveBeer(beer))
+			logErrorInt(ERROR_INVALID_BEER, beer+1);
+	}
+	printChamberInfo();
+}
+
+void PiLink::printChamberInfo()
+{
+	printResponse('@');
+	uint8_t chamber = chamberManager.current();
+	sendJsonPair(PSTR("c"), uint8_t(chamber+1));
+	sendJsonPair(PSTR("b"), uint8_t(chamberManager.activeBeer(chamber)+1));
+	sendJsonPair(PSTR("n"), chamberManager.count());
+	sendJsonClose();
 }
 
 void PiLink::receiveJson(void){
@@ -724,18 +978,9 @@ void applyFilterSetting(const char* val, void* target) {
         	uint8_t offset = uint8_t((unsigned int) target);		// target is really just an integer
         #endif
         
-	FilterType filterType = FilterType(offset&3);
-	TempSensorTarget sensorTarget = TempSensorTarget(offset/3);
-	
-	uint8_t value = atol(val);
 	uint8_t* const location = filterSettings[offset];
-	*location = value;
-	TempSensor* sensor = sensorTarget ? tempControl.beerSensor : tempControl.fridgeSensor;
-	switch (filterType) {
-		case FAST: sensor->setFastFilterCoefficients(value); break;
-		case SLOW: sensor->setSlowFilterCoefficients(value); break;
-		case SLOPE: sensor->setSlopeFilterCoefficients(value); break;
-	}
+	*location = atol(val);
+	tempControl.initFilters();	// adapts the setting to the tick, as at start up
 	eepromManager.storeTempConstantsAndSettings();
 }
 
@@ -792,6 +1037,8 @@ const PiLink::JsonParserConvert PiLink::jsonParserConverters[] PROGMEM = {
 	JSON_CONVERT(JSONKEY_maxCoolTimeForEstimate, &tempControl.cc.maxCoolTimeForEstimate, setUint16),
 	JSON_CONVERT(JSONKEY_lightAsHeater, &tempControl.cc.lightAsHeater, setBool),
 	JSON_CONVERT(JSONKEY_rotaryHalfSteps, &tempControl.cc.rotaryHalfSteps, setBool),
+	JSON_CONVERT(JSONKEY_heaterPower, &tempControl.cc.heaterPower, setUint16),
+	JSON_CONVERT(JSONKEY_coolerPower, &tempControl.cc.coolerPower, setUint16),
 	
 	JSON_CONVERT(JSONKEY_fridgeFastFilter, MAKE_FILTER_SETTING_TARGET(FAST, FRIDGE), applyFilterSetting),
 	JSON_CONVERT(JSONKEY_fridgeSlowFilter, MAKE_FILTER_SETTING_TARGET(SLOW, FRIDGE), applyFilterSetting),
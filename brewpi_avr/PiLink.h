@@ -36,6 +36,7 @@ class PiLink{
 	// There can only be one PiLink object, so functions are static
 	static void init(void);
 	static void receive(void);
+	static bool hasInput(void);	// true when received characters are waiting
 	
 	static void printFridgeAnnotation(const char * annotation, ...);	
 	static void printBeerAnnotation(const char * annotation, ...);
@@ -46,7 +47,11 @@ class PiLink{
 	
 	typedef void (*ParseJsonCallback)(const char* key, const char* val, void* data);
 
-	static void parseJson(ParseJsonCallback fn, void* data=NULL);
+	/**
+	 * Parses a JSON object of key:value pairs from the serial stream and calls fn for each pair.
+	 * @return false when the stream did not start with an opening brace.
+	 */
+	static bool parseJson(ParseJsonCallback fn, void* data=NULL);
 	
 	private:
 	
@@ -54,6 +59,20 @@ class PiLink{
 	static void receiveControlConstants(void);
 	static void sendControlConstants(void);
 	static void sendControlVariables(void);
+#if BREWPI_CONTROL_KPI
+	static void sendControlKpi(void);
+	static void sendJsonKpiTemp(const char* name, long_temperature val);
+	static void sendJsonKpiDuty(const char* name, uint16_t permille);
+#endif
+	
+#if BREWPI_LOOP_TIMING
+	static void sendLoopTiming(void);
+#endif
+
+#if BREWPI_BEER_PROFILE
+	static void receiveBeerProfile(void);
+	static void sendBeerProfile(void);
+#endif
 	
 	static void receiveJson(void); // receive settings as JSON key:value pairs
 	
@@ -73,12 +92,14 @@ class PiLink{
 	static void soundAlarm(bool enabled);
 	static void printResponse(char responseChar);
 	static void printChamberInfo();
+	static void addressChamber();
 	
 	static void printTemperaturesJSON(char * beerAnnotation, char * fridgeAnnotation);
 	static void sendJsonPair(const char * name, const char * val); // send one JSON pair with a string value as name:val,
 	static void sendJsonPair(const char * name, char val); // send one JSON pair with a char value as name:val,
 	static void sendJsonPair(const char * name, uint16_t val); // send one JSON pair with a uint16_t value as name:val,
 	static void sendJsonPair(const char * name, uint8_t val); // send one JSON pair with a uint8_t value as name:val,
+	static void sendJsonPair(const char * name, uint32_t val); // send one JSON pair with a uint32_t value as name:val,
 	static void sendJsonAnnotation(const char* name, const char* annotation);
 	static void sendJsonTemp(const char* name, temperature temp);
 	
@@ -37,7 +37,7 @@ public:
 	ValueSensor(T initial) : value(initial) {}
 
 	virtual T sense() {
-		return (T)0;
+		return value;
 	}
 	
 	void setValue(T _value) {
@@ -23,41 +23,62 @@
 
 #include "Display.h"
 #include "PiLink.h"
+#include "ChamberManager.h"
+#include "LoopTiming.h"
+
+#if BREWPI_TRACE
+	#include "TraceRecorder.h"
+#endif
 
 #if BREWPI_SIMULATE
 
 Simulator simulator;
 
-static temperature funFactor = 0;	// paused
-static unsigned long lastUpdate = 0;
+static long_temperature funFactor = 0;	// paused
+static unsigned long lastPaceMicros = 0;
+/**
+ * Simulated time owed to the simulation, in 1/TEMP_FIXED_POINT_SCALE microseconds. Each read of the clock adds the
+ * real time since the previous read times the run factor, each simulated tick takes its exact share off, so
+ * rounding never accumulates.
+ */
+static uint64_t paceOwed = 0;
 uint8_t printTempInterval = 5;
 
-void setRunFactor(temperature factor)
+#define SIMULATED_SECOND (1000000ULL*TEMP_FIXED_POINT_SCALE)
+
+void setRunFactor(long_temperature factor)
 {
-	funFactor = factor>>9;		// for now whole values only
-	lastUpdate = ::millis();
+	funFactor = factor;
+	lastPaceMicros = ::micros();
+	paceOwed = 0;
 }
 
 void updateSimulationTicks()
 {
+	uint16_t tick = tempControl.getTickTime();
 #if BREWPI_EMULATE
 	// in the avr simulator (we call emulator to try to distinguish), ticks take forever. 1 second takes many minutes if 
 	// emulating waiting for millis() to increment.
-	ticks.incMillis(1000);
+	ticks.incMillis(tick);
 #else
-	if (funFactor) {
-		unsigned long now = ::millis();
-		int interval = 1000/funFactor;
-		if (interval>0) {
-			if ((now-lastUpdate)>=uint16_t(interval)) {
-				lastUpdate += interval;
-				ticks.incMillis(1000);
-			}
-		}
-		else
-		{
-			lastUpdate = now;
-			ticks.incMillis(1000);
+	if (funFactor<0) {		// full speed
+		ticks.incMillis(tick);
+	}
+	else if (funFactor) {
+		unsigned long now = ::micros();
+		paceOwed += uint64_t(now-lastPaceMicros)*uint64_t(funFactor);		// unsigned difference survives the wrap
+		lastPaceMicros = now;
+		
+		// fall behind by at most a second of real time when the loop cannot keep up, rather than racing afterwards
+		uint64_t simulatedTick = SIMULATED_SECOND/1000*tick;
+		uint64_t backlog = 1000000ULL*uint64_t(funFactor);
+		if (paceOwed>backlog+simulatedTick)
+			paceOwed = backlog+simulatedTick;
+		
+		// one tick per call, so that the control loop runs for every simulated tick
+		if (paceOwed>=simulatedTick) {
+			paceOwed -= simulatedTick;
+			ticks.incMillis(tick);
 		}
 	}
 #endif
@@ -71,40 +92,63 @@ void simulateLoop(void)
 	// external driver.
 	updateSimulationTicks();
 	
-	if(ticks.millis() - lastUpdate >= (1000)) { //update settings every second
+	if(ticks.millis() - lastUpdate >= tempControl.getTickTime()) { //update settings every tick
 		lastUpdate = ticks.millis();
+		#if BREWPI_LOOP_TIMING
+		uint32_t tickStart = micros();
+		#endif
 		
-		tempControl.updateTemperatures();
-		tempControl.detectPeaks();
-		tempControl.updatePID();
-		tempControl.updateState();
-		tempControl.updateOutputs();
+		for (uint8_t chamber=0; chamber<chamberManager.count(); chamber++) {
+			chamberManager.switchTo(chamber);
+			LOOP_TIMED(PHASE_TEMPERATURES, tempControl.updateTemperatures());
+			LOOP_TIMED(PHASE_PEAKS, tempControl.detectPeaks());
+			LOOP_TIMED(PHASE_PID, tempControl.updatePID());
+			LOOP_TIMED(PHASE_STATE, tempControl.updateState());
+			LOOP_TIMED(PHASE_OUTPUTS, tempControl.updateOutputs());
+		}
+		// the simulated fridge is the first chamber
+		chamberManager.switchTo(0);
+
+		#if BREWPI_TRACE
+		traceRecorder.record(tempControl, ticks.millis());
+		#endif
 
 		#if !BREWPI_EMULATE			// simulation on actual hardware
-		static byte updateCount = 0;
-		if (printTempInterval && (++updateCount%printTempInterval)==0) {
+		static unsigned long sincePrint = 0;	// simulated ms, printTempInterval is in seconds
+		sincePrint += tempControl.getTickTime();
+		if (printTempInterval && sincePrint>=printTempInterval*1000UL) {
 			piLink.printTemperatures();
-			updateCount = 0;
+			sincePrint = 0;
 		}
+		#endif
+		
+		simulator.stepMillis(tempControl.getTickTime());
+		chamberManager.switchTo(chamberManager.getSelected());
+		
+		#if !BREWPI_EMULATE
 		static unsigned long lastDisplayUpdate = 0;  // update the display every second
 		if ((::millis()-lastDisplayUpdate)>=1000 && (lastDisplayUpdate+=1000))
 		#endif
 		{
 			// update the lcd for the chamber being displayed
-			display.printState();
-			display.printAllTemperatures();
-			display.printMode();
-			display.updateBacklight();
+			LOOP_TIMED(PHASE_DISPLAY,
+				display.printState();
+				display.printAllTemperatures();
+				display.printMode();
+				display.updateBacklight();
+			);
 		}
-		
-		simulator.step();
+		#if BREWPI_LOOP_TIMING
+		loopTiming.record(PHASE_TICK, micros()-tickStart);
+		#endif
 	}
 	#if !BREWPI_EMULATE
 	static unsigned long lastCheckSerial = 0;
 	if ((::millis()-lastCheckSerial)>=1000 && (lastCheckSerial=::millis()>0))	// only listen if 1s passed since last time
 	#endif
-	//listen for incoming serial connections while waiting to update
-	piLink.receive();
+	//listen for incoming serial connections while waiting to update, only passes with input are timed
+	if(piLink.hasInput())
+		LOOP_TIMED(PHASE_RECEIVE, piLink.receive());
 
 }
 
@@ -112,21 +156,41 @@ void simulateLoop(void)
 
 const char SimulatorBeerTemp[] PROGMEM = "b";
 const char SimulatorBeerConnected[] PROGMEM = "bc";
+const char SimulatorBeerDropout[] PROGMEM = "bd";
+const char SimulatorBeerStuck[] PROGMEM = "bs";
 const char SimulatorBeerVolume[] PROGMEM = "bv";
+const char SimulatorBeerWell[] PROGMEM = "bw";
 const char SimulatorCoolPower[] PROGMEM = "c";
+const char SimulatorCoolEnergy[] PROGMEM = "ce";
+const char SimulatorCoolLag[] PROGMEM = "cl";
+const char SimulatorCoolLag2[] PROGMEM = "cl2";
 const char SimulatorDoorState[] PROGMEM = "d";
+const char SimulatorDoorAirExchange[] PROGMEM = "da";
 const char SimulatorEnabled[] PROGMEM = "e";
 const char SimulatorFridgeTemp[] PROGMEM = "f";
 const char SimulatorFridgeConnected[] PROGMEM = "fc";
+const char SimulatorFridgeDropout[] PROGMEM = "fd";
+const char SimulatorFridgeStuck[] PROGMEM = "fs";
 const char SimulatorFridgeVolume[] PROGMEM = "fv";
+const char SimulatorFermentPower[] PROGMEM = "fp";
+const char SimulatorFermentActive[] PROGMEM = "fpa";
+const char SimulatorFermentLog[] PROGMEM = "fpg";
+const char SimulatorFermentLag[] PROGMEM = "fpl";
+const char SimulatorFermentStationary[] PROGMEM = "fps";
+const char SimulatorFridgeWell[] PROGMEM = "fw";
 const char SimulatorHeatPower[] PROGMEM = "h";
+const char SimulatorHeatEnergy[] PROGMEM = "he";
+const char SimulatorHeatLag[] PROGMEM = "hl";
+const char SimulatorHeatLag2[] PROGMEM = "hl2";
 const char SimulatorPrintInterval[] PROGMEM = "i";
 const char SimulatorNoise[] PROGMEM = "n";
+const char SimulatorQuantize[] PROGMEM = "q";
 const char SimulatorCoeffBeer[] PROGMEM = "kb";
 const char SimulatorCoeffRoom[] PROGMEM = "ke";
 const char SimulatorRoomTempMin[] PROGMEM = "rmi";
 const char SimulatorRoomTempMax[] PROGMEM = "rmx";
 const char SimulatorBeerDensity[] PROGMEM = "sg";
+const char SimulatorSensorModel[] PROGMEM = "sm";
 const char SimulatorTime[] PROGMEM = "t";
 
 
@@ -188,6 +252,24 @@ void HandleSimulatorConfig(const char* key, const char* val, void* pv)
 	else if (strcmp_P(key, SimulatorCoolPower)==0) {
 		simulator.setCoolPower(atof(val));
 	}
+	else if (strcmp_P(key, SimulatorHeatEnergy)==0) {
+		simulator.setHeatEnergy(atof(val));
+	}
+	else if (strcmp_P(key, SimulatorCoolEnergy)==0) {
+		simulator.setCoolEnergy(atof(val));
+	}
+	else if (strcmp_P(key, SimulatorHeatLag)==0) {
+		simulator.getHeaterLag().tau1 = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorHeatLag2)==0) {
+		simulator.getHeaterLag().tau2 = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorCoolLag)==0) {
+		simulator.getCoolerLag().tau1 = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorCoolLag2)==0) {
+		simulator.getCoolerLag().tau2 = atof(val);
+	}
 	else if (strcmp_P(key, SimulatorCoeffRoom)==0) {
 		simulator.setRoomCoefficient(atof(val));
 	}
@@ -200,6 +282,33 @@ void HandleSimulatorConfig(const char* key, const char* val, void* pv)
 	else if (strcmp_P(key, SimulatorFridgeConnected)==0) {
 		simulator.setConnected(tempControl.fridgeSensor, strcmp(val, "0")!=0);
 	}		
+	else if (strcmp_P(key, SimulatorSensorModel)==0) {
+		simulator.setSensorModel(strcmp(val, "0")!=0);
+	}
+	else if (strcmp_P(key, SimulatorQuantize)==0) {
+		simulator.setQuantizeTemperatures(atof(val));
+	}
+	else if (strcmp_P(key, SimulatorBeerWell)==0) {
+		simulator.getBeerProbe().wellLag = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorFridgeWell)==0) {
+		simulator.getFridgeProbe().wellLag = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorBeerStuck)==0) {
+		simulator.getBeerProbe().stuck = strcmp(val, "0")!=0;
+	}
+	else if (strcmp_P(key, SimulatorFridgeStuck)==0) {
+		simulator.getFridgeProbe().stuck = strcmp(val, "0")!=0;
+	}
+	else if (strcmp_P(key, SimulatorBeerDropout)==0) {
+		simulator.getBeerProbe().dropoutRate = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorFridgeDropout)==0) {
+		simulator.getFridgeProbe().dropoutRate = atof(val);
+	}
+	else if (strcmp_P(key, SimulatorDoorAirExchange)==0) {
+		simulator.setDoorAirExchange(atof(val));
+	}
 	else if (strcmp_P(key, SimulatorDoorState)==0) {		// 0 for closed, anything else for open
 		simulator.setSwitch(tempControl.door, strcmp(val, "0")!=0);
 	}
@@ -212,6 +321,23 @@ void HandleSimulatorConfig(const char* key, const char* val, void* pv)
 	else if (!strcmp_P(key, SimulatorNoise)) {
 		simulator.setSensorNoise(atof(val));
 	}
+	else if (!strcmp_P(key, SimulatorFermentPower)) {
+		simulator.setFermentMaxPowerOutput(atof(val));
+	}
+	else if (!strcmp_P(key, SimulatorFermentLag) || !strcmp_P(key, SimulatorFermentLog)
+			|| !strcmp_P(key, SimulatorFermentActive) || !strcmp_P(key, SimulatorFermentStationary)) {
+		FermentPhases phases = simulator.getFermentPhases();
+		double hours = atof(val);
+		if (!strcmp_P(key, SimulatorFermentLag))
+			phases.lagPhase = hours;
+		else if (!strcmp_P(key, SimulatorFermentLog))
+			phases.logPhase = hours;
+		else if (!strcmp_P(key, SimulatorFermentActive))
+			phases.activePhase = hours;
+		else
+			phases.stationaryPhase = hours;
+		simulator.setFermentPhases(phases);
+	}
 	else if (strcmp_P(key, SimulatorEnabled)==0) {		// 0 for closed, anything else for open
 		simulator.setSimulationEnabled(strcmp(val, "0")!=0);
 	}
@@ -226,7 +352,7 @@ void PiLink::printDouble(double val)
 	ltoa(l/10000, buf, 10);	// print the whole part
 	piLink.print(buf);
 	l = l % 10000;
-	piLink.print_P(PSTR(".%05d"), uint16_t(l));
+	piLink.print_P(PSTR(".%04d"), uint16_t(l));
 }
 
 void PiLink::sendJsonPair(const char* name, double val)
@@ -249,11 +375,31 @@ void PiLink::printSimulatorSettings()
 	sendJsonPair(SimulatorBeerConnected, simulator.getConnected(tempControl.beerSensor) ? "1" : "0");
 	sendJsonPair(SimulatorHeatPower, (uint16_t)simulator.getHeatPower());
 	sendJsonPair(SimulatorCoolPower, (uint16_t)simulator.getCoolPower());
+	sendJsonPair(SimulatorHeatEnergy, simulator.getHeatEnergy());
+	sendJsonPair(SimulatorCoolEnergy, simulator.getCoolEnergy());
+	sendJsonPair(SimulatorHeatLag, simulator.getHeaterLag().tau1);
+	sendJsonPair(SimulatorHeatLag2, simulator.getHeaterLag().tau2);
+	sendJsonPair(SimulatorCoolLag, simulator.getCoolerLag().tau1);
+	sendJsonPair(SimulatorCoolLag2, simulator.getCoolerLag().tau2);
+	sendJsonPair(SimulatorSensorModel, simulator.getSensorModel() ? "1" : "0");
+	sendJsonPair(SimulatorQuantize, simulator.getQuantizeTemperatures());
+	sendJsonPair(SimulatorBeerWell, simulator.getBeerProbe().wellLag);
+	sendJsonPair(SimulatorFridgeWell, simulator.getFridgeProbe().wellLag);
+	sendJsonPair(SimulatorBeerStuck, simulator.getBeerProbe().stuck ? "1" : "0");
+	sendJsonPair(SimulatorFridgeStuck, simulator.getFridgeProbe().stuck ? "1" : "0");
+	sendJsonPair(SimulatorBeerDropout, simulator.getBeerProbe().dropoutRate);
+	sendJsonPair(SimulatorFridgeDropout, simulator.getFridgeProbe().dropoutRate);
 	sendJsonPair(SimulatorCoeffRoom, simulator.getRoomCoefficient());
  	sendJsonPair(SimulatorCoeffBeer, simulator.getBeerCoefficient());
 	sendJsonPair(SimulatorDoorState, simulator.doorState() ? "1" : "0");
+	sendJsonPair(SimulatorDoorAirExchange, simulator.getDoorAirExchange());
 	sendJsonPair(SimulatorDoorState, printTempInterval);
   	sendJsonPair(SimulatorNoise, simulator.getSensorNoise());
+	sendJsonPair(SimulatorFermentPower, simulator.getFermentMaxPowerOutput());
+	sendJsonPair(SimulatorFermentLag, simulator.getFermentPhases().lagPhase);
+	sendJsonPair(SimulatorFermentLog, simulator.getFermentPhases().logPhase);
+	sendJsonPair(SimulatorFermentActive, simulator.getFermentPhases().activePhase);
+	sendJsonPair(SimulatorFermentStationary, simulator.getFermentPhases().stationaryPhase);
 		
 	sendJsonClose();		
 }
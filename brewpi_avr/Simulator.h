@@ -47,22 +47,13 @@
  * Round a value to the nearest multiple of a quantity.
  */
 inline double quantize(double value, double quantity) {
-	return int((value+(quantity/2.0))/quantity)*quantity;
+	return floor((value+(quantity/2.0))/quantity)*quantity;
 }
 
 /**
- * Represents a heat potential as temperature x thermal mass per degree.
+ * Time a DS18B20 takes for a 12 bit conversion, in seconds.
  */
-struct HeatPotential
-{
-	double temp;
-	double capacity;
-	
-	HeatPotential(double t1, double t2)	 {
-		temp = t1; 
-		capacity = t2;
-	}			
-};
+#define DS18B20_CONVERSION_TIME 0.75
 
 /**
  * Some pointer types to make casting nicer.
@@ -72,6 +63,354 @@ typedef Sensor<bool>*	PSensor;
 typedef ValueSensor<bool>*	PValueSensor;
 
 
+/**
+ * Exact discretization of the linear two-node fridge/beer model for a step of a given length.
+ * The model is x' = A x + u, with x = (fridge, beer) temperature and u the temperature independent input of each node
+ * in degrees per second (heater, cooler, room and fermentation).
+ *     A = | -(Kb+Ke)/Cf   Kb/Cf |
+ *         |  Kb/Cb       -Kb/Cb |
+ * With u constant over a step of h seconds, x(t+h) = F x(t) + G u, where F = e^(Ah) and G is the integral of
+ * e^(As) for s from 0 to h. For a 2x2 matrix, any function of A is c0*I + c1*A, with c0 and c1 found from
+ * the two eigenvalues, which are real and not positive for this A.
+ */
+struct ThermalTransition
+{
+	double seconds;
+	double Cf, Cb, Ke, Kb;		// model constants the matrices were computed for
+	double f11, f12, f21, f22;
+	double g11, g12, g21, g22;
+	
+	ThermalTransition() : seconds(0), Cf(0), Cb(0), Ke(0), Kb(0) {}
+		
+	void compute(double fridgeHeatCapacity, double beerHeatCapacity, double Ke, double Kb, double seconds)
+	{
+		this->seconds = seconds;
+		this->Cf = fridgeHeatCapacity;
+		this->Cb = beerHeatCapacity;
+		this->Ke = Ke;
+		this->Kb = Kb;
+		
+		double h = seconds;
+		double a11 = -(Kb+Ke)/fridgeHeatCapacity, a12 = Kb/fridgeHeatCapacity;
+		double a21 = Kb/beerHeatCapacity, a22 = -Kb/beerHeatCapacity;
+		double halfTrace = (a11+a22)/2;
+		double discriminant = halfTrace*halfTrace - (a11*a22 - a12*a21);
+		double root = discriminant > 0 ? sqrt(discriminant) : 0;
+		double l1 = halfTrace + root, l2 = halfTrace - root;
+		
+		double c0, c1, d0, d1;
+		if (root==0) {
+			// equal eigenvalues only happen for A = 0: no heat exchange at all
+			c0 = 1; c1 = 0;
+			d0 = h; d1 = 0;
+		}
+		else {
+			double e1 = exp(l1*h), e2 = exp(l2*h);
+			double i1 = l1==0 ? h : (e1-1)/l1;		// integral of e^(l*s)
+			double i2 = l2==0 ? h : (e2-1)/l2;
+			c0 = (l1*e2 - l2*e1)/(l1-l2);
+			c1 = (e1 - e2)/(l1-l2);
+			d0 = (l1*i2 - l2*i1)/(l1-l2);
+			d1 = (i1 - i2)/(l1-l2);
+		}
+		f11 = c0 + c1*a11;	f12 = c1*a12;
+		f21 = c1*a21;		f22 = c0 + c1*a22;
+		g11 = d0 + d1*a11;	g12 = d1*a12;
+		g21 = d1*a21;		g22 = d0 + d1*a22;
+	}
+};
+
+/**
+ * Lag between an actuator switching and its power reaching the fridge air: one or two first order stages in series,
+ * for example the compressor spinning up followed by the mass of the evaporator, or the mass of a heater element.
+ * A time constant of 0 removes a stage, with both at 0 the power follows the actuator instantly.
+ * The stages are solved exactly for an actuator held on or off over a step.
+ */
+struct ActuatorLag
+{
+	double tau1, tau2;			// time constants of the stages, s
+	double stage1, stage2;		// output of each stage, as a fraction of full power
+	
+	ActuatorLag() : tau1(0), tau2(0), stage1(0), stage2(0) {}
+	
+	/**
+	 * Whether the output is still moving towards the input, so that it is not constant over the next step.
+	 */
+	bool isSettling(bool on)
+	{
+		double input = on ? 1.0 : 0.0;
+		return (tau1>0 && fabs(stage1-input)>1e-4) || (tau2>0 && fabs(stage2-input)>1e-4);
+	}
+	
+	/**
+	 * Advances the stages by h seconds with the actuator held on or off.
+	 * @return the average output over the step, as a fraction of full power.
+	 */
+	double step(bool on, double h)
+	{
+		double u = on ? 1.0 : 0.0;
+		// stage 1: u + a*e^(-t/tau1)
+		double a = tau1>0 ? stage1-u : 0.0;
+		double end1 = tau1>0 ? u + a*exp(-h/tau1) : u;
+		double mean1 = tau1>0 ? u + a*expMean(tau1, h) : u;
+		if (tau2<=0) {
+			stage1 = stage2 = end1;
+			return mean1;
+		}
+		// stage 2 follows stage 1
+		double b, end2, mean2;
+		if (a==0) {
+			b = stage2-u;
+			end2 = u + b*exp(-h/tau2);
+			mean2 = u + b*expMean(tau2, h);
+		}
+		else if (fabs(tau1-tau2) < 1e-6*tau2) {
+			// equal time constants: u + (a*t/tau + b)*e^(-t/tau)
+			double tau = tau2, e = exp(-h/tau);
+			b = stage2-u;
+			end2 = u + (a*h/tau + b)*e;
+			mean2 = u + b*expMean(tau, h) + a*tau/h*(1-e*(1+h/tau));
+		}
+		else {
+			// u + c*e^(-t/tau1) + b*e^(-t/tau2)
+			double c = a*tau1/(tau1-tau2);
+			b = stage2-u-c;
+			end2 = u + c*exp(-h/tau1) + b*exp(-h/tau2);
+			mean2 = u + c*expMean(tau1, h) + b*expMean(tau2, h);
+		}
+		stage1 = end1;
+		stage2 = end2;
+		return mean2;
+	}
+	
+private:
+	// average of e^(-t/tau) for t from 0 to h
+	static double expMean(double tau, double h)
+	{
+		return tau/h*(1-exp(-h/tau));
+	}
+};
+
+/**
+ * A DS18B20 probe as the controller sees it through OneWireTempSensor. The probe sits in a thermowell, which follows
+ * the temperature around it with a first order lag. Each read returns the conversion requested by the read before it,
+ * sampled when that conversion finished, so the reading is older than the read by the read interval minus the
+ * conversion time. The value is quantized to the 1/16 degree of a 12 bit conversion by the Simulator.
+ * Faults: a stuck probe keeps returning its last reading, and any read can drop out with a given probability, which
+ * the controller sees as a disconnected sensor for that one read.
+ */
+struct SimulatedProbe
+{
+	double wellLag;			// time constant of the thermowell, s. 0 for a bare probe.
+	double dropoutRate;		// probability that a read fails
+	bool stuck;				// the reading no longer changes
+	bool dropped;			// the last read was a dropout
+	bool initialized;
+	double wellTemp;		// temperature of the probe
+	double lastTemp;		// temperature around the probe at the last step
+	double reading;			// last value returned, quantized
+	
+	SimulatedProbe() : wellLag(0), dropoutRate(0), stuck(false), dropped(false), initialized(false),
+		wellTemp(0), lastTemp(0), reading(0) {}
+	
+	/**
+	 * Advances the thermowell by h seconds, with the temperature around it moving linearly from its value at the last
+	 * step to temp. The lag is solved exactly for that ramp, so long steps give the same result as short ones.
+	 * A step of 0 seconds means the model is not running: the probe takes the temperature directly.
+	 * @param latency	how long before the end of the step the probe was sampled, in seconds.
+	 * @return the temperature of the probe at the time it was sampled.
+	 */
+	double sample(double temp, double h, double latency)
+	{
+		if (!initialized || h<=0) {
+			initialized = true;
+			wellTemp = lastTemp = temp;
+			return temp;
+		}
+		double start = wellTemp;
+		if (wellLag>0) {
+			// response to a ramp with slope r: temp - r*tau + (start - lastTemp + r*tau)*e^(-h/tau)
+			double rt = (temp-lastTemp)/h*wellLag;
+			wellTemp = temp - rt + (start - lastTemp + rt)*exp(-h/wellLag);
+		}
+		else
+			wellTemp = temp;
+		lastTemp = temp;
+		if (latency>=h)
+			return start;
+		return wellTemp - (wellTemp-start)*latency/h;
+	}
+};
+
+/**
+ * Phases of a fermentation, in hours, with the heat output of the yeast in each phase.
+ */
+struct FermentPhases
+{
+	FermentPhases(double lagPhase=8, double logPhase=12, double activePhase=24, double stationaryPhase=48)
+	{
+		this->lagPhase = lagPhase;                    // 0 heat output
+		this->logPhase = logPhase;                    // 0 -> max heat output, as more cells stop budding and start fermenting
+		this->activePhase = activePhase;              // hold at max - yeast fermenting at max rate
+		this->stationaryPhase = stationaryPhase;      // max -> 0  - prepare for stationary phase
+	}
+	
+	double lagPhase;
+	double logPhase;
+	double activePhase;
+	double stationaryPhase;
+	// todo - better to model this as time to consume all sugars, and compute power output from quantity of sugar.
+	
+	double duration() const { return lagPhase+logPhase+activePhase+stationaryPhase; }
+	
+	/**
+	 * Heat output at the given time since pitching, as a fraction of the maximum.
+	 */
+	double output(double hours) const
+	{
+		if (hours<lagPhase)
+			return 0;
+		hours -= lagPhase;
+		if (hours<logPhase)
+			return hours/logPhase;
+		hours -= logPhase;
+		if (hours<activePhase)
+			return 1;
+		hours -= activePhase;
+		if (hours<stationaryPhase)
+			return 1-hours/stationaryPhase;
+		return 0;
+	}
+};
+
+/**
+ * Number of points in the fermentation heat table.
+ */
+#define FERMENT_CURVE_POINTS 64
+
+/**
+ * Fermentation heat output over time, precomputed from FermentPhases or from a measured curve into a table of evenly
+ * spaced points. Each point is the output as a fraction of the maximum, in 1/255 units. Between points the output is
+ * interpolated linearly, after the last point it is 0.
+ */
+struct FermentCurve
+{
+	double interval;		// seconds between points, 0 for no output at all
+	uint8_t points[FERMENT_CURVE_POINTS];
+	
+	FermentCurve() : interval(0)
+	{
+		memset(points, 0, sizeof(points));
+	}
+	
+	void build(const FermentPhases& phases)
+	{
+		double step = phases.duration()/(FERMENT_CURVE_POINTS-1);
+		interval = step*3600;
+		for (uint8_t i=0; i<FERMENT_CURVE_POINTS; i++)
+			points[i] = toPoint(phases.output(i*step));
+	}
+	
+	/**
+	 * Builds the table from measured points, at increasing times since pitching. The output can be in any unit, the
+	 * table is scaled to its largest value.
+	 * @return the largest output.
+	 */
+	double build(const double* hours, const double* output, uint8_t count)
+	{
+		double peak = 0;
+		for (uint8_t i=0; i<count; i++)
+			if (output[i]>peak)
+				peak = output[i];
+		if (count<2 || peak<=0 || hours[count-1]<=0) {
+			interval = 0;
+			return 0;
+		}
+		double step = hours[count-1]/(FERMENT_CURVE_POINTS-1);
+		interval = step*3600;
+		uint8_t segment = 0;
+		for (uint8_t i=0; i<FERMENT_CURVE_POINTS; i++) {
+			double t = i*step;
+			while (segment+2<count && hours[segment+1]<=t)
+				segment++;
+			double t0 = hours[segment], t1 = hours[segment+1];
+			double f = t1>t0 ? constrain((t-t0)/(t1-t0), 0.0, 1.0) : 1.0;
+			points[i] = toPoint((output[segment] + f*(output[segment+1]-output[segment]))/peak);
+		}
+		return peak;
+	}
+	
+	/**
+	 * Heat output at the given time since pitching, as a fraction of the maximum.
+	 */
+	double at(unsigned long seconds) const
+	{
+		if (interval<=0)
+			return 0;
+		double x = seconds/interval;
+		if (x>=FERMENT_CURVE_POINTS-1)
+			return 0;
+		uint8_t i = uint8_t(x);
+		return (points[i] + (x-i)*(points[i+1]-points[i]))*(1/255.0);
+	}
+	
+private:
+	static uint8_t toPoint(double fraction)
+	{
+		return uint8_t(constrain(fraction, 0.0, 1.0)*255+0.5);
+	}
+};
+
+/**
+ * Room temperature following a sine between min and max over a day.
+ */
+inline double dailyRoomTemp(double minRoomTemp, double maxRoomTemp, unsigned long time)
+{
+	if (minRoomTemp==maxRoomTemp)
+		return minRoomTemp;
+	
+	unsigned long secondsInADay = 60*60*24UL;
+	double p = (double(time%secondsInADay)/double(secondsInADay))*(TWO_PI);
+	double s = sin(p);
+	double mid = (minRoomTemp+maxRoomTemp)/2;
+	double half = mid-minRoomTemp;
+	double r = mid + s*half;
+	return r;
+}
+
+/**
+ * Room temperature over time from another source than the daily sine, for example a recorded profile.
+ */
+class RoomTempSource
+{
+public:
+	virtual ~RoomTempSource() {}
+	
+	/**
+	 * @return the room temperature at the given simulated time, in seconds since the start of the simulation.
+	 */
+	virtual double roomTemp(unsigned long seconds) = 0;
+};
+
+/**
+ * Heat capacity in J/K of a fridge compartment of the given volume.
+ */
+inline double fridgeHeatCapacity(double volumeInLiters)
+{
+	double capacity = volumeInLiters * 1000 * VOL_HC_AIR; // Heat capacity potential in J of the fridge per deg C.
+	// assume a fridge made of steel with about 5kg of steel in the cabinet. Just a rough guess to provide some increased thermal mass.
+	capacity += 2 /*kg*/ * 0.5 /* SHC steel */ * 1000 /* kJ -> J */;
+	return capacity;
+}
+
+/**
+ * Heat capacity in J/K of the given volume of beer.
+ */
+inline double beerHeatCapacity(double volumeInLiters, double densitySG)
+{
+	return volumeInLiters * densitySG * 1000 * MASS_HC_WATER;             // Heat capacity potential in J of the beer per deg C.
+}
+
 class Simulator
 {
 public:	
@@ -89,58 +428,144 @@ public:
 		: time(_time), fridgeVolume(_fridgeVolume), beerDensity(_beerSG), beerTemp(_beerTemp),
 		beerVolume(_beerVolume), minRoomTemp(_minRoomTemp), maxRoomTemp(_maxRoomTemp), fridgeTemp(_fridgeTemp),
 		heatPower(_heatPower), coolPower(_coolPower), quantizeTempOutput(_quantizeTempOutput),
-		Ke(_coefficientChamberRoom), Kb(_coefficientChamberBeer), sensorNoise(_sensorNoise)
+		Ke(_coefficientChamberRoom), Kb(_coefficientChamberBeer), sensorNoise(_sensorNoise), control(&tempControl)
 		{
 			setBeerVolume(beerVolume);
 			setFridgeVolume(fridgeVolume);
 			time = 0;
+			timeMillis = 0;
 			fermentPowerMax = 5;    // todo - rather max power, parameter should be ferment time, and compute power from moles of sugar
+			fermentCurve.build(fermentPhases);
 			heating = false;
 			cooling = false;
 			doorOpen = false;
+			doorAirExchange = 2;
+			heatOutput = 0;
+			coolOutput = 0;
+			heatEnergy = 0;
+			coolEnergy = 0;
+			coolHeat = 0;
+			coolerPower = 0;
+			coolantTemp = 0;
+			coolantConductance = 0;
+			coolingAvailable = true;
+			roomSource = NULL;
+			sensorModel = false;
+			randomState = 1;
                         enabled = true;
 		}
 
-	struct TempPair
-	{
-		double t1;
-		double t2;
-	};
-
 	void step() {
+		step(1);
+	}
+	
+	/**
+	 * Advances the model by the given number of seconds.
+	 * The heater, cooler, fermentation and room temperature are held at their values at the start of the step.
+	 * For those inputs the result is exact for any step length, see ThermalTransition.
+	 * While the power of an actuator is still settling after a switch, see ActuatorLag, the time is advanced in
+	 * steps of one second with the average power of each second.
+	 */
+	void step(unsigned long seconds) {
+		stepMillis(seconds*1000);
+	}
+
+	/**
+	 * Advances the model by the given number of milliseconds, for control ticks shorter than a second.
+	 */
+	void stepMillis(unsigned long millis) {
+		unsigned long stepped = 0;
             if (enabled)
             {
+			stepped = millis;
             
-		heating = tempControl.stateIsHeating();
-		cooling = tempControl.stateIsCooling();
-		doorOpen = PSensor(tempControl.door)->sense();
+		heating = control->stateIsHeating();
+		cooling = control->stateIsCooling() && coolingAvailable;
+		doorOpen = PSensor(control->door)->sense();
 		// with no serial and no calculation here we get 1500-2000x speedup
 		// with this code enabled, around 1300x speedup
 		// with serial, drops to 300x speedup
-		double fermDiff = beerFerment();
-		double heatingDiff = chamberHeating();
-		double coolingDiff = chamberCooling();
-		double doorDiff = doorLosses();
-
-		double newBeerTemp = beerTemp + fermDiff;
-		double newFridgeTemp = fridgeTemp + heatingDiff + coolingDiff + doorDiff;
+		
+		// while an actuator lag settles its power is not constant, so the model is only exact in short steps
+		while (millis>1000 && (heaterLag.isSettling(heating) || coolerLag.isSettling(cooling))) {
+			advance(1000);
+			millis -= 1000;
+		}
+		advance(millis);
+            }
+                updateSensors(stepped);
+	}
+	
+	/**
+	 * Sets the time constants in seconds of the stages between switching the heater or cooler and the power reaching
+	 * the fridge air. See ActuatorLag. 0 for both gives an instant response, the default.
+	 */
+	void setHeaterLag(double tau1, double tau2=0) { heaterLag.tau1 = tau1; heaterLag.tau2 = tau2; }
+	void setCoolerLag(double tau1, double tau2=0) { coolerLag.tau1 = tau1; coolerLag.tau2 = tau2; }
+	ActuatorLag& getHeaterLag() { return heaterLag; }
+	ActuatorLag& getCoolerLag() { return coolerLag; }
+	
+	/**
+	 * Cools the fridge with a coolant, such as glycol from a shared chiller, instead of a cooler of fixed power.
+	 * While cooling, the fridge loses conductance*(fridge-coolant) W, taken at the start of each step. A conductance
+	 * of 0, the default, gives the cooler its fixed power again.
+	 */
+	void setCoolant(double temp, double conductance) { coolantTemp = temp; coolantConductance = conductance; }
+	
+	/**
+	 * When the cooling is not available, the cooler has no effect even when the controller switches it on, like a
+	 * glycol valve held closed. The cooling is available by default.
+	 */
+	void setCoolingAvailable(bool available) { coolingAvailable = available; }
+	
+	/**
+	 * Heat removed from the fridge by the cooler since the start of the simulation, in J.
+	 */
+	double getCoolHeat() { return coolHeat; }
 
-		TempPair beerTx;
-		TempPair roomTx;
+private:
+	/**
+	 * Advances the model with the outputs, the fermentation and the room temperature held over the step.
+	 */
+	void advance(unsigned long millis) {
+		double seconds = millis/1000.0;
 		currentRoomTemp = roomTemp();
-		chamberBeerTransfer(fridgeTemp, beerTemp, beerTx);
-		chamberRoomTransfer(fridgeTemp, currentRoomTemp, roomTx);
-
-		newFridgeTemp += beerTx.t1 + roomTx.t1;		// transfer from beer and environment
-		newBeerTemp += beerTx.t2;
-
+		heatOutput = heaterLag.step(heating, seconds);
+		coolOutput = coolerLag.step(cooling, seconds);
+		
+		// a coolant cools with the temperature difference at the start of the step
+		coolerPower = coolPower;
+		if (coolantConductance>0)
+			coolerPower = fridgeTemp>coolantTemp ? coolantConductance*(fridgeTemp-coolantTemp) : 0.0;
+		coolHeat += coolOutput*coolerPower*seconds;
+		
+		// temperature change per second of each node that does not depend on the node temperatures
+		// an open door exchanges fridge air with room air, which adds to the conductance to the room
+		double roomConductance = Ke + doorConductance();
+		double fridgeInput = chamberHeating() + chamberCooling() + roomConductance*currentRoomTemp/fridgeHeatCapacity;
+		double beerInput = beerFerment();
+		
+		ThermalTransition& transition = doorOpen ? doorTransition : closedTransition;
+		updateTransition(transition, roomConductance, seconds);
+		double newFridgeTemp = transition.f11*fridgeTemp + transition.f12*beerTemp + transition.g11*fridgeInput + transition.g12*beerInput;
+		double newBeerTemp = transition.f21*fridgeTemp + transition.f22*beerTemp + transition.g21*fridgeInput + transition.g22*beerInput;
+		
 		fridgeTemp = newFridgeTemp;
 		beerTemp = newBeerTemp;
 
-		time += 1;
-            }
-                updateSensors();
+		// the outputs are held over the step, so their energy is exact. The actuators draw their power while on,
+		// also while their heat is still lagging.
+		if (heating)
+			heatEnergy += double(heatPower)*seconds;
+		if (cooling)
+			coolEnergy += double(coolPower)*seconds;
+
+		timeMillis += millis;
+		time += timeMillis/1000;
+		timeMillis %= 1000;
 	}
+
+public:
 	
 	/**
 	 * Set the beer temperature.
@@ -164,6 +589,15 @@ public:
 	int getHeatPower() { return this->heatPower; }
 	void setCoolPower(int coolPowerInWatts) { this->coolPower = coolPowerInWatts; }
 	int getCoolPower() { return this->coolPower; }
+
+	/**
+	 * Energy used by the heater and the cooler since the start of the simulation, in Wh.
+	 * Setting them allows the meters to be reset.
+	 */
+	double getHeatEnergy() { return heatEnergy/3600; }
+	void setHeatEnergy(double wattHours) { heatEnergy = wattHours*3600; }
+	double getCoolEnergy() { return coolEnergy/3600; }
+	void setCoolEnergy(double wattHours) { coolEnergy = wattHours*3600; }
 	
 	double getQuantizeTemperatures() { return this->quantizeTempOutput; }
 	void setQuantizeTemperatures(double interval) { this->quantizeTempOutput = interval; }
@@ -175,13 +609,32 @@ public:
 		
 	void setFermentMaxPowerOutput(double max) { this->fermentPowerMax = max; }
 	double getFermentMaxPowerOutput() { return fermentPowerMax; }
+	
+	/**
+	 * Sets the phases of the fermentation heat output, see FermentPhases. The output over time is precomputed into the
+	 * fermentation heat table.
+	 */
+	void setFermentPhases(const FermentPhases& phases)
+	{
+		fermentPhases = phases;
+		fermentCurve.build(fermentPhases);
+	}
+	const FermentPhases& getFermentPhases() { return fermentPhases; }
+	
+	/**
+	 * Replaces the fermentation heat output by a measured curve: the output in W at increasing hours since pitching.
+	 * The maximum output becomes the largest value of the curve.
+	 */
+	void setFermentCurve(const double* hours, const double* watts, uint8_t count)
+	{
+		fermentPowerMax = fermentCurve.build(hours, watts, count);
+	}
+	const FermentCurve& getFermentCurve() { return fermentCurve; }
 
 	void setFridgeVolume(unsigned int volumeInLiters)
 	{
 		fridgeVolume = volumeInLiters;
-		fridgeHeatCapacity = fridgeVolume * 1000 * VOL_HC_AIR; // Heat capacity potential in J of the fridge per deg C.
-		// assume a fridge made of steel with about 5kg of steel in the cabinet. Just a rough guess to provide some increased thermal mass.
-		fridgeHeatCapacity += 2 /*kg*/ * 0.5 /* SHC steel */ * 1000 /* kJ -> J */;
+		fridgeHeatCapacity = ::fridgeHeatCapacity(fridgeVolume);
 	}
 
 	double getFridgeVolume() { return fridgeVolume; }
@@ -200,6 +653,12 @@ public:
 	}
 	
 	bool doorState() { return doorOpen; }
+	
+	/**
+	 * Sets how many times per minute the air in the fridge is replaced by room air while the door is open.
+	 */
+	void setDoorAirExchange(double volumesPerMinute) { doorAirExchange = volumesPerMinute; }
+	double getDoorAirExchange() { return doorAirExchange; }
 
 	void setConnected(TempSensor* sensor, bool connected) 
 	{	
@@ -217,6 +676,21 @@ public:
 		externalSensor->setValue(newSetting);
 	}
 	
+	/**
+	 * Enables the DS18B20 model for the beer and fridge probes, see SimulatedProbe. When disabled, the default, the
+	 * sensors receive the model temperatures with only the sensor noise added.
+	 */
+	void setSensorModel(bool enabled) { sensorModel = enabled; }
+	bool getSensorModel() { return sensorModel; }
+	SimulatedProbe& getBeerProbe() { return beerProbe; }
+	SimulatedProbe& getFridgeProbe() { return fridgeProbe; }
+	
+	/**
+	 * Seeds the generator for the sensor noise and the probe dropouts. Each simulator has its own, so chambers can
+	 * run in parallel.
+	 */
+	void setRandomSeed(uint32_t seed) { randomState = seed ? seed : 1; }
+
 	void setSensorNoise(double noise) {
 		this->sensorNoise = noise;
 	}
@@ -226,30 +700,83 @@ public:
 
 	double roomTemp()
 	{
-		if (minRoomTemp==maxRoomTemp)
-			return minRoomTemp;
-		
-		unsigned long secondsInADay = 60*60*24UL;
-		double p = (double(time%secondsInADay)/double(secondsInADay))*(TWO_PI);
-		double s = sin(p);
-		double mid = (minRoomTemp+maxRoomTemp)/2;
-		double half = mid-minRoomTemp;
-		double r = mid + s*half;
-		return r;
+		if (roomSource)
+			return roomSource->roomTemp(time);
+		return dailyRoomTemp(minRoomTemp, maxRoomTemp, time);
 	}
+	
+	/**
+	 * Takes the room temperature from a source instead of the daily sine between the minimum and maximum.
+	 * The source is not owned by the simulator, NULL returns to the sine. Copies of the simulator share the source.
+	 */
+	void setRoomTempSource(RoomTempSource* source) { roomSource = source; }
+	RoomTempSource* getRoomTempSource() { return roomSource; }
         
         void setSimulationEnabled(bool enabled) {
             this->enabled = enabled;
         }
 
+	/**
+	 * Sets the controller whose outputs drive this simulation and whose sensors receive the simulated temperatures.
+	 * Defaults to the global tempControl. Only meaningful when TEMP_CONTROL_STATIC is 0.
+	 */
+	void setTempControl(TempControl* control) { this->control = control; }
+	TempControl* getTempControl() { return control; }
+
 private:	
 
-	void updateSensors()
+	void updateSensors(unsigned long millis)
+	{
+		if (sensorModel) {
+			updateProbe(control->beerSensor, beerProbe, beerTemp, millis/1000.0);
+			updateProbe(control->fridgeSensor, fridgeProbe, fridgeTemp, millis/1000.0);
+		}
+		else {
+			// add noise to the simulated temperature
+			setTemp(control->beerSensor, beerTemp+noise());
+			setTemp(control->fridgeSensor, fridgeTemp+noise());
+		}
+		setBasicTemp(*(ExternalTempSensor*)control->ambientSensor, currentRoomTemp);		
+	}
+
+	void updateProbe(TempSensor* sensor, SimulatedProbe& probe, double temp, double seconds)
 	{
-		// add noise to the simulated temperature
-		setTemp(tempControl.beerSensor, beerTemp+noise());
-		setTemp(tempControl.fridgeSensor, fridgeTemp+noise());
-		setBasicTemp(*(ExternalTempSensor*)tempControl.ambientSensor, currentRoomTemp);		
+		ExternalTempSensor& s = (ExternalTempSensor&)(sensor->sensor());
+		bool first = !probe.initialized;
+		// the sensors are read once per tick, the value read was converted a tick earlier. A tick shorter than a
+		// conversion reads a conversion that has just finished, as at a lower resolution.
+		double readInterval = control->getTickTime()/1000.0;
+		double latency = readInterval>DS18B20_CONVERSION_TIME ? readInterval-DS18B20_CONVERSION_TIME : 0.0;
+		double sampled = probe.sample(temp, seconds, latency);
+		if (!probe.stuck || first)
+			probe.reading = outputTemp(sampled+noise());
+		setBasicTemp(s, probe.reading);
+		
+		// an uninstalled probe is the default sensor, which is no ExternalTempSensor and can't drop out
+		if (deviceManager.isDefaultTempSensor(&s))
+			return;
+
+		// a dropout lasts one read, a sensor disconnected from outside stays disconnected
+		bool drop = probe.dropoutRate>0 && uniformRandom()<probe.dropoutRate;
+		if (drop && s.isConnected()) {
+			s.setConnected(false);
+			probe.dropped = true;
+		}
+		else if (!drop && probe.dropped) {
+			s.setConnected(true);
+			probe.dropped = false;
+		}
+	}
+
+	/**
+	 * Uniform random number in [0, 1) from a xorshift generator.
+	 */
+	double uniformRandom()
+	{
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 17;
+		randomState ^= randomState << 5;
+		return randomState/4294967296.0;
 	}
 
 	void setBasicTemp(ExternalTempSensor& sensor, double temp)
@@ -266,54 +793,32 @@ private:
 	}
 	
 	double noise() {
-		return sensorNoise==0.0 ? 0.0 : random(sensorNoise*1000.0)/1000.0;
+		return sensorNoise==0.0 ? 0.0 : uniformRandom()*sensorNoise;
 	}
 
 
-	void chamberBeerTransfer(double fridgeTemp, double beerTemp, TempPair& result)
-	{		
-		heatTransfer(HeatPotential(fridgeTemp, fridgeHeatCapacity), HeatPotential(beerTemp, beerHeatCapacity),
-			Kb, result);
-	}	
-
-	void chamberRoomTransfer(double fridgeTemp, double roomTemp, TempPair& result)
-	{
-		heatTransfer(HeatPotential(fridgeTemp, fridgeHeatCapacity),
-			HeatPotential(roomTemp, fridgeHeatCapacity), Ke, result);
-	}
-
-	/* Compute the heat transferred between two heat energy potentials. Returns the temperature change
-			of each potential. */
-	void heatTransfer(const HeatPotential& p1, const HeatPotential& p2, double k, TempPair& result)
+	/**
+	 * Recomputes the cached discretization when the step length or the model constants changed.
+	 */
+	void updateTransition(ThermalTransition& transition, double roomConductance, double seconds)
 	{
-		double e1 = (p2.temp-p1.temp)*k;		// the energy transferred - from p2 to p1	
-		result.t1 = e1/p1.capacity;				// change in temperature for the increase in energy
-		result.t2 = -e1/p2.capacity;
+		if (transition.seconds!=seconds || transition.Cf!=fridgeHeatCapacity || transition.Cb!=beerHeatCapacity
+			|| transition.Ke!=roomConductance || transition.Kb!=Kb)
+			transition.compute(fridgeHeatCapacity, beerHeatCapacity, roomConductance, Kb, seconds);
 	}
 
 	double chamberHeating()
 	{
-		return heating ? (heatPower / fridgeHeatCapacity) : 0.0;
+		return heatOutput * heatPower / fridgeHeatCapacity;
 	}
 
 	double chamberCooling()
 	{
-		return cooling ? -(coolPower / fridgeHeatCapacity) : 0.0;
+		return -(coolOutput * coolerPower / fridgeHeatCapacity);
 	}
 	
-	double hours() { return time/3600.0; }
-
 	double beerFerment() {
-		double days = hours()/24.0;
-		double scale = 0;
-		if (days>5) 
-			scale = 0;
-		else if (days>2)
-			scale = 1.0-((days-3)/3);
-		else if (days>1)
-			scale = 1.0;
-		double power = scale*fermentPowerMax;
-		return power / beerHeatCapacity;
+		return fermentCurve.at(time)*fermentPowerMax / beerHeatCapacity;
 	}
 
 	double outputBeerTemp() {
@@ -325,20 +830,26 @@ private:
 	}
 
 	double outputTemp(double temp) {
-		return quantize(temp, quantizeTempOutput);
+		return quantizeTempOutput>0 ? quantize(temp, quantizeTempOutput) : temp;
 	}		
 
-	double doorLosses(){
-		return 0.0;
+	/**
+	 * Conductance in W/K between the fridge and the room through the open door: the heat capacity of the air exchanged
+	 * per second.
+	 */
+	double doorConductance()
+	{
+		return doorOpen ? fridgeVolume*1000*VOL_HC_AIR*doorAirExchange/60 : 0.0;
 	}		
 		
 	void updateBeerCapacity()
 	{
-		beerHeatCapacity = beerVolume * beerDensity * 1000 * MASS_HC_WATER;             // Heat capacity potential in J of the beer per deg C.		
+		beerHeatCapacity = ::beerHeatCapacity(beerVolume, beerDensity);
 	}		
 
 	bool enabled;
 	unsigned long time;               // time since start of simulation in seconds
+	unsigned int timeMillis;          // milliseconds since the last whole second
 	int fridgeVolume;     // liters
 	double beerDensity;    // SG
 	double beerTemp;          // C
@@ -353,6 +864,14 @@ private:
 	double Kb;   // just a guess               // W / K  - thermal conductivity compartment <> beer
 	double sensorNoise;          // how many quantization units of noise is generated
 	
+	/**
+	 * When true, the beer and fridge sensors read through the probe model.
+	 */
+	bool sensorModel;
+	SimulatedProbe beerProbe;
+	SimulatedProbe fridgeProbe;
+	uint32_t randomState;
+	
 	/**
 	 * When true, the heater is active.
 	 */
@@ -366,6 +885,35 @@ private:
 	 * When true, the door is open.
 	 */
 	bool doorOpen;
+	double doorAirExchange;		// volumes of fridge air replaced by room air per minute while the door is open
+
+	/**
+	 * Power reaching the fridge air from the heater and the cooler, averaged over the last step, as a fraction of
+	 * their full power.
+	 */
+	double heatOutput;
+	double coolOutput;
+	ActuatorLag heaterLag;
+	ActuatorLag coolerLag;
+	
+	/**
+	 * Energy used by the heater and the cooler, in J.
+	 */
+	double heatEnergy;
+	double coolEnergy;
+	
+	/**
+	 * Heat removed by the cooler, in J, and the cooling power over the last step, in W.
+	 */
+	double coolHeat;
+	double coolerPower;
+	
+	/**
+	 * Coolant cooling the fridge instead of a cooler of fixed power, see setCoolant().
+	 */
+	double coolantTemp;
+	double coolantConductance;		// W/K, 0 when not used
+	bool coolingAvailable;
 	
 	/**
 	 * Thermal mass of the fridge compartment. 
@@ -383,39 +931,41 @@ private:
 	 */			
 	double fermentPowerMax;		
 	
+	/**
+	 * Fermentation heat output over time as a fraction of fermentPowerMax, built from fermentPhases unless a measured
+	 * curve was set.
+	 */
+	FermentPhases fermentPhases;
+	FermentCurve fermentCurve;
+	
 	double currentRoomTemp;
-};
-
-
-
-// Work in progress
-struct FermentPhases
-{
-	FermentPhases(double lagPhase=8, double logPhase=12, double activePhase=24, double stationaryPhase=48)
-	{
-		this->lagPhase = lagPhase;                    // 0 heat output
-		this->logPhase = logPhase;                    // 0 -> max heat output, as more cells stop budding and start fermenting
-		this->activePhase = activePhase;              // hold at max - yeast fermenting at max rate
-		this->stationaryPhase = stationaryPhase;      // max -> 0  - prepare for stationary phase
-	}
+	RoomTempSource* roomSource;
 	
-	double lagPhase;
-	double logPhase;
-	double activePhase;
-	double stationaryPhase;
-	// todo - better to model this as time to consume all sugars, and compute power output from quantity of sugar.
+	TempControl* control;
 	
+	/**
+	 * Cached discretization of the model for the last step length, with the door closed and open.
+	 */
+	ThermalTransition closedTransition;
+	ThermalTransition doorTransition;
 };
 
+
+
 extern Simulator simulator;
 
 /**
  * Set the time scale factor. A run factor of 0 pauses the simulator. 
- * \param factor  A run factor of 1 runs at real time. 
- *	A run factor >1  runs as accelerated time. Accurate up to ca. 500.
+ * \param factor  A run factor of 1 runs at real time, in fixed point so fractional factors are kept.
+ *	A run factor >1  runs as accelerated time, paced by micros() without drift for as long as the loop keeps up.
  *	A run factor of -1 runs at full speed.
  */
-void setRunFactor(temperature factor);
+void setRunFactor(long_temperature factor);
+
+/**
+ * Advances the ticks by a simulated second when the run factor says one is due. Called from simulateLoop().
+ */
+void updateSimulationTicks();
 
 /**
  * Callback for handling the simulator JSON config.
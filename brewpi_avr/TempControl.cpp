@@ -21,6 +21,7 @@
 
 #include "Pins.h"
 #include <limits.h>
+#include <string.h>
 
 #include "TemperatureFormats.h"
 #include "TempControl.h"
@@ -34,12 +35,15 @@
 
 TempControl tempControl;
 
-#if TEMP_CONTROL_STATIC
-
 extern ValueSensor<bool> defaultSensor;
 extern ValueActuator defaultActuator;
 extern DisconnectedTempSensor defaultTempSensor;
 
+ValueActuator cameraLightState;		
+AutoOffActuator TempControl::cameraLight(600, &cameraLightState);	// timeout 10 min
+
+#if TEMP_CONTROL_STATIC
+
 // These sensors are switched out to implement multi-chamber.
 TempSensor* TempControl::beerSensor;
 TempSensor* TempControl::fridgeSensor;
@@ -51,14 +55,18 @@ Actuator* TempControl::cooler = &defaultActuator;
 Actuator* TempControl::light = &defaultActuator;
 Actuator* TempControl::fan = &defaultActuator;
 
-ValueActuator cameraLightState;		
-AutoOffActuator TempControl::cameraLight(600, &cameraLightState);	// timeout 10 min
 Sensor<bool>* TempControl::door = &defaultSensor;
 	
 // Control parameters
 ControlConstants TempControl::cc;
 ControlSettings TempControl::cs;
 ControlVariables TempControl::cv;
+#if BREWPI_CONTROL_KPI
+ControlKpi TempControl::kpi;
+#endif
+#if BREWPI_BEER_PROFILE
+BeerProfile TempControl::profile;
+#endif
 	
 	// State variables
 uint8_t TempControl::state;
@@ -74,13 +82,59 @@ uint16_t TempControl::lastIdleTime;
 uint16_t TempControl::lastHeatTime;
 uint16_t TempControl::lastCoolTime;
 uint16_t TempControl::waitTime;
+uint16_t TempControl::integralUpdateCounter;
+
+uint16_t TempControl::tickMillis = BREWPI_TICK_MILLIS;
+uint16_t TempControl::integralTicks = 60000UL/BREWPI_TICK_MILLIS;
+uint8_t TempControl::filterShift = TICK_FILTER_SHIFT(BREWPI_TICK_MILLIS);
+
+#if BREWPI_ENERGY_METER
+uint32_t TempControl::heaterOnTime;
+uint32_t TempControl::coolerOnTime;
+ticks_seconds_t TempControl::lastMeterTime;
+#endif
+
+#if BREWPI_INCREMENTAL_CONTROL
+PidInputs TempControl::pidInputs;
+StateInputs TempControl::stateInputs;
+ticks_seconds_t TempControl::stateEvaluated;
+uint16_t TempControl::stateStableTime;
+uint16_t TempControl::stateWaitTime;
+bool TempControl::stateWaitCounts;
+#endif
+
+#else
+
+TempControl::TempControl(TicksImpl& clock)
+	: beerSensor(NULL), fridgeSensor(NULL), ambientSensor(&defaultTempSensor),
+	heater(&defaultActuator), cooler(&defaultActuator), light(&defaultActuator), fan(&defaultActuator),
+	door(&defaultSensor), cc(), cs(), cv(), storedBeerSetting(0),
+	lastIdleTime(0), lastHeatTime(0), lastCoolTime(0), waitTime(0), integralUpdateCounter(0),
+	tickMillis(BREWPI_TICK_MILLIS), integralTicks(60000UL/BREWPI_TICK_MILLIS), filterShift(TICK_FILTER_SHIFT(BREWPI_TICK_MILLIS)),
+	state(IDLE), doPosPeakDetect(false), doNegPeakDetect(false), doorOpen(false),
+#if BREWPI_ENERGY_METER
+	heaterOnTime(0), coolerOnTime(0), lastMeterTime(0),
+#endif
+#if BREWPI_INCREMENTAL_CONTROL
+	pidInputs(), stateInputs(), stateEvaluated(0), stateStableTime(0), stateWaitTime(0), stateWaitCounts(false),
+#endif
+	ticks(clock)
+{
+}
+
+bool TempControl::isPrimary() {
+	return this==&tempControl;
+}
+
 #endif
 
 void TempControl::init(void){
 	state=IDLE;		
 	cs.mode = MODE_OFF;
 	
-	cameraLight.setActive(false);
+	if(isPrimary()){
+		cameraLight.setActive(false);
+	}
 	
 	// this is for cases where the device manager hasn't configured beer/fridge sensor.	
 	if (beerSensor==NULL) {
@@ -95,12 +149,16 @@ void TempControl::init(void){
 	
 	updateTemperatures();
 	reset();
+	forceUpdate();
 	
 	// Do not allow heating/cooling directly after reset.
 	// A failing script + CRON + Arduino uno (which resets on serial connect) could damage the compressor
 	// For test purposes, set these to -3600 to eliminate waiting after reset
 	lastHeatTime = 0;
 	lastCoolTime = 0;
+#if BREWPI_ENERGY_METER
+	lastMeterTime = ticks.seconds();
+#endif
 }
 
 void TempControl::reset(void){
@@ -128,8 +186,17 @@ void TempControl::updateTemperatures(void){
 }
 
 void TempControl::updatePID(void){
-	static unsigned char integralUpdateCounter = 0;
-	if(tempControl.modeIsBeer()){
+#if BREWPI_BEER_PROFILE
+	if(cs.mode == MODE_BEER_PROFILE && profile.isActive()){
+		// the profile on the controller takes the place of the settings sent by the script
+		temperature newSetting = profile.update(ticks.millis());
+		if(abs(newSetting - cs.beerSetting) > intToTempDiff(1)/2){
+			reset(); // a step in the profile, reset the controller as setBeerTemp does
+		}
+		cs.beerSetting = newSetting;
+	}
+#endif
+	if(modeIsBeer()){
 		if(cs.beerSetting == INVALID_TEMP){
 			// beer setting is not updated yet
 			// set fridge to unknown too
@@ -137,12 +204,32 @@ void TempControl::updatePID(void){
 			return;
 		}
 		
+#if BREWPI_INCREMENTAL_CONTROL
+		PidInputs inputs;
+		inputs.diffIntegral = cv.diffIntegral;
+		inputs.beerSetting = cs.beerSetting;
+		inputs.fridgeSetting = cs.fridgeSetting;
+		inputs.beerSlowFiltered = beerSensor->readSlowFiltered();
+		inputs.beerSlope = beerSensor->readSlope();
+		inputs.Kp = cc.Kp;
+		inputs.Ki = cc.Ki;
+		inputs.Kd = cc.Kd;
+		inputs.pidMax = cc.pidMax;
+		inputs.tempSettingMin = cc.tempSettingMin;
+		inputs.tempSettingMax = cc.tempSettingMax;
+		// Between integrator updates the result only depends on the inputs. When none changed, it is what it was.
+		if(integralUpdateCounter != integralTicks && memcmp(&inputs, &pidInputs, sizeof(inputs)) == 0){
+			integralUpdateCounter++;
+			return;
+		}
+#endif
+		
 		// fridge setting is calculated with PID algorithm. Beer temperature error is input to PID
 		cv.beerDiff =  cs.beerSetting - beerSensor->readSlowFiltered();
 		cv.beerSlope = beerSensor->readSlope();
 		temperature fridgeFastFiltered = fridgeSensor->readFastFiltered();
 			
-		if(integralUpdateCounter++ == 60){
+		if(integralUpdateCounter++ == integralTicks){
 			integralUpdateCounter = 0;
 			
 			temperature integratorUpdate = cv.beerDiff;
@@ -198,6 +285,11 @@ void TempControl::updatePID(void){
 		newFridgeSetting = constrain(constrainTemp16(newFridgeSetting), cs.beerSetting - cc.pidMax, cs.beerSetting + cc.pidMax);
 		// constrain within absolute limits
 		cs.fridgeSetting = constrain(constrainTemp16(newFridgeSetting), cc.tempSettingMin, cc.tempSettingMax);
+#if BREWPI_INCREMENTAL_CONTROL
+		pidInputs = inputs;
+		pidInputs.diffIntegral = cv.diffIntegral;
+		pidInputs.fridgeSetting = cs.fridgeSetting;
+#endif
 	}
 	else if(cs.mode == MODE_FRIDGE_CONSTANT){
 		// FridgeTemperature is set manually, use INVALID_TEMP to indicate beer temp is not active
@@ -212,9 +304,16 @@ void TempControl::updateState(void){
 		
 	if(newDoorOpen!=doorOpen) {
 		doorOpen = newDoorOpen;
-		piLink.printFridgeAnnotation(PSTR("Fridge door %S"), doorOpen ? PSTR("opened") : PSTR("closed"));
+		if(isPrimary())
+			piLink.printFridgeAnnotation(PSTR("Fridge door %S"), doorOpen ? PSTR("opened") : PSTR("closed"));
 	}
 
+#if BREWPI_INCREMENTAL_CONTROL
+	if(stateUnchanged(ticks.seconds())){
+		return;
+	}
+#endif
+
 	if(cs.mode == MODE_OFF){
 		state = STATE_OFF;
 		stayIdle = true;
@@ -222,7 +321,7 @@ void TempControl::updateState(void){
 	// stay idle when one of the required sensors is disconnected, or the fridge setting is INVALID_TEMP
 	if( cs.fridgeSetting == INVALID_TEMP || 
 		!fridgeSensor->isConnected() || 
-		(!beerSensor->isConnected() && tempControl.modeIsBeer())){
+		(!beerSensor->isConnected() && modeIsBeer())){
 		state = IDLE;
 		stayIdle = true;
 	}
@@ -248,18 +347,18 @@ void TempControl::updateState(void){
 			}
 			resetWaitTime();
 			if(fridgeFast > (cs.fridgeSetting+cc.idleRangeHigh) ){  // fridge temperature is too high			
-				tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceHeating);			
+				updateWaitTime(MIN_SWITCH_TIME, sinceHeating);			
 				if(cs.mode==MODE_FRIDGE_CONSTANT){
-					tempControl.updateWaitTime(MIN_COOL_OFF_TIME_FRIDGE_CONSTANT, sinceCooling);
+					updateWaitTime(MIN_COOL_OFF_TIME_FRIDGE_CONSTANT, sinceCooling);
 				}
 				else{
 					if(beerFast < (cs.beerSetting + 16) ){ // If beer is already under target, stay/go to idle. 1/2 sensor bit idle zone
 						state = IDLE; // beer is already colder than setting, stay in or go to idle
 						break;
 					}
-					tempControl.updateWaitTime(MIN_COOL_OFF_TIME, sinceCooling);
+					updateWaitTime(MIN_COOL_OFF_TIME, sinceCooling);
 				}
-				if(tempControl.cooler != &defaultActuator){
+				if(cooler != &defaultActuator){
 					if(getWaitTime() > 0){
 						state = WAITING_TO_COOL;
 					}
@@ -269,15 +368,15 @@ void TempControl::updateState(void){
 				}
 			}
 			else if(fridgeFast < (cs.fridgeSetting+cc.idleRangeLow)){  // fridge temperature is too low
-				tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceCooling);
-				tempControl.updateWaitTime(MIN_HEAT_OFF_TIME, sinceHeating);
+				updateWaitTime(MIN_SWITCH_TIME, sinceCooling);
+				updateWaitTime(MIN_HEAT_OFF_TIME, sinceHeating);
 				if(cs.mode!=MODE_FRIDGE_CONSTANT){
 					if(beerFast > (cs.beerSetting - 16)){ // If beer is already over target, stay/go to idle. 1/2 sensor bit idle zone
 						state = IDLE;  // beer is already warmer than setting, stay in or go to idle
 						break;
 					}
 				}
-				if(tempControl.heater != &defaultActuator || (cc.lightAsHeater && (tempControl.light != &defaultActuator))){
+				if(heater != &defaultActuator || (cc.lightAsHeater && (light != &defaultActuator))){
 					if(getWaitTime() > 0){
 						state = WAITING_TO_HEAT;
 					}
@@ -344,9 +443,106 @@ void TempControl::updateState(void){
 			}
 		}
 		break;
-	}			
+	}
+#if BREWPI_INCREMENTAL_CONTROL
+	updateStableTime(stayIdle, sinceIdle, sinceCooling, sinceHeating);
+#endif
+}
+
+#if BREWPI_INCREMENTAL_CONTROL
+#define IDLE_NO_TIMERS NUM_STATES	// staying idle because of the mode or the sensors, no timers are used
+
+/*
+ * Checks whether updateState would come to the same outcome as its last full run, and if so, does only what that run
+ * does every tick: stamp the time of the current state and count down the wait time.
+ * Remembers the inputs when they changed, for the full run that follows.
+ */
+bool TempControl::stateUnchanged(ticks_seconds_t secs){
+	StateInputs inputs;
+	inputs.fridgeFast = fridgeSensor->readFastFiltered();
+	inputs.beerFast = beerSensor->readFastFiltered();
+	inputs.fridgeSetting = cs.fridgeSetting;
+	inputs.beerSetting = cs.beerSetting;
+	inputs.idleRangeHigh = cc.idleRangeHigh;
+	inputs.idleRangeLow = cc.idleRangeLow;
+	inputs.coolEstimator = cs.coolEstimator;
+	inputs.heatEstimator = cs.heatEstimator;
+	inputs.maxCoolTimeForEstimate = cc.maxCoolTimeForEstimate;
+	inputs.maxHeatTimeForEstimate = cc.maxHeatTimeForEstimate;
+	inputs.mode = cs.mode;
+	inputs.state = state;
+	inputs.flags = (fridgeSensor->isConnected() ? STATE_INPUT_FRIDGE_CONNECTED : 0)
+		| (beerSensor->isConnected() ? STATE_INPUT_BEER_CONNECTED : 0)
+		| (cooler != &defaultActuator ? STATE_INPUT_HAS_COOLER : 0)
+		| (heater != &defaultActuator ? STATE_INPUT_HAS_HEATER : 0)
+		| (light != &defaultActuator ? STATE_INPUT_HAS_LIGHT : 0)
+		| (doPosPeakDetect ? STATE_INPUT_POS_PEAK_DETECT : 0)
+		| (doNegPeakDetect ? STATE_INPUT_NEG_PEAK_DETECT : 0);
+	inputs.lightAsHeater = cc.lightAsHeater;
+
+	ticks_seconds_t elapsed = secs - stateEvaluated;
+	if(elapsed < stateStableTime && memcmp(&inputs, &stateInputs, sizeof(inputs)) == 0){
+		if(stateIsCooling()){
+			lastCoolTime = secs;
+		}
+		else if(stateIsHeating()){
+			lastHeatTime = secs;
+		}
+		else{
+			lastIdleTime = secs;
+			if(stateWaitCounts){
+				waitTime = stateWaitTime ? stateWaitTime - elapsed : 0;
+			}
+		}
+		return true;
+	}
+	stateInputs = inputs;
+	stateEvaluated = secs;
+	return false;
 }
 
+/*
+ * The outcome of updateState only depends on time through the wait time, the time used for the peak estimate and the
+ * minimum on times, which all follow from the time since idle, cooling or heating. Those grow with the clock, until
+ * they wrap around at 2^16 seconds. This works out how many seconds the outcome of the run that just finished holds.
+ * The outcome depends on the state it started from, so it only holds once the state stays the same.
+ */
+void TempControl::updateStableTime(bool stayIdle, uint16_t sinceIdle, uint16_t sinceCooling, uint16_t sinceHeating){
+	uint16_t stable = 0;
+	stateWaitCounts = false;
+	switch(stayIdle ? IDLE_NO_TIMERS : stateInputs.state)
+	{
+		case IDLE_NO_TIMERS:
+			stable = 0xFFFF;
+			break;
+		case COOLING:
+		case HEATING:
+		{
+			// the estimated peak stops growing after the maximum time for the estimate, once past the minimum on time
+			bool cooling = (stateInputs.state == COOLING);
+			uint16_t maxTime = cooling ? cc.maxCoolTimeForEstimate : cc.maxHeatTimeForEstimate;
+			uint16_t minOnTime = cooling ? MIN_COOL_ON_TIME : MIN_HEAT_ON_TIME;
+			if(sinceIdle >= maxTime && sinceIdle > minOnTime){
+				stable = ~sinceIdle;
+			}
+		}
+		break;
+		case COOLING_MIN_TIME:
+		case HEATING_MIN_TIME:
+			break;	// ends with the minimum on time
+		default:
+			// idle: the wait time counts down to 0, where waiting turns into cooling or heating
+			stateWaitCounts = true;
+			stateWaitTime = waitTime;
+			stable = min((uint16_t)~sinceCooling, (uint16_t)~sinceHeating);
+			if(waitTime){
+				stable = min(stable, waitTime);
+			}
+	}
+	stateStableTime = stable;
+}
+#endif
+
 void TempControl::updateEstimatedPeak(uint16_t timeLimit, temperature estimator, uint16_t sinceIdle)
 {
 	uint16_t activeTime = min(timeLimit, sinceIdle); // heat or cool time in seconds
@@ -357,17 +553,38 @@ void TempControl::updateEstimatedPeak(uint16_t timeLimit, temperature estimator,
 	cv.estimatedPeak = fridgeSensor->readFastFiltered() + estimatedOvershoot;		
 }
 
+#if BREWPI_ENERGY_METER
+void TempControl::updateEnergyMeters(void) {
+	// the outputs have been as they are now since the last update
+	ticks_seconds_t now = ticks.seconds();
+	ticks_seconds_t elapsed = now - lastMeterTime;
+	lastMeterTime = now;
+	// with the light as heater, the light uses heater energy, also when it is on for the door
+	if(heater->isActive() || (cc.lightAsHeater && light->isActive()))
+		heaterOnTime += elapsed;
+	if(cooler->isActive())
+		coolerOnTime += elapsed;
+}
+#endif
+
 void TempControl::updateOutputs(void) {
+#if BREWPI_ENERGY_METER
+	updateEnergyMeters();	// also in test mode, the outputs use energy when switched manually
+#endif
 	if (cs.mode==MODE_TEST)
 		return;
 		
-	cameraLight.update();
+	if(isPrimary())
+		cameraLight.update();
 	bool heating = stateIsHeating();
 	bool cooling = stateIsCooling();
 	cooler->setActive(cooling);		
 	heater->setActive(!cc.lightAsHeater && heating);	
 	light->setActive(isDoorOpen() || (cc.lightAsHeater && heating) || cameraLightState.isActive());	
 	fan->setActive(heating || cooling);
+#if BREWPI_CONTROL_KPI
+	kpi.update(getBeerTemp(), modeIsBeer() ? cs.beerSetting : INVALID_TEMP, state, heating, cooling);
+#endif
 }
 
 
@@ -459,7 +676,7 @@ void TempControl::detectPeaks(void){
 			doNegPeakDetect=false;
 		}
 	}
-	if(detected){
+	if(detected && isPrimary()){
 		// send out log message for type of peak detected
 		logInfoTempTempFixedFixed(detected, peak, estimate, oldEstimator, newEstimator);
 	}
@@ -472,14 +689,20 @@ void TempControl::increaseEstimator(temperature * estimator, temperature error){
 	if(*estimator < 25){
 		*estimator = intToTempDiff(5)/100; // make estimator at least 0.05
 	}
-	eepromManager.storeTempSettings();
+	storeSettingsIfPrimary();
 }
 
 // Decrease estimator at least 16.7% (1/1.2), max 33.3% (1/1.5)
 void TempControl::decreaseEstimator(temperature * estimator, temperature error){
 	temperature factor = 426 - constrainTemp(abs(error)>>5, 0, 85); // 0.833 - 3.1% of error, limit between 0.667 and 0.833
 	*estimator = multiplyFactorTemperatureDiff(factor, *estimator);
-	eepromManager.storeTempSettings();
+	storeSettingsIfPrimary();
+}
+
+void TempControl::storeSettingsIfPrimary(){
+	if(isPrimary()){
+		eepromManager.storeTempSettings();
+	}
 }
 
 uint16_t TempControl::timeSinceCooling(void){
@@ -529,19 +752,57 @@ void TempControl::loadSettings(eptr_t offset){
 	setMode(cs.mode, true);		// force the mode update
 }
 
+#if BREWPI_BEER_PROFILE
+void TempControl::loadProfile(eptr_t offset){
+	profile.load(offset, ticks.millis());
+}
+#endif
+
 void TempControl::loadDefaultConstants(void){
-	memcpy_P((void*) &tempControl.cc, (void*) &tempControl.ccDefaults, sizeof(ControlConstants));
+	memcpy_P((void*) &cc, (void*) &ccDefaults, sizeof(ControlConstants));
 	initFilters();
 }
 
+/*
+ * The filter coefficients in the control constants are for a tick of a second. Each step up in coefficient doubles the
+ * number of samples a filter averages, so with 2^filterShift samples per second the slow filters get filterShift more
+ * and respond as they would at a second. The PID and peak detection take their input from those, so they behave the same.
+ * The fast filters, used for the on/off control of the fridge air, get half of that: they respond faster in time, while
+ * still averaging more samples than at a second. That is what a shorter tick is for.
+ * The slope filter is updated every 3 seconds at any tick, so it needs no change.
+ * A filter can't go beyond MAX_FILTER_COEFFICIENT, so a slow filter near it averages less time at a short tick.
+ */
+static uint8_t shiftFilterCoefficient(uint8_t b, uint8_t shift){
+	b += shift;
+	return b > MAX_FILTER_COEFFICIENT ? MAX_FILTER_COEFFICIENT : b;
+}
+
 void TempControl::initFilters()
 {
-	fridgeSensor->setFastFilterCoefficients(cc.fridgeFastFilter);
-	fridgeSensor->setSlowFilterCoefficients(cc.fridgeSlowFilter);
+	uint8_t fastShift = filterShift/2;
+	fridgeSensor->setFastFilterCoefficients(shiftFilterCoefficient(cc.fridgeFastFilter, fastShift));
+	fridgeSensor->setSlowFilterCoefficients(shiftFilterCoefficient(cc.fridgeSlowFilter, filterShift));
 	fridgeSensor->setSlopeFilterCoefficients(cc.fridgeSlopeFilter);
-	beerSensor->setFastFilterCoefficients(cc.beerFastFilter);
-	beerSensor->setSlowFilterCoefficients(cc.beerSlowFilter);
+	fridgeSensor->setSamplePeriod(tickMillis);
+	beerSensor->setFastFilterCoefficients(shiftFilterCoefficient(cc.beerFastFilter, fastShift));
+	beerSensor->setSlowFilterCoefficients(shiftFilterCoefficient(cc.beerSlowFilter, filterShift));
 	beerSensor->setSlopeFilterCoefficients(cc.beerSlopeFilter);		
+	beerSensor->setSamplePeriod(tickMillis);
+}
+
+void TempControl::setTickTime(uint16_t millis){
+	if(millis < MIN_TICK_MILLIS){
+		millis = MIN_TICK_MILLIS;
+	}
+	else if(millis > MAX_TICK_MILLIS){
+		millis = MAX_TICK_MILLIS;
+	}
+	tickMillis = millis;
+	integralTicks = 60000UL/millis;	// the integrator is updated every minute
+	filterShift = TICK_FILTER_SHIFT(millis);
+	if(beerSensor != NULL && fridgeSensor != NULL){
+		initFilters();
+	}
 }
 
 void TempControl::setMode(char newMode, bool force){
@@ -557,7 +818,7 @@ void TempControl::setMode(char newMode, bool force){
 			cs.beerSetting = INVALID_TEMP;
 			cs.fridgeSetting = INVALID_TEMP;
 		}
-		eepromManager.storeTempSettings();
+		storeSettingsIfPrimary();
 	}
 }
 
@@ -600,7 +861,7 @@ void TempControl::setBeerTemp(temperature newTemp){
 		// Do not store settings every time in profile mode, because EEPROM has limited number of write cycles.
 		// A temperature ramp would cause a lot of writes
 		// If Raspberry Pi is connected, it will update the settings anyway. This is just a safety feature.
-		eepromManager.storeTempSettings();
+		storeSettingsIfPrimary();
 	}		
 }
 
@@ -609,7 +870,7 @@ void TempControl::setFridgeTemp(temperature newTemp){
 	reset(); // reset peak detection and PID
 	updatePID();
 	updateState();	
-	eepromManager.storeTempSettings();
+	storeSettingsIfPrimary();
 }
 
 bool TempControl::stateIsCooling(void){
@@ -659,4 +920,8 @@ const ControlConstants TempControl::ccDefaults PROGMEM =
 	/* rotaryHalfSteps */ 0,
 
 	/* pidMax */ intToTempDiff(10),	// +/- 10 deg Celsius
+
+	// power of the outputs, for energy metering. Unknown until configured.
+	/* heaterPower */ 0,
+	/* coolerPower */ 0,
 };
@@ -27,6 +27,11 @@
 #include "Sensor.h"
 #include "EepromManager.h"
 #include "ActuatorAutoOff.h"
+#include "Ticks.h"
+#include "BeerProfile.h"
+#if BREWPI_CONTROL_KPI
+#include "ControlKpi.h"
+#endif
 
 
 // Set minimum off time to prevent short cycling the compressor in seconds
@@ -94,8 +99,53 @@ struct ControlConstants{
 	uint8_t lightAsHeater;		// use the light to heat rather than the configured heater device
 	uint8_t rotaryHalfSteps; // define whether to use full or half steps for the rotary encoder
 	temperature pidMax;
+	uint16_t heaterPower;	// W, to estimate the energy used by the heater. 0 when unknown
+	uint16_t coolerPower;	// W, to estimate the energy used by the cooler. 0 when unknown
 };
 
+#if BREWPI_INCREMENTAL_CONTROL
+// Everything updatePID uses, with the integral and fridge setting as it left them. Compared with memcmp, so no padding.
+struct PidInputs{
+	long_temperature diffIntegral;
+	temperature beerSetting;
+	temperature fridgeSetting;
+	temperature beerSlowFiltered;
+	temperature beerSlope;
+	temperature Kp;
+	temperature Ki;
+	temperature Kd;
+	temperature pidMax;
+	temperature tempSettingMin;
+	temperature tempSettingMax;
+};
+
+// Everything updateState uses, except the time. Compared with memcmp, so no padding.
+struct StateInputs{
+	temperature fridgeFast;
+	temperature beerFast;
+	temperature fridgeSetting;
+	temperature beerSetting;
+	temperature idleRangeHigh;
+	temperature idleRangeLow;
+	temperature coolEstimator;
+	temperature heatEstimator;
+	uint16_t maxCoolTimeForEstimate;
+	uint16_t maxHeatTimeForEstimate;
+	char mode;
+	uint8_t state;
+	uint8_t flags;	// the STATE_INPUT_ flags below
+	uint8_t lightAsHeater;
+};
+
+#define STATE_INPUT_FRIDGE_CONNECTED 0x01
+#define STATE_INPUT_BEER_CONNECTED 0x02
+#define STATE_INPUT_HAS_COOLER 0x04
+#define STATE_INPUT_HAS_HEATER 0x08
+#define STATE_INPUT_HAS_LIGHT 0x10
+#define STATE_INPUT_POS_PEAK_DETECT 0x20
+#define STATE_INPUT_NEG_PEAK_DETECT 0x40
+#endif
+
 #define EEPROM_TC_SETTINGS_BASE_ADDRESS 0
 #define EEPROM_CONTROL_SETTINGS_ADDRESS (EEPROM_TC_SETTINGS_BASE_ADDRESS+sizeof(uint8_t))
 #define EEPROM_CONTROL_CONSTANTS_ADDRESS (EEPROM_CONTROL_SETTINGS_ADDRESS+sizeof(ControlSettings))
@@ -123,6 +173,12 @@ enum states{
 
 #define TC_STATE_MASK 0x7;	// 3 bits
 
+// How many times the tick fits in a second, as a power of 2 rounded down. The filters need 2^shift times the samples.
+#define TICK_FILTER_SHIFT(millis) ((millis)*8<=1000 ? 3 : (millis)*4<=1000 ? 2 : (millis)*2<=1000 ? 1 : 0)
+
+// The largest filter coefficient b. Beyond it, a FixedFilter shifts its state out of its 32 bits.
+#define MAX_FILTER_COEFFICIENT 6
+
 #if TEMP_CONTROL_STATIC
 #define TEMP_CONTROL_METHOD static
 #define TEMP_CONTROL_FIELD static
@@ -139,12 +195,23 @@ enum states{
  * the current instance. But this means each lookup of a field must be done indirectly, which adds to the code size.
  * Instead, we swap in/out the sensors and control data so that the bulk of the code can work against compile-time resolvable
  * memory references. While the design goes against the grain of typical OO practices, the reduction in code size make it worth it.
+ * The swapping is done by the ChamberManager.
+ */
+
+/*
+ * When TEMP_CONTROL_STATIC is 0, each TempControl is a separate instance with its own sensors, actuators, settings and
+ * clock. This is used by the desktop simulator to run many chambers side by side. The global tempControl remains the
+ * only instance that talks to the eeprom and the serial link.
  */
 
 class TempControl{
 	public:
 	
+#if TEMP_CONTROL_STATIC
 	TempControl(){};
+#else
+	TempControl(TicksImpl& clock = ::ticks);
+#endif
 	~TempControl(){};
 	
 	TEMP_CONTROL_METHOD void init(void);
@@ -155,9 +222,26 @@ class TempControl{
 	TEMP_CONTROL_METHOD void updateState(void);
 	TEMP_CONTROL_METHOD void updateOutputs(void);
 	TEMP_CONTROL_METHOD void detectPeaks(void);
+
+	/**
+	 * Makes the next updatePID and updateState run in full, also when none of their inputs changed.
+	 * Needed after writing to the control variables directly.
+	 */
+#if BREWPI_INCREMENTAL_CONTROL
+	TEMP_CONTROL_METHOD void forceUpdate(void){
+		pidInputs.beerSetting = INVALID_TEMP;	// never matches, updatePID returns early on an invalid setting
+		stateStableTime = 0;
+	}
+#else
+	TEMP_CONTROL_METHOD void forceUpdate(void){}
+#endif
 	
 	TEMP_CONTROL_METHOD void loadSettings(eptr_t offset);
 	TEMP_CONTROL_METHOD void storeSettings(eptr_t offset);
+#if BREWPI_BEER_PROFILE
+	// Loads the beer profile stored at offset. It sets the beer setting in beer profile mode, when it has points.
+	TEMP_CONTROL_METHOD void loadProfile(eptr_t offset);
+#endif
 	TEMP_CONTROL_METHOD void loadDefaultSettings(void);
 	
 	TEMP_CONTROL_METHOD void loadConstants(eptr_t offset);
@@ -216,6 +300,16 @@ class TempControl{
 	}
 		
 	TEMP_CONTROL_METHOD void initFilters();
+
+	/**
+	 * Sets the time between two runs of the control loop, BREWPI_TICK_MILLIS by default. Everything counted in ticks
+	 * is derived from it: the integrator is updated every minute and the sensor filters are set up for the sample rate.
+	 * Values outside MIN_TICK_MILLIS to MAX_TICK_MILLIS are clamped to that range.
+	 */
+	TEMP_CONTROL_METHOD void setTickTime(uint16_t millis);
+	TEMP_CONTROL_METHOD uint16_t getTickTime(void){
+		return tickMillis;
+	}
 	
 	TEMP_CONTROL_METHOD bool isDoorOpen() { return doorOpen; }
 	
@@ -223,11 +317,41 @@ class TempControl{
 		return isDoorOpen() ? DOOR_OPEN : getState();
 	}
 
+#if BREWPI_ENERGY_METER
+	/**
+	 * Seconds the heater and the cooler have been on since start up.
+	 * Times the power in the control constants, this is the energy they used. The conversion is left to the
+	 * script, so the totals don't wrap after a few kWh and the firmware needs no wide arithmetic.
+	 */
+	TEMP_CONTROL_METHOD uint32_t getHeaterOnTime(void) { return heaterOnTime; }
+	TEMP_CONTROL_METHOD uint32_t getCoolerOnTime(void) { return coolerOnTime; }
+#endif
+
+	/**
+	 * Determines if this is the global instance, which owns the eeprom and the serial link.
+	 */
+#if TEMP_CONTROL_STATIC
+	TEMP_CONTROL_METHOD bool isPrimary() { return true; }
+#else
+	bool isPrimary();
+#endif
+
 	private:
+	TEMP_CONTROL_METHOD void storeSettingsIfPrimary();
+
 	TEMP_CONTROL_METHOD void increaseEstimator(temperature * estimator, temperature error);
 	TEMP_CONTROL_METHOD void decreaseEstimator(temperature * estimator, temperature error);
 	
 	TEMP_CONTROL_METHOD void updateEstimatedPeak(uint16_t estimate, temperature estimator, uint16_t sinceIdle);
+
+#if BREWPI_INCREMENTAL_CONTROL
+	TEMP_CONTROL_METHOD bool stateUnchanged(ticks_seconds_t secs);
+	TEMP_CONTROL_METHOD void updateStableTime(bool stayIdle, uint16_t sinceIdle, uint16_t sinceCooling, uint16_t sinceHeating);
+#endif
+
+#if BREWPI_ENERGY_METER
+	TEMP_CONTROL_METHOD void updateEnergyMeters(void);
+#endif
 	public:
 	TEMP_CONTROL_FIELD TempSensor* beerSensor;
 	TEMP_CONTROL_FIELD TempSensor* fridgeSensor;
@@ -236,13 +360,24 @@ class TempControl{
 	TEMP_CONTROL_FIELD Actuator* cooler; 
 	TEMP_CONTROL_FIELD Actuator* light;
 	TEMP_CONTROL_FIELD Actuator* fan;
-	TEMP_CONTROL_FIELD AutoOffActuator cameraLight;
 	TEMP_CONTROL_FIELD Sensor<bool>* door;
+	// the camera light is hardware shared by all instances, so it is always static
+	static AutoOffActuator cameraLight;
 	
 	// Control parameters
 	TEMP_CONTROL_FIELD ControlConstants cc;
 	TEMP_CONTROL_FIELD ControlSettings cs;
 	TEMP_CONTROL_FIELD ControlVariables cv;
+
+#if BREWPI_CONTROL_KPI
+	// control quality indicators, updated with the outputs
+	TEMP_CONTROL_FIELD ControlKpi kpi;
+#endif
+
+#if BREWPI_BEER_PROFILE
+	// the profile followed in beer profile mode, advanced by updatePID
+	TEMP_CONTROL_FIELD BeerProfile profile;
+#endif
 	
 	// Defaults for control constants. Defined in cpp file, copied with memcpy_p
 	static const ControlConstants ccDefaults;
@@ -256,15 +391,43 @@ class TempControl{
 	TEMP_CONTROL_FIELD uint16_t lastHeatTime;
 	TEMP_CONTROL_FIELD uint16_t lastCoolTime;
 	TEMP_CONTROL_FIELD uint16_t waitTime;
-	
+	TEMP_CONTROL_FIELD uint16_t integralUpdateCounter;
+
+	// The control tick and what is derived from it, see setTickTime
+	TEMP_CONTROL_FIELD uint16_t tickMillis;
+	TEMP_CONTROL_FIELD uint16_t integralTicks;	// ticks between two integrator updates
+	TEMP_CONTROL_FIELD uint8_t filterShift;		// added to the filter coefficients, see initFilters
 	
 	// State variables
 	TEMP_CONTROL_FIELD uint8_t state;
 	TEMP_CONTROL_FIELD bool doPosPeakDetect;
 	TEMP_CONTROL_FIELD bool doNegPeakDetect;
 	TEMP_CONTROL_FIELD bool doorOpen;
+
+#if BREWPI_ENERGY_METER
+	// Total time in seconds the heater and cooler have been on
+	TEMP_CONTROL_FIELD uint32_t heaterOnTime;
+	TEMP_CONTROL_FIELD uint32_t coolerOnTime;
+	TEMP_CONTROL_FIELD ticks_seconds_t lastMeterTime;
+#endif
+
+#if BREWPI_INCREMENTAL_CONTROL
+	// Inputs of the last full run of updatePID and updateState
+	TEMP_CONTROL_FIELD PidInputs pidInputs;
+	TEMP_CONTROL_FIELD StateInputs stateInputs;
+	TEMP_CONTROL_FIELD ticks_seconds_t stateEvaluated;	// when updateState last ran in full
+	TEMP_CONTROL_FIELD uint16_t stateStableTime;	// seconds after stateEvaluated that the outcome holds with the same inputs
+	TEMP_CONTROL_FIELD uint16_t stateWaitTime;	// the wait time set by that run, which counts down while it holds
+	TEMP_CONTROL_FIELD bool stateWaitCounts;	// false when the wait time was left alone
+#endif
+	
+#if !TEMP_CONTROL_STATIC
+	// the clock this instance runs on. Shadows the global ticks in all member functions.
+	TicksImpl& ticks;
+#endif
 	
 	friend class TempControlState;
+	friend class SimulatedChamber;
 };
 	
 extern TempControl tempControl;
@@ -25,7 +25,8 @@
 void TempSensor::init()
 {				
 	logDebug("tempsensor::init - begin %d", failedReadCount);
-	if (_sensor && _sensor->init() && (failedReadCount<0 || failedReadCount>60)) {		
+	// reset the filters after a minute without readings
+	if (_sensor && _sensor->init() && (failedReadCount<0 || failedReadCount>20*samplesPerSlope)) {		
 		temperature temp = _sensor->read();
 		if (temp!=TEMP_SENSOR_DISCONNECTED) {
 			logDebug("initializing filters with value %d", temp);
@@ -42,19 +43,20 @@ void TempSensor::update()
 {	
 	temperature temp;
 	if (!_sensor || (temp=_sensor->read())==TEMP_SENSOR_DISCONNECTED) {		
-		failedReadCount++;		
-		failedReadCount = min(failedReadCount,int8_t(127));	// limit
+		if(failedReadCount < 0x7FFF){	// limit
+			failedReadCount++;
+		}
 		return;
 	}
 		
 	fastFilter.add(temp);
 	slowFilter.add(temp);
 		
-	// update slope filter every 3 samples.
+	// update slope filter every samplesPerSlope samples, 3 seconds.
 	// averaged differences will give the slope. Use the slow filter as input
 	updateCounter--;
 	// initialize first read for slope filter after (255-4) seconds. This prevents an influence for the startup inaccuracy.
-	if(updateCounter == 4){
+	if(updateCounter == samplesPerSlope+1){
 		// only happens once after startup.
 		prevOutputForSlope = slowFilter.readOutputDoublePrecision();
 	}
@@ -62,15 +64,16 @@ void TempSensor::update()
 		temperature_precise slowFilterOutput = slowFilter.readOutputDoublePrecision();
 		temperature_precise diff =  slowFilterOutput - prevOutputForSlope;
 		temperature diff_upper = diff >> 16;
-		if(diff_upper > 27){ // limit to prevent overflow INT_MAX/1200 = 27.14
-			diff = (27l << 16);
+		temperature limit = 0x7FFF/slopeScale; // limit to prevent overflow, INT_MAX/1200 = 27.14
+		if(diff_upper > limit){
+			diff = (long(limit) << 16);
 		}
-		else if(diff_upper < -27){
-			diff = (-27l << 16);
+		else if(diff_upper < -limit){
+			diff = (-long(limit) << 16);
 		}
-		slopeFilter.addDoublePrecision(1200*diff); // Multiply by 1200 (1h/4s), shift to single precision
+		slopeFilter.addDoublePrecision(slopeScale*diff); // Multiply by 1200 at a 1s tick (1h/3s), shift to single precision
 		prevOutputForSlope = slowFilterOutput;
-		updateCounter = 3;
+		updateCounter = samplesPerSlope;
 	}
 }
 
@@ -104,6 +107,20 @@ void TempSensor::setSlopeFilterCoefficients(uint8_t b){
 	slopeFilter.setCoefficients(b);
 }
 
+void TempSensor::setSamplePeriod(uint16_t millis){
+	// millis is a control tick, at least MIN_TICK_MILLIS, so there are at most 30 samples
+	uint8_t samples = (3000+millis/2)/millis;
+	if(samples == 0){
+		samples = 1;
+	}
+	if(samples != samplesPerSlope){
+		// the slope difference no longer matches, start over after the startup delay
+		samplesPerSlope = samples;
+		updateCounter = 85*samples;
+	}
+	slopeScale = 3600000UL/(uint32_t(samples)*millis);
+}
+
 BasicTempSensor& TempSensor::sensor() {
 	return *_sensor;
 }
@@ -47,7 +47,8 @@ enum TempSensorType {
 class TempSensor {
 	public:	
 	TempSensor(TempSensorType sensorType, BasicTempSensor* sensor =NULL)  {
-		updateCounter = 255; // first update for slope filter after (255-4s)
+		samplesPerSlope = 0;
+		setSamplePeriod(BREWPI_TICK_MILLIS); // first update for slope filter after 85 slope periods (255-4s)
 		setSensor(sensor);
 	 }	 	 
 	 
@@ -68,6 +69,10 @@ class TempSensor {
 	
 	temperature readFastFiltered(void);
 
+	temperature readRaw(void){
+		return fastFilter.readInput(); // most recent unfiltered value
+	}
+
 	temperature readSlowFiltered(void){
 		return slowFilter.readOutput(); //return most recent unfiltered value
 	}
@@ -83,23 +88,41 @@ class TempSensor {
 	void setSlowFilterCoefficients(uint8_t b);
 
 	void setSlopeFilterCoefficients(uint8_t b);
+
+	/**
+	 * Sets the time between two calls to update(). The slope is taken over the whole number of samples closest to 3
+	 * seconds and scaled to degrees per hour, so the slope filter sees the same input at any tick.
+	 */
+	void setSamplePeriod(uint16_t millis);
 	
 	BasicTempSensor& sensor();
+
+	/**
+	 * Copies the filter state of another sensor, but keeps reading from its own basic sensor.
+	 */
+	void copyState(const TempSensor& other) {
+		BasicTempSensor* own = _sensor;
+		*this = other;
+		_sensor = own;
+	}
 	 
 	private:	
 	BasicTempSensor* _sensor;
 	TempSensorFilter fastFilter;
 	TempSensorFilter slowFilter;
 	TempSensorFilter slopeFilter;
-	unsigned char updateCounter;
+	uint16_t updateCounter;
+	uint8_t samplesPerSlope;	// samples between two slope filter updates, 3 at the default tick of 1 second
+	uint16_t slopeScale;		// multiplies the difference over samplesPerSlope to a slope per hour
 	temperature_precise prevOutputForSlope;
 	
 	// An indication of how stale the data is in the filters. Each time a read fails, this value is incremented.
 	// It's used to reset the filters after a large enough disconnect delay, and on the first init.
-	int8_t failedReadCount;		// -1 for uninitialized, >=0 afterwards. 
+	int16_t failedReadCount;		// -1 for uninitialized, >=0 afterwards. 
 			
 	friend class ChamberManager;
 	friend class Chamber;
 	friend class DeviceManager;
+	friend class SimulatedChamber;
 };
 
@@ -118,7 +118,7 @@ long_temperature stringToFixedPoint(const char * numberString){
 	fractPtr = strchrnul(numberString, '.'); // returns pointer to the point.
 	
 	intPart = atol(numberString);
-	if(fractPtr != 0){
+	if(*fractPtr == '.'){
 		// decimal point was found
 		fractPtr++; // add 1 to pointer to skip point
 		int8_t numDecimals = (int8_t) strlen(fractPtr);
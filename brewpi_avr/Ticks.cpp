@@ -34,7 +34,7 @@ inline ticks_seconds_t timeSince(ticks_seconds_t currentTime, ticks_seconds_t pr
 
 // return time that has passed since timeStamp, take overflow into account
 ticks_seconds_t ExternalTicks::timeSince(ticks_seconds_t previousTime){
-	ticks_seconds_t currentTime = ticks.seconds();
+	ticks_seconds_t currentTime = seconds();	// this clock, not the global one: simulations can run several
 	return ::timeSince(currentTime, previousTime);
 }
 
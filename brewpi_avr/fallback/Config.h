@@ -78,6 +78,86 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////////////////////////////////////////////////
+//
+// Record every control tick to a binary trace file. Only available in host builds, which have a file system.
+//
+// #ifndef BREWPI_TRACE
+// #define BREWPI_TRACE 0
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Keep control quality indicators (beer error, overshoot, settling, cycles, duty and state times) and report them with the 'k' command. Costs flash and RAM, so off by default.
+//
+// #ifndef BREWPI_CONTROL_KPI
+// #define BREWPI_CONTROL_KPI 0
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Time each phase of the main loop and keep a histogram of the durations, reported with the 'm' command. Costs about 400 bytes of RAM.
+//
+// #ifndef BREWPI_LOOP_TIMING
+// #define BREWPI_LOOP_TIMING 0
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Meter the energy used by the heater and cooler, from their on-time and the power set in the control constants.
+//
+// #ifndef BREWPI_ENERGY_METER
+// #define BREWPI_ENERGY_METER 0
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Number of chambers controlled, each with its own sensors, actuators and settings. More than one needs a Mega.
+//
+// #ifndef BREWPI_CHAMBERS
+// #define BREWPI_CHAMBERS 1
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Skip updatePID and updateState when their inputs did not change. Costs about 60 bytes of RAM per chamber, on by default with several chambers.
+//
+// #ifndef BREWPI_INCREMENTAL_CONTROL
+// #define BREWPI_INCREMENTAL_CONTROL (BREWPI_CHAMBERS>1)
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Time between two runs of the control loop in milliseconds, at most 1000 and best a divisor of 1000. Shorter ticks follow the fridge air more closely.
+//
+// #ifndef BREWPI_TICK_MILLIS
+// #define BREWPI_TICK_MILLIS 1000
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Follow a beer temperature profile stored in the eeprom in beer profile mode, so it keeps running without the script.
+//
+// #ifndef BREWPI_BEER_PROFILE
+// #define BREWPI_BEER_PROFILE (BREWPI_BOARD==BREWPI_BOARD_MEGA)
+// #endif
+//
+//////////////////////////////////////////////////////////////////////////
+
 //////////////////////////////////////////////////////////////////////////
 //
 // Enable DS2413 Actuators. 
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "BeerProfile.h"
+#include "EepromAccess.h"
+#include "EepromManager.h"
+#include "test/ChamberFixtures.h"
+
+static const ticks_millis_t MINUTE = 60000;
+
+TEST(BeerProfileTest, interpolatesBetweenPoints){
+    // hold 20 for an hour, ramp to 22 in two hours, then drop to 18 within an hour
+    const uint16_t minutes[] = { 0, 60, 180, 240 };
+    const temperature temps[] = { intToTemp(20), intToTemp(20), intToTemp(22), intToTemp(18) };
+    BeerProfile profile;
+    profile.load(storeProfile(0, minutes, temps, 4), 0);
+    ASSERT_TRUE(profile.isActive());
+
+    EXPECT_EQ(intToTemp(20), profile.update(30*MINUTE));
+    EXPECT_EQ(0, profile.getSegment());
+    EXPECT_EQ(intToTemp(21), profile.update(120*MINUTE));
+    EXPECT_EQ(1, profile.getSegment());
+    EXPECT_EQ(120, profile.getMinutes());
+    EXPECT_EQ(intToTemp(20), profile.update(210*MINUTE));
+    EXPECT_EQ(2, profile.getSegment());
+    EXPECT_FALSE(profile.isFinished());
+
+    // past the end the last point holds
+    EXPECT_EQ(intToTemp(18), profile.update(1000*MINUTE));
+    EXPECT_EQ(3, profile.getSegment());
+    EXPECT_TRUE(profile.isFinished());
+}
+
+TEST(BeerProfileTest, interpolatesLongSegmentsOverTheFullRange){
+    // the difference times the minutes into the segment is beyond 2^31
+    const uint16_t minutes[] = { 0, 60000 };
+    const temperature temps[] = { intToTemp(0), intToTemp(110) };
+    BeerProfile profile;
+    profile.load(storeProfile(0, minutes, temps, 2), 0);
+    EXPECT_EQ(intToTemp(88), profile.update(48000*MINUTE));
+
+    const temperature falling[] = { intToTemp(110), intToTemp(0) };
+    profile.load(storeProfile(0, minutes, falling, 2), 0);
+    EXPECT_EQ(intToTemp(22), profile.update(48000*MINUTE));
+}
+
+TEST(BeerProfileTest, progressIsStoredAndResumed){
+    const uint16_t minutes[] = { 0, 600 };
+    const temperature temps[] = { intToTemp(20), intToTemp(25) };
+    eptr_t address = storeProfile(0, minutes, temps, 2);
+    BeerProfile profile;
+    profile.load(address, 0);
+    for (ticks_millis_t now = 0; now <= 150*MINUTE; now += 1000) {
+        profile.update(now);
+    }
+    EXPECT_EQ(150, profile.getMinutes());
+
+    // after a reset the profile continues from the last hour stored
+    BeerProfile restarted;
+    restarted.load(address, 0);
+    EXPECT_EQ(120, restarted.getMinutes());
+    EXPECT_EQ(intToTemp(21), restarted.update(0));
+
+    // the script can move it to where it should be
+    restarted.setMinutes(300);
+    restarted.load(address, 0);
+    EXPECT_EQ(intToTemp(22) + intToTempDiff(1)/2, restarted.update(0));
+}
+
+TEST(BeerProfileTest, erasedEepromHasNoProfile){
+    eptr_t address = eepromManager.profileOffset(0);
+    for (uint8_t i = 0; i < sizeof(ProfileBlock); i++) {
+        eepromAccess.writeByte(address+i, 0xFF);
+    }
+    BeerProfile profile;
+    profile.load(address, 0);
+    EXPECT_FALSE(profile.isActive());
+    EXPECT_EQ(0, profile.getCount());
+}
@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+#include "ChamberManager.h"
+#include "DeviceManager.h"
+#include "EepromManager.h"
+#include "EepromFormat.h"
+#include "TempControl.h"
+
+extern ValueActuator defaultActuator;
+
+TEST(ChamberManagerTest, eachChamberKeepsItsOwnControlState){
+    ASSERT_GE(chamberManager.count(), 2);
+    chamberManager.init();
+    tempControl.setMode(MODE_BEER_CONSTANT);
+    tempControl.setBeerTemp(intToTemp(20));
+    TempSensor* firstBeerSensor = tempControl.beerSensor;
+
+    ASSERT_TRUE(chamberManager.select(1));
+    EXPECT_EQ(MODE_OFF, tempControl.getMode());
+    tempControl.setMode(MODE_FRIDGE_CONSTANT);
+    tempControl.setFridgeTemp(intToTemp(4));
+    EXPECT_NE(firstBeerSensor, tempControl.beerSensor) << "chambers do not share filters";
+
+    chamberManager.switchTo(0);
+    EXPECT_EQ(MODE_BEER_CONSTANT, tempControl.getMode());
+    EXPECT_EQ(intToTemp(20), tempControl.getBeerSetting());
+    EXPECT_EQ(firstBeerSensor, tempControl.beerSensor);
+
+    chamberManager.switchTo(1);
+    EXPECT_EQ(MODE_FRIDGE_CONSTANT, tempControl.getMode());
+    EXPECT_EQ(intToTemp(4), tempControl.getFridgeSetting());
+
+    EXPECT_FALSE(chamberManager.select(chamberManager.count()));
+    EXPECT_EQ(1, chamberManager.getSelected());
+    chamberManager.select(0);
+}
+
+TEST(ChamberManagerTest, devicesAreInstalledInTheirChamber){
+    chamberManager.init();
+    DeviceConfig cfg;
+    clear((uint8_t*)&cfg, sizeof(cfg));
+    cfg.chamber = 2;
+    cfg.deviceFunction = DEVICE_CHAMBER_HEAT;
+    cfg.deviceHardware = DEVICE_HARDWARE_PIN;
+    deviceManager.installDevice(cfg);
+    EXPECT_EQ(&defaultActuator, tempControl.heater) << "the first chamber is in tempControl";
+
+    chamberManager.switchTo(1);
+    EXPECT_NE(&defaultActuator, tempControl.heater);
+
+    // beer devices only go to the beer the chamber controls
+    Actuator* heater = tempControl.heater;
+    BasicTempSensor* beerProbe = &tempControl.beerSensor->sensor();
+    cfg.beer = 2;
+    cfg.deviceFunction = DEVICE_BEER_TEMP;
+    cfg.deviceHardware = DEVICE_HARDWARE_ONEWIRE_TEMP;
+    deviceManager.installDevice(cfg);
+    EXPECT_EQ(beerProbe, &tempControl.beerSensor->sensor());
+
+    chamberManager.switchTo(0);
+    cfg.beer = 0;
+    cfg.deviceFunction = DEVICE_CHAMBER_HEAT;
+    deviceManager.uninstallDevice(cfg);
+    chamberManager.switchTo(1);
+    EXPECT_EQ(&defaultActuator, tempControl.heater) << heater << " was removed from the waiting chamber";
+    chamberManager.switchTo(0);
+}
+
+TEST(ChamberManagerTest, settingsAreStoredPerChamberAndBeer){
+    eepromManager.initializeEeprom();
+    chamberManager.init();
+    chamberManager.loadActiveBeers();
+    chamberManager.select(1);
+    tempControl.setMode(MODE_BEER_CONSTANT);
+    tempControl.setBeerTemp(intToTemp(19));
+
+    ASSERT_TRUE(chamberManager.setActiveBeer(2));
+    EXPECT_EQ(2, chamberManager.activeBeer(1));
+    EXPECT_NE(MODE_BEER_CONSTANT, tempControl.getMode()) << "the third beer has its own settings";
+    EXPECT_FALSE(chamberManager.setActiveBeer(ChamberBlock::MAX_BEERS));
+
+    // back to the first beer, and everything read back from the eeprom
+    ASSERT_TRUE(chamberManager.setActiveBeer(0));
+    eepromManager.applySettings();
+    chamberManager.switchTo(1);
+    EXPECT_EQ(MODE_BEER_CONSTANT, tempControl.getMode());
+    EXPECT_EQ(intToTemp(19), tempControl.getBeerSetting());
+    chamberManager.switchTo(0);
+    EXPECT_EQ(MODE_OFF, tempControl.getMode());
+    chamberManager.select(0);
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "ControlKpi.h"
+#include "TempControl.h"
+#include "TemperatureFormats.h"
+
+TEST(ControlKpiTest, rmsErrorOfConstantError){
+    ControlKpi kpi;
+    temperature setting = intToTemp(20);
+    for (int i = 0; i < 100; i++) {
+        kpi.update(setting + intToTempDiff(1)/2, setting, IDLE, false, false);
+    }
+    EXPECT_EQ(100u, kpi.getTicks());
+    EXPECT_EQ(intToTempDiff(1)/2, kpi.getRmsError());
+
+    // half of the time 1 degree too cold: rms is sqrt((0.25+1)/2)
+    kpi.reset();
+    for (int i = 0; i < 50; i++) {
+        kpi.update(setting + intToTempDiff(1)/2, setting, IDLE, false, false);
+        kpi.update(setting - intToTempDiff(1), setting, IDLE, false, false);
+    }
+    EXPECT_NEAR(0.7906*TEMP_FIXED_POINT_SCALE, kpi.getRmsError(), 1);
+}
+
+TEST(ControlKpiTest, noErrorWithoutBeerSetting){
+    ControlKpi kpi;
+    kpi.update(intToTemp(20), INVALID_TEMP, IDLE, false, false);
+    kpi.update(INVALID_TEMP, intToTemp(20), IDLE, false, false);
+    EXPECT_EQ(2u, kpi.getTicks());
+    EXPECT_EQ(0, kpi.getRmsError());
+}
+
+TEST(ControlKpiTest, overshootAndSettlingAfterSettingChange){
+    ControlKpi kpi;
+    temperature setting = intToTemp(18);
+    // approach from above, undershoot to 17.5 at tick 30, settled within 0.25 from tick 60
+    for (int i = 0; i < 100; i++) {
+        temperature beer = i < 20 ? intToTemp(20) : i < 30 ? setting : i < 60 ? setting - intToTempDiff(1)/2 : setting;
+        kpi.update(beer, setting, COOLING, false, true);
+    }
+    EXPECT_EQ(intToTempDiff(1)/2, kpi.getOvershoot());
+    EXPECT_EQ(60u, kpi.getSettlingTime());
+
+    // a new setting starts over, approaching from below
+    setting = intToTemp(20);
+    kpi.update(intToTemp(18), setting, HEATING, true, false);
+    EXPECT_EQ(0, kpi.getOvershoot());
+    kpi.update(setting + intToTempDiff(1)/4, setting, HEATING, true, false);
+    EXPECT_EQ(intToTempDiff(1)/4, kpi.getOvershoot());
+    EXPECT_EQ(1u, kpi.getSettlingTime());
+}
+
+TEST(ControlKpiTest, cyclesDutyAndStateTimes){
+    ControlKpi kpi;
+    temperature setting = intToTemp(20);
+    // 3 cool cycles of 10 ticks, 1 heat cycle of 5 ticks, in 100 ticks
+    for (int i = 0; i < 100; i++) {
+        bool cooling = i < 60 && (i % 20) < 10;
+        bool heating = i >= 80 && i < 85;
+        uint8_t state = cooling ? COOLING : heating ? HEATING : IDLE;
+        kpi.update(setting, setting, state, heating, cooling);
+    }
+    EXPECT_EQ(3u, kpi.getCoolCycles());
+    EXPECT_EQ(1u, kpi.getHeatCycles());
+    EXPECT_EQ(300u, kpi.getCoolDuty());
+    EXPECT_EQ(50u, kpi.getHeatDuty());
+    EXPECT_EQ(30u, kpi.getStateTime(COOLING));
+    EXPECT_EQ(5u, kpi.getStateTime(HEATING));
+    EXPECT_EQ(65u, kpi.getStateTime(IDLE));
+}
+
+TEST(ControlKpiTest, repeatEqualsIdenticalUpdates){
+    ControlKpi updated, repeated;
+    temperature setting = intToTemp(20);
+    temperature beer = setting + intToTempDiff(1);
+    updated.update(setting, setting, IDLE, false, false);
+    repeated.update(setting, setting, IDLE, false, false);
+    for (int i = 0; i < 50; i++) {
+        updated.update(beer, setting, COOLING, false, true);
+    }
+    repeated.update(beer, setting, COOLING, false, true);
+    repeated.repeat(49);
+
+    EXPECT_EQ(updated.getTicks(), repeated.getTicks());
+    EXPECT_EQ(updated.getRmsError(), repeated.getRmsError());
+    EXPECT_EQ(updated.getSettlingTime(), repeated.getSettlingTime());
+    EXPECT_EQ(updated.getCoolCycles(), repeated.getCoolCycles());
+    EXPECT_EQ(updated.getCoolDuty(), repeated.getCoolDuty());
+    EXPECT_EQ(updated.getStateTime(COOLING), repeated.getStateTime(COOLING));
+}
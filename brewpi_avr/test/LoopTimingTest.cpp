@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+#include "LoopTiming.h"
+
+TEST(LoopTimingTest, bucketsArePowersOfTwo){
+    EXPECT_EQ(0, LoopTiming::bucketOf(0));
+    EXPECT_EQ(0, LoopTiming::bucketOf(1));
+    EXPECT_EQ(1, LoopTiming::bucketOf(2));
+    EXPECT_EQ(1, LoopTiming::bucketOf(3));
+    EXPECT_EQ(2, LoopTiming::bucketOf(4));
+    EXPECT_EQ(9, LoopTiming::bucketOf(1023));
+    EXPECT_EQ(10, LoopTiming::bucketOf(1024));
+    EXPECT_EQ(LOOP_TIMING_BUCKETS-1, LoopTiming::bucketOf(1ul<<20));
+    EXPECT_EQ(LOOP_TIMING_BUCKETS-1, LoopTiming::bucketOf(0xFFFFFFFFul));
+}
+
+TEST(LoopTimingTest, recordsMinMaxAndHistogram){
+    LoopTiming timing;
+    EXPECT_EQ(0u, timing.getMin(PHASE_PID));
+    timing.record(PHASE_PID, 100);
+    timing.record(PHASE_PID, 7);
+    timing.record(PHASE_PID, 120);
+    EXPECT_EQ(3u, timing.getCount(PHASE_PID));
+    EXPECT_EQ(7u, timing.getMin(PHASE_PID));
+    EXPECT_EQ(120u, timing.getMax(PHASE_PID));
+    EXPECT_EQ(1, timing.getBucket(PHASE_PID, 2));
+    EXPECT_EQ(2, timing.getBucket(PHASE_PID, 6));
+    EXPECT_EQ(0u, timing.getCount(PHASE_STATE));
+
+    timing.reset();
+    EXPECT_EQ(0u, timing.getCount(PHASE_PID));
+    EXPECT_EQ(0u, timing.getMax(PHASE_PID));
+    EXPECT_EQ(0, timing.getBucket(PHASE_PID, 6));
+}
+
+TEST(LoopTimingTest, bucketsSaturate){
+    LoopTiming timing;
+    for (uint32_t i = 0; i < 70000; i++) {
+        timing.record(PHASE_RECEIVE, 3);
+    }
+    EXPECT_EQ(70000u, timing.getCount(PHASE_RECEIVE));
+    EXPECT_EQ(0xFFFF, timing.getBucket(PHASE_RECEIVE, 1));
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "AmbientProfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+AmbientProfile::AmbientProfile()
+    : file(NULL), isTrace(false), index(0), traceStart(0), time0(0), temp0(0), time1(0), temp1(0), hasNext(false),
+    moved(false)
+{
+}
+
+bool AmbientProfile::open(const char* path)
+{
+    close();
+    isTrace = trace.open(path);
+    if (isTrace) {
+        if (!trace.size())
+            return false;
+        traceStart = trace[0].time;
+    }
+    else {
+        file = fopen(path, "r");
+        if (!file)
+            return false;
+    }
+    if (!rewind()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AmbientProfile::close()
+{
+    if (file)
+        fclose(file);
+    file = NULL;
+    trace.close();
+    isTrace = false;
+    hasNext = false;
+}
+
+bool AmbientProfile::rewind()
+{
+    index = 0;
+    if (file)
+        ::rewind(file);
+    moved = false;
+    if (!readSample(time0, temp0))
+        return false;
+    hasNext = readSample(time1, temp1);
+    return true;
+}
+
+bool AmbientProfile::traceSample(size_t i, double& time, double& temp)
+{
+    const TraceRecord& record = trace[i];
+    if (record.roomRaw == INVALID_TEMP)
+        return false;
+    time = (record.time - traceStart)/1000.0;
+    temp = double(record.roomRaw - C_OFFSET)/TEMP_FIXED_POINT_SCALE;
+    return true;
+}
+
+bool AmbientProfile::readSample(double& time, double& temp)
+{
+    if (isTrace) {
+        // records without a room sensor value are skipped
+        while (index < trace.size()) {
+            if (traceSample(index++, time, temp))
+                return true;
+        }
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char* end;
+        time = strtod(line, &end);
+        if (end == line)
+            continue;
+        char* value = end + strspn(end, " \t,;");
+        temp = strtod(value, &end);
+        if (end != value)
+            return true;
+    }
+    return false;
+}
+
+double AmbientProfile::roomTemp(unsigned long seconds)
+{
+    if (!file && !isTrace)
+        return 0;
+    double t = seconds;
+    if (t < time0 && moved) {
+        // earlier than the current samples, for example after restoring a snapshot
+        rewind();
+    }
+    while (hasNext && t >= time1) {
+        time0 = time1;
+        temp0 = temp1;
+        hasNext = readSample(time1, temp1);
+        moved = true;
+    }
+    if (!hasNext || t <= time0)
+        return temp0;
+    return temp0 + (t - time0)*(temp1 - temp0)/(time1 - time0);
+}
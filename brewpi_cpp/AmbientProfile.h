@@ -0,0 +1,76 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Simulator.h"
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+
+/**
+ * A recorded room temperature profile for the Simulator, interpolated linearly between the samples. Before the first
+ * sample the profile has the first value, after the last sample the last value.
+ *
+ * Two formats are read:
+ * - a binary trace, see TraceRecorder. The room sensor values are used, with the time since the first record. The
+ *   file is mapped, not read into memory.
+ * - a text file with a time in seconds and a temperature on each line, separated by a comma, semicolon or spaces.
+ *   Lines that do not start with a number, like headers and comments, are skipped. The file is streamed, so only
+ *   the two samples around the current time are kept in memory. Going back in time reads the file from the start.
+ *
+ * A profile holds a reading position, so give each chamber running in parallel its own.
+ */
+class AmbientProfile : public RoomTempSource
+{
+public:
+    AmbientProfile();
+    ~AmbientProfile() { close(); }
+
+    /**
+     * Opens a profile. Files starting with the trace header are read as trace, any other file as text.
+     * @return false when the file cannot be read or holds no samples.
+     */
+    bool open(const char* path);
+    void close();
+
+    double roomTemp(unsigned long seconds);
+
+private:
+    AmbientProfile(const AmbientProfile&);
+    AmbientProfile& operator=(const AmbientProfile&);
+
+    bool rewind();
+    bool readSample(double& time, double& temp);
+    bool traceSample(size_t index, double& time, double& temp);
+
+    FILE* file;
+    TraceReader trace;
+    bool isTrace;
+    size_t index;           // trace record of the next sample
+    uint32_t traceStart;    // time of the first trace record, ms
+
+    // the samples around the current time
+    double time0, temp0;
+    double time1, temp1;
+    bool hasNext;           // false after the last sample
+    bool moved;             // time0 is no longer the first sample
+};
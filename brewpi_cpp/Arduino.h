@@ -69,6 +69,7 @@ inline uint32_t millis() {
 #include "timems.h"
 
 inline uint32_t millis() { return (uint32_t)millisSinceStartup(); } 
+inline uint32_t micros() { return (uint32_t)microsSinceStartup(); }
 
 #define PROGMEM         // makes no sense in a unified memory architecture
 #define PSTR(x) x
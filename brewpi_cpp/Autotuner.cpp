@@ -0,0 +1,518 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Autotuner.h"
+#include "BatchSimulation.h"
+#include "SimulatedChamber.h"
+#include "SimulationPool.h"
+#include "JsonKeys.h"
+#include "TemperatureFormats.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum TunableKind { TUNE_FIXED_POINT, TUNE_TEMP_DIFF, TUNE_FILTER };
+
+struct TunableConstant
+{
+    const char* key;
+    TunableKind kind;
+    size_t offset;
+};
+
+#define TUNABLE(key, field, kind) { JSONKEY_ ## key, kind, offsetof(ControlConstants, field) }
+
+static const TunableConstant tunableConstants[] = {
+    TUNABLE(Kp, Kp, TUNE_FIXED_POINT),
+    TUNABLE(Ki, Ki, TUNE_FIXED_POINT),
+    TUNABLE(Kd, Kd, TUNE_FIXED_POINT),
+    TUNABLE(iMaxError, iMaxError, TUNE_TEMP_DIFF),
+    TUNABLE(idleRangeHigh, idleRangeHigh, TUNE_TEMP_DIFF),
+    TUNABLE(idleRangeLow, idleRangeLow, TUNE_TEMP_DIFF),
+    TUNABLE(pidMax, pidMax, TUNE_TEMP_DIFF),
+    TUNABLE(fridgeFastFilter, fridgeFastFilter, TUNE_FILTER),
+    TUNABLE(fridgeSlowFilter, fridgeSlowFilter, TUNE_FILTER),
+    TUNABLE(fridgeSlopeFilter, fridgeSlopeFilter, TUNE_FILTER),
+    TUNABLE(beerFastFilter, beerFastFilter, TUNE_FILTER),
+    TUNABLE(beerSlowFilter, beerSlowFilter, TUNE_FILTER),
+    TUNABLE(beerSlopeFilter, beerSlopeFilter, TUNE_FILTER)
+};
+
+// filter b values beyond this shift the filter state out of its 32 bits
+static const int maxFilterSetting = 6;
+
+static const TunableConstant* findTunable(const char* key)
+{
+    for (const TunableConstant& constant : tunableConstants) {
+        if (!strcmp(constant.key, key))
+            return &constant;
+    }
+    return NULL;
+}
+
+static void setConstant(ControlConstants& cc, const TunableConstant& constant, double value)
+{
+    uint8_t* field = (uint8_t*)&cc + constant.offset;
+    if (constant.kind == TUNE_FILTER)
+        *field = uint8_t(std::min(std::max(int(lround(value)), 0), maxFilterSetting));
+    else
+        *(temperature*)field = temperature(lround(value*TEMP_FIXED_POINT_SCALE));
+}
+
+TuningScenario::TuningScenario()
+    : days(7), mode(MODE_BEER_CONSTANT), setting(18.0), startTemp(22.0), settleBand(0.25), events(false)
+{
+}
+
+TuningWeights::TuningWeights()
+    : overshoot(10), settlingTime(1), coolCycles(1), energy(0)
+{
+}
+
+Autotuner::Autotuner(const TuningScenario& scenario, const TuningWeights& weights)
+    : scenario(scenario), weights(weights), ensemblePercent(95)
+{
+}
+
+void Autotuner::setEnsemble(const std::vector<EnsembleMember>& members, double percent)
+{
+    ensemble = members;
+    ensemblePercent = percent;
+}
+
+bool Autotuner::addRange(const TuningRange& range)
+{
+    if (!findTunable(range.key))
+        return false;
+    ranges.push_back(range);
+    return true;
+}
+
+std::vector<ControlConstants> Autotuner::gridPoints() const
+{
+    std::vector<unsigned int> index(ranges.size(), 0);
+    std::vector<ControlConstants> points;
+    for (;;) {
+        ControlConstants cc = TempControl::ccDefaults;
+        for (unsigned int r = 0; r < ranges.size(); r++) {
+            const TuningRange& range = ranges[r];
+            double value = range.steps > 1 ? range.min + (range.max - range.min)*index[r]/(range.steps - 1) : range.min;
+            setConstant(cc, *findTunable(range.key), value);
+        }
+        points.push_back(cc);
+
+        // count up like an odometer, the first range changing fastest
+        unsigned int r = 0;
+        for (; r < ranges.size(); r++) {
+            if (++index[r] < std::max(ranges[r].steps, 1u))
+                break;
+            index[r] = 0;
+        }
+        if (r == ranges.size())
+            return points;
+    }
+}
+
+std::vector<ControlConstants> Autotuner::randomPoints(unsigned int count, unsigned int seed) const
+{
+    std::mt19937 random(seed);
+    std::vector<ControlConstants> points(count, TempControl::ccDefaults);
+    for (ControlConstants& cc : points) {
+        for (const TuningRange& range : ranges) {
+            std::uniform_real_distribution<double> value(range.min, range.max);
+            setConstant(cc, *findTunable(range.key), value(random));
+        }
+    }
+    return points;
+}
+
+TuningResult Autotuner::evaluate(const ControlConstants& cc, const EnsembleMember* member) const
+{
+    SimulatedChamber chamber;
+    Simulator& simulator = chamber.getSimulator();
+    if (member)
+        member->apply(simulator);
+    simulator.setBeerTemp(scenario.startTemp);
+    simulator.setFridgeTemp(scenario.startTemp);
+    chamber.init();
+
+    TempControl& control = chamber.getControl();
+    control.cc = cc;
+    control.initFilters();
+    control.setMode(scenario.mode);
+    bool beerMode = scenario.mode != MODE_FRIDGE_CONSTANT;
+    if (beerMode)
+        control.setBeerTemp(doubleToTemp(scenario.setting));
+    else
+        control.setFridgeTemp(doubleToTemp(scenario.setting));
+
+    // going past the setting is overshoot, staying short of it is not
+    double direction = scenario.startTemp > scenario.setting ? -1 : scenario.startTemp < scenario.setting ? 1 : 0;
+
+    TuningResult result;
+    result.cc = cc;
+    result.overshoot = 0;
+    result.settlingTime = 0;
+    result.coolCycles = 0;
+    result.heatCycles = 0;
+    result.degreeHours = 0;
+
+    unsigned long seconds = (unsigned long)(scenario.days*24*3600);
+    unsigned long time = 0;
+    bool cooling = false, heating = false;
+    while (time < seconds) {
+        double room = simulator.roomTemp();
+        unsigned long step = chamber.advance(scenario.events ? seconds - time : 1);
+        time += step;
+        result.degreeHours += fabs(room - scenario.setting)*step/3600.0;
+        double error = (beerMode ? simulator.getBeerTemp() : simulator.getFridgeTemp()) - scenario.setting;
+        result.overshoot = std::max(result.overshoot, direction ? direction*error : fabs(error));
+        if (fabs(error) > scenario.settleBand)
+            result.settlingTime = time;
+        if (control.stateIsCooling() && !cooling)
+            result.coolCycles++;
+        cooling = control.stateIsCooling();
+        if (control.stateIsHeating() && !heating)
+            result.heatCycles++;
+        heating = control.stateIsHeating();
+    }
+
+    result.energy = simulator.getHeatEnergy() + simulator.getCoolEnergy();
+    result.score = score(result);
+    return result;
+}
+
+double Autotuner::score(const TuningResult& result) const
+{
+    return weights.overshoot*result.overshoot
+        + weights.settlingTime*result.settlingTime/3600.0
+        + weights.coolCycles*result.coolCycles/scenario.days
+        + (result.degreeHours > 0 ? weights.energy*result.energy/result.degreeHours : 0);
+}
+
+/**
+ * Reduces the results of one candidate in every ensemble member to the percentile of each metric.
+ * The score is the percentile of the member scores, not the score of the percentiles.
+ */
+TuningResult Autotuner::combine(const TuningResult* results) const
+{
+    std::vector<double> overshoot, settlingTime, coolCycles, heatCycles, energy, degreeHours, scores;
+    for (unsigned int m = 0; m < ensemble.size(); m++) {
+        overshoot.push_back(results[m].overshoot);
+        settlingTime.push_back(results[m].settlingTime);
+        coolCycles.push_back(results[m].coolCycles);
+        heatCycles.push_back(results[m].heatCycles);
+        energy.push_back(results[m].energy);
+        degreeHours.push_back(results[m].degreeHours);
+        scores.push_back(results[m].score);
+    }
+    TuningResult combined;
+    combined.cc = results[0].cc;
+    combined.overshoot = percentile(overshoot, ensemblePercent);
+    combined.settlingTime = (unsigned long)lround(percentile(settlingTime, ensemblePercent));
+    combined.coolCycles = (unsigned int)lround(percentile(coolCycles, ensemblePercent));
+    combined.heatCycles = (unsigned int)lround(percentile(heatCycles, ensemblePercent));
+    combined.energy = percentile(energy, ensemblePercent);
+    combined.degreeHours = percentile(degreeHours, ensemblePercent);
+    combined.score = percentile(scores, ensemblePercent);
+    return combined;
+}
+
+std::vector<TuningResult> Autotuner::evaluateEnsemble(const ControlConstants& cc, unsigned int threads) const
+{
+    std::vector<TuningResult> results(ensemble.size());
+    SimulationPool pool(threads);
+    pool.run(ensemble.size(), [&](unsigned int m) {
+        results[m] = evaluate(cc, &ensemble[m]);
+    });
+    return results;
+}
+
+std::vector<TuningResult> Autotuner::run(const std::vector<ControlConstants>& candidates, unsigned int threads) const
+{
+    std::vector<TuningResult> results(candidates.size());
+    SimulationPool pool(threads);
+    if (ensemble.empty()) {
+        pool.run(candidates.size(), [&](unsigned int i) {
+            results[i] = evaluate(candidates[i]);
+        });
+    }
+    else {
+        // one task per candidate and member, so that small searches over large ensembles also use all threads
+        unsigned int members = ensemble.size();
+        std::vector<TuningResult> memberResults(candidates.size()*members);
+        pool.run(memberResults.size(), [&](unsigned int i) {
+            memberResults[i] = evaluate(candidates[i/members], &ensemble[i%members]);
+        });
+        for (unsigned int i = 0; i < candidates.size(); i++)
+            results[i] = combine(&memberResults[i*members]);
+    }
+    std::stable_sort(results.begin(), results.end(), [](const TuningResult& a, const TuningResult& b) {
+        return a.score < b.score;
+    });
+    return results;
+}
+
+void Autotuner::printJson(FILE* out, const ControlConstants& cc) const
+{
+    fputs("j{", out);
+    for (unsigned int r = 0; r < ranges.size(); r++) {
+        const TunableConstant& constant = *findTunable(ranges[r].key);
+        const uint8_t* field = (const uint8_t*)&cc + constant.offset;
+        char value[12];
+        if (constant.kind == TUNE_FILTER)
+            sprintf(value, "%d", *field);
+        else if (constant.kind == TUNE_FIXED_POINT)
+            fixedPointToString(value, *(const temperature*)field, 3, 12);
+        else
+            tempDiffToString(value, *(const temperature*)field, 3, 12);
+        // the firmware formatting pads numbers with spaces
+        const char* trimmed = value + strspn(value, " ");
+        fprintf(out, "%s\"%s\":%s", r ? "," : "", constant.key, trimmed);
+    }
+    fputs("}\n", out);
+}
+
+EnsembleSummary summarize(const std::vector<TuningResult>& results, double days)
+{
+    std::vector<double> overshoot, settlingHours, coolCyclesPerDay, heatCyclesPerDay, energy, scores;
+    for (const TuningResult& result : results) {
+        overshoot.push_back(result.overshoot);
+        settlingHours.push_back(result.settlingTime/3600.0);
+        coolCyclesPerDay.push_back(result.coolCycles/days);
+        heatCyclesPerDay.push_back(result.heatCycles/days);
+        energy.push_back(result.energy);
+        scores.push_back(result.score);
+    }
+    EnsembleSummary summary;
+    const double percents[2] = { 50, 95 };
+    for (int p = 0; p < 2; p++) {
+        summary.overshoot[p] = percentile(overshoot, percents[p]);
+        summary.settlingHours[p] = percentile(settlingHours, percents[p]);
+        summary.coolCyclesPerDay[p] = percentile(coolCyclesPerDay, percents[p]);
+        summary.heatCyclesPerDay[p] = percentile(heatCyclesPerDay, percents[p]);
+        summary.energy[p] = percentile(energy, percents[p]);
+        summary.score[p] = percentile(scores, percents[p]);
+    }
+    return summary;
+}
+
+/**
+ * Parses a range given as key=min:max[:steps]. A single value fixes the constant.
+ */
+static bool parseRange(char* arg, TuningRange& range)
+{
+    char* value = strchr(arg, '=');
+    if (!value)
+        return false;
+    *value++ = 0;
+    range.key = arg;
+    range.steps = 1;
+    char* end;
+    range.min = range.max = strtod(value, &end);
+    if (*end == ':') {
+        range.max = strtod(end+1, &end);
+        range.steps = 5;
+        if (*end == ':')
+            range.steps = strtoul(end+1, &end, 10);
+    }
+    return *end == 0 && end != value;
+}
+
+// A number given on the command line, from min to max.
+static bool parseNumber(const char* val, double min, double max, double& number)
+{
+    char* end;
+    double value = strtod(val, &end);
+    if (end == val || *end || !(value >= min && value <= max))
+        return false;
+    number = value;
+    return true;
+}
+
+int runTuner(int argc, const char* argv[])
+{
+    TuningScenario scenario;
+    TuningWeights weights;
+    std::vector<TuningRange> ranges;
+    std::vector<std::vector<char> > rangeArgs;
+    rangeArgs.reserve(argc);
+    unsigned int randomCount = 0, seed = 1, threads = 0, show = 10, members = 0;
+    double percent = 95;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || !arg[1] || arg[2] || i+1 >= argc) {
+            fprintf(stderr, "invalid tune argument %s\n", arg);
+            return 1;
+        }
+        const char* val = argv[++i];
+        bool valid = true;
+        switch (arg[1]) {
+            case 'd': scenario.days = atof(val); break;
+            case 'm': scenario.mode = val[0]=='f' ? MODE_FRIDGE_CONSTANT : MODE_BEER_CONSTANT; break;
+            case 's': scenario.setting = atof(val); break;
+            case 't': scenario.startTemp = atof(val); break;
+            case 'b': scenario.settleBand = atof(val); break;
+            case 'e': scenario.events = atoi(val)!=0; break;
+            case 'r': valid = parseCount(val, randomCount); break;
+            case 'S': valid = parseCount(val, seed); break;
+            case 'j': valid = parseCount(val, threads); break;
+            case 'k': valid = parseCount(val, show); break;
+            case 'O': weights.overshoot = atof(val); break;
+            case 'T': weights.settlingTime = atof(val); break;
+            case 'C': weights.coolCycles = atof(val); break;
+            case 'W': weights.energy = atof(val); break;
+            case 'E': valid = parseCount(val, members); break;
+            case 'P': valid = parseNumber(val, 0, 100, percent); break;
+            case 'p': {
+                rangeArgs.push_back(std::vector<char>(val, val+strlen(val)+1));
+                TuningRange range;
+                if (!parseRange(rangeArgs.back().data(), range)) {
+                    fprintf(stderr, "invalid range %s, expected key=min:max[:steps]\n", val);
+                    return 1;
+                }
+                ranges.push_back(range);
+                break;
+            }
+            default:
+                fprintf(stderr, "unknown tune option %s\n", arg);
+                return 1;
+        }
+        if (!valid) {
+            fprintf(stderr, "invalid tune argument %s %s\n", arg, val);
+            return 1;
+        }
+    }
+    if (scenario.days <= 0 || ranges.empty()) {
+        fprintf(stderr, "give at least one range to search with -p key=min:max[:steps]\n");
+        return 1;
+    }
+
+    Autotuner tuner(scenario, weights);
+    for (const TuningRange& range : ranges) {
+        if (!tuner.addRange(range)) {
+            fprintf(stderr, "%s is not a tunable constant\n", range.key);
+            return 1;
+        }
+    }
+
+    if (members)
+        tuner.setEnsemble(latinHypercube(EnsembleRanges(), members, seed), percent);
+
+    std::vector<ControlConstants> candidates = randomCount ? tuner.randomPoints(randomCount, seed) : tuner.gridPoints();
+    std::vector<TuningResult> results = tuner.run(candidates, threads);
+
+    printf("%u candidates, best first\n", (unsigned int)results.size());
+    for (unsigned int i = 0; i < results.size() && i < show; i++) {
+        const TuningResult& result = results[i];
+        printf("score %8.3f overshoot %6.3f settling %7.2f h cool cycles %4u energy %8.1f Wh   ", result.score,
+            result.overshoot, result.settlingTime/3600.0, result.coolCycles, result.energy);
+        tuner.printJson(stdout, result.cc);
+    }
+    printf("best constants:\n");
+    tuner.printJson(stdout, results.front().cc);
+    return 0;
+}
+
+int runEnsemble(int argc, const char* argv[])
+{
+    TuningScenario scenario;
+    std::vector<TuningRange> constants;
+    std::vector<std::vector<char> > constantArgs;
+    constantArgs.reserve(argc);
+    unsigned int members = 50, seed = 1, threads = 0;
+    double spread = 0.5, maxNoise = 0.1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || !arg[1] || arg[2] || i+1 >= argc) {
+            fprintf(stderr, "invalid ensemble argument %s\n", arg);
+            return 1;
+        }
+        const char* val = argv[++i];
+        bool valid = true;
+        switch (arg[1]) {
+            case 'd': scenario.days = atof(val); break;
+            case 'm': scenario.mode = val[0]=='f' ? MODE_FRIDGE_CONSTANT : MODE_BEER_CONSTANT; break;
+            case 's': scenario.setting = atof(val); break;
+            case 't': scenario.startTemp = atof(val); break;
+            case 'b': scenario.settleBand = atof(val); break;
+            case 'e': scenario.events = atoi(val)!=0; break;
+            case 'n': valid = parseCount(val, members); break;
+            case 'S': valid = parseCount(val, seed); break;
+            case 'j': valid = parseCount(val, threads); break;
+            case 'u': valid = parseNumber(val, 0, 1, spread) && spread < 1; break;
+            case 'N': maxNoise = atof(val); break;
+            case 'p': {
+                constantArgs.push_back(std::vector<char>(val, val+strlen(val)+1));
+                TuningRange range;
+                if (!parseRange(constantArgs.back().data(), range) || range.steps != 1) {
+                    fprintf(stderr, "invalid constant %s, expected key=value\n", val);
+                    return 1;
+                }
+                constants.push_back(range);
+                break;
+            }
+            default:
+                fprintf(stderr, "unknown ensemble option %s\n", arg);
+                return 1;
+        }
+        if (!valid) {
+            fprintf(stderr, "invalid ensemble argument %s %s\n", arg, val);
+            return 1;
+        }
+    }
+    if (scenario.days <= 0 || !members) {
+        fprintf(stderr, "give a positive number of days and members\n");
+        return 1;
+    }
+
+    // the constants are a grid with a single point
+    Autotuner tuner(scenario);
+    for (const TuningRange& range : constants) {
+        if (!tuner.addRange(range)) {
+            fprintf(stderr, "%s is not a tunable constant\n", range.key);
+            return 1;
+        }
+    }
+    EnsembleRanges ranges(spread);
+    ranges.sensorNoise.high = maxNoise;
+    tuner.setEnsemble(latinHypercube(ranges, members, seed));
+
+    ControlConstants cc = tuner.gridPoints().front();
+    EnsembleSummary summary = summarize(tuner.evaluateEnsemble(cc, threads), scenario.days);
+
+    printf("%u fridges, parameters within %.0f%% of the defaults, sensor noise up to %.3f\n", members, spread*100,
+        maxNoise);
+    printf("                       p50       p95\n");
+    printf("overshoot          %9.3f %9.3f\n", summary.overshoot[0], summary.overshoot[1]);
+    printf("settling (h)       %9.2f %9.2f\n", summary.settlingHours[0], summary.settlingHours[1]);
+    printf("cool cycles/day    %9.2f %9.2f\n", summary.coolCyclesPerDay[0], summary.coolCyclesPerDay[1]);
+    printf("heat cycles/day    %9.2f %9.2f\n", summary.heatCyclesPerDay[0], summary.heatCyclesPerDay[1]);
+    printf("energy (Wh)        %9.1f %9.1f\n", summary.energy[0], summary.energy[1]);
+    printf("score              %9.3f %9.3f\n", summary.score[0], summary.score[1]);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "TempControl.h"
+#include "Ensemble.h"
+
+#include <stdio.h>
+#include <vector>
+
+/**
+ * The closed loop test every candidate set of constants is put through: a fresh chamber at startTemp is given a
+ * setting in beer or fridge constant mode and is run for the given number of days.
+ */
+struct TuningScenario
+{
+    TuningScenario();
+
+    double days;
+    char mode;
+    double setting;
+    double startTemp;
+    double settleBand;      // the controlled temperature is settled once it stays within this distance of the setting
+    bool events;            // use next-event stepping, faster but approximate
+};
+
+/**
+ * How the metrics of a run add up to its score. Lower scores are better.
+ */
+struct TuningWeights
+{
+    TuningWeights();
+
+    double overshoot;       // per degree overshoot
+    double settlingTime;    // per hour settling time
+    double coolCycles;      // per compressor cycle per day
+    double energy;          // per Wh used per degree hour held
+};
+
+/**
+ * A range for one of the tunable constants, by its PiLink json key.
+ * A grid search takes steps values, evenly spaced from min to max, a random search draws uniformly from [min, max].
+ */
+struct TuningRange
+{
+    const char* key;
+    double min;
+    double max;
+    unsigned int steps;
+};
+
+struct TuningResult
+{
+    ControlConstants cc;
+    double overshoot;               // furthest the controlled temperature went past the setting, in degrees
+    unsigned long settlingTime;     // seconds until the controlled temperature stayed within the settle band
+    unsigned int coolCycles;        // number of times the compressor was switched on
+    unsigned int heatCycles;        // number of times the heater was switched on
+    double energy;                  // Wh used by the heater and cooler
+    double degreeHours;             // integral of the distance between the room temperature and the setting, in Kh
+    double score;
+};
+
+/**
+ * Searches the control constants that give the best closed loop behavior in a scenario.
+ * Each candidate runs in its own SimulatedChamber, the candidates are spread over a SimulationPool.
+ * Tunable are the PID gains, iMaxErr, the idle range, pidMax and the filter b values.
+ * With an ensemble set, every candidate is run in every member fridge and is judged by a percentile of the members,
+ * so the constants found are robust to a fridge that differs from the model.
+ */
+class Autotuner
+{
+public:
+    Autotuner(const TuningScenario& scenario, const TuningWeights& weights = TuningWeights());
+
+    /**
+     * Adds a range to search.
+     * @return false when the key is not a tunable constant.
+     */
+    bool addRange(const TuningRange& range);
+
+    /**
+     * Every combination of the range values, with the default constants for the fields not searched.
+     */
+    std::vector<ControlConstants> gridPoints() const;
+
+    /**
+     * The given number of random points within the ranges, reproducible with the same seed.
+     */
+    std::vector<ControlConstants> randomPoints(unsigned int count, unsigned int seed) const;
+
+    /**
+     * Judges candidates by the given percentile of their results over the members instead of by a single run.
+     * An empty ensemble goes back to single runs in the default fridge.
+     */
+    void setEnsemble(const std::vector<EnsembleMember>& members, double percent = 95);
+
+    /**
+     * Runs the scenario with the given constants, in the default fridge or in the given ensemble member.
+     */
+    TuningResult evaluate(const ControlConstants& cc, const EnsembleMember* member = NULL) const;
+
+    /**
+     * Runs the scenario with the given constants in every member of the ensemble, in parallel.
+     * @return the result of each member, in member order.
+     */
+    std::vector<TuningResult> evaluateEnsemble(const ControlConstants& cc, unsigned int threads = 0) const;
+
+    /**
+     * Evaluates all candidates in parallel.
+     * @param threads number of worker threads, 0 uses one per hardware thread.
+     * @return the results, best score first.
+     */
+    std::vector<TuningResult> run(const std::vector<ControlConstants>& candidates, unsigned int threads = 0) const;
+
+    /**
+     * Writes the searched constants as a PiLink j command. Temperature differences are in Celsius.
+     */
+    void printJson(FILE* out, const ControlConstants& cc) const;
+
+private:
+    TuningScenario scenario;
+    TuningWeights weights;
+    std::vector<TuningRange> ranges;
+    std::vector<EnsembleMember> ensemble;
+    double ensemblePercent;
+
+    double score(const TuningResult& result) const;
+    TuningResult combine(const TuningResult* results) const;
+};
+
+/**
+ * The spread of the closed loop behavior of one set of constants over an ensemble: the median and 95th percentile of
+ * each metric.
+ */
+struct EnsembleSummary
+{
+    double overshoot[2];
+    double settlingHours[2];
+    double coolCyclesPerDay[2];
+    double heatCyclesPerDay[2];
+    double energy[2];
+    double score[2];
+};
+
+EnsembleSummary summarize(const std::vector<TuningResult>& results, double days);
+
+/**
+ * Command line entry for --tune, runs a search and prints the ranking and the best constants.
+ * With -E members every candidate is judged over a Latin hypercube ensemble, by the percentile given with -P.
+ */
+int runTuner(int argc, const char* argv[]);
+
+/**
+ * Command line entry for --ensemble, runs one set of constants over a Latin hypercube sample of fridges and prints the
+ * median and 95th percentile of the metrics.
+ */
+int runEnsemble(int argc, const char* argv[]);
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchSimulation.h"
+#include "SimulatedChamber.h"
+#include "SimulationPool.h"
+#include "ChamberBatch.h"
+#include "TraceRecorder.h"
+#include "Scenario.h"
+#include "GlycolChiller.h"
+#include "AmbientProfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+struct BatchOptions
+{
+    double days;
+    char mode;
+    double setting;
+    double startTemp;
+    unsigned int chambers;
+    unsigned int threads;
+    bool events;
+    unsigned int variants;
+    const char* tracePrefix;
+    double forkHours;
+    double forkStep;
+    const char* scenario;
+    const char* fermentCurve;
+    double doorOpenings;
+    double doorOpenSeconds;
+    double chillerPower;
+    unsigned int openValves;
+    bool warmestFirst;
+    const char* ambient;
+};
+
+bool parseCount(const char* val, unsigned int& count)
+{
+    char* end;
+    errno = 0;
+    unsigned long value = strtoul(val, &end, 10);
+    if (!isdigit((unsigned char)val[0]) || *end || errno || value == 0 || value > UINT_MAX)
+        return false;
+    count = (unsigned int)value;
+    return true;
+}
+
+static bool parseBatchOptions(int argc, const char* argv[], BatchOptions& options)
+{
+    options.days = 30;
+    options.mode = MODE_BEER_CONSTANT;
+    options.setting = 18.0;
+    options.startTemp = 22.0;
+    options.chambers = 1;
+    options.threads = 0;
+    options.events = false;
+    options.variants = 0;
+    options.tracePrefix = NULL;
+    options.forkHours = 0;
+    options.forkStep = 0.5;
+    options.scenario = NULL;
+    options.fermentCurve = NULL;
+    options.doorOpenings = 0;
+    options.doorOpenSeconds = 30;
+    options.chillerPower = 0;
+    options.openValves = 0;
+    options.warmestFirst = false;
+    options.ambient = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || !arg[1] || arg[2] || i+1 >= argc) {
+            fprintf(stderr, "invalid batch argument %s\n", arg);
+            return false;
+        }
+        const char* val = argv[++i];
+        bool valid = true;
+        switch (arg[1]) {
+            case 'd': options.days = atof(val); break;
+            case 'm': options.mode = val[0]=='f' ? MODE_FRIDGE_CONSTANT : MODE_BEER_CONSTANT; break;
+            case 's': options.setting = atof(val); break;
+            case 't': options.startTemp = atof(val); break;
+            case 'n': valid = parseCount(val, options.chambers); break;
+            case 'j': valid = parseCount(val, options.threads); break;
+            case 'e': options.events = atoi(val)!=0; break;
+            case 'v': valid = parseCount(val, options.variants); break;
+            case 'o': options.tracePrefix = val; break;
+            case 'f': options.forkHours = atof(val); break;
+            case 'D': options.forkStep = atof(val); break;
+            case 'x': options.scenario = val; break;
+            case 'F': options.fermentCurve = val; break;
+            case 'p': options.doorOpenings = atof(val); break;
+            case 'P': options.doorOpenSeconds = atof(val); break;
+            case 'g': options.chillerPower = atof(val); break;
+            case 'G': valid = parseCount(val, options.openValves); break;
+            case 'w': options.warmestFirst = atoi(val)!=0; break;
+            case 'a': options.ambient = val; break;
+            default:
+                fprintf(stderr, "unknown batch option %s\n", arg);
+                return false;
+        }
+        if (!valid) {
+            fprintf(stderr, "invalid batch argument %s %s\n", arg, val);
+            return false;
+        }
+    }
+    if (options.chillerPower > 0 && options.forkHours > 0) {
+        fprintf(stderr, "chambers on a shared chiller cannot fork\n");
+        return false;
+    }
+    return options.days > 0 && options.chambers > 0;
+}
+
+/**
+ * Reads a measured fermentation heat curve: one point per line with the hours since pitching and the output in W.
+ * Anything after # is a comment.
+ */
+static bool loadFermentCurve(const char* path, std::vector<double>& hours, std::vector<double>& watts)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open fermentation curve %s\n", path);
+        return false;
+    }
+    char line[256];
+    unsigned int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        double h, w;
+        char extra;
+        int fields = sscanf(line, "%lf %lf %c", &h, &w, &extra);
+        if (fields == EOF)
+            continue;
+        if (fields != 2 || (!hours.empty() && h <= hours.back()) || hours.size() == 255) {
+            fprintf(stderr, "%s:%u: invalid fermentation curve point\n", path, lineNumber);
+            ok = false;
+        }
+        hours.push_back(h);
+        watts.push_back(w);
+    }
+    fclose(f);
+    return ok;
+}
+
+static void applySetting(TempControl& control, const BatchOptions& options, double offset = 0)
+{
+    double setting = options.setting + offset;
+    control.setMode(options.mode);
+    if (options.mode == MODE_FRIDGE_CONSTANT)
+        control.setFridgeTemp(doubleToTemp(setting));
+    else
+        control.setBeerTemp(doubleToTemp(setting));
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printThroughput(unsigned long seconds, unsigned int chambers, double elapsed, unsigned int threads)
+{
+    double simulated = double(seconds)*chambers;
+    printf("simulated %lu s in %u chamber(s) in %.3f s wall time on %u thread(s)\n", seconds, chambers, elapsed, threads);
+    printf("%.0f simulated seconds per wall clock second\n", elapsed > 0 ? simulated/elapsed : 0);
+}
+
+#if BREWPI_CONTROL_KPI
+static void printKpi(const char* name, unsigned int i, ControlKpi& kpi)
+{
+    printf("%s %u: rms %.3f overshoot %.3f settling %lu s heat %u cycles %.1f%% cool %u cycles %.1f%% states",
+        name, i, double(kpi.getRmsError())/TEMP_FIXED_POINT_SCALE, double(kpi.getOvershoot())/TEMP_FIXED_POINT_SCALE,
+        (unsigned long)kpi.getSettlingTime(), kpi.getHeatCycles(), kpi.getHeatDuty()/10.0,
+        kpi.getCoolCycles(), kpi.getCoolDuty()/10.0);
+    for (uint8_t s = 0; s < NUM_STATES; s++) {
+        printf(" %lu", (unsigned long)kpi.getStateTime(s));
+    }
+    printf("\n");
+}
+#endif
+
+static int runChambers(const BatchOptions& options, unsigned long seconds)
+{
+    // without a scenario file the chambers just run
+    Scenario scenario;
+    if (options.scenario && !scenario.load(options.scenario)) {
+        return 1;
+    }
+
+    // every chamber gets its own random door openings on top of the scenario
+    std::vector<Scenario> scenarios(options.chambers, scenario);
+    std::vector<unsigned int> doorOpenings(options.chambers);
+    for (unsigned int i = 0; i < options.chambers; i++) {
+        doorOpenings[i] = scenarios[i].addDoorOpenings(options.doorOpenings, options.doorOpenSeconds, 0, seconds, i+1);
+    }
+
+    std::vector<double> curveHours, curveWatts;
+    if (options.fermentCurve && !loadFermentCurve(options.fermentCurve, curveHours, curveWatts)) {
+        return 1;
+    }
+
+    // each chamber reads the room temperature profile at its own pace
+    std::vector<AmbientProfile> ambient(options.ambient ? options.chambers : 0);
+    for (AmbientProfile& profile : ambient) {
+        if (!profile.open(options.ambient)) {
+            fprintf(stderr, "cannot read room temperature profile %s\n", options.ambient);
+            return 1;
+        }
+    }
+
+    std::vector<SimulatedChamber> chambers(options.chambers);
+    std::vector<TraceRecorder> traces(options.tracePrefix ? options.chambers : 0);
+    for (unsigned int i = 0; i < options.chambers; i++) {
+        SimulatedChamber& chamber = chambers[i];
+        chamber.getSimulator().setRandomSeed(i+1);
+        if (options.ambient)
+            chamber.getSimulator().setRoomTempSource(&ambient[i]);
+        if (options.fermentCurve)
+            chamber.getSimulator().setFermentCurve(curveHours.data(), curveWatts.data(), curveHours.size());
+        chamber.getSimulator().setBeerTemp(options.startTemp);
+        chamber.getSimulator().setFridgeTemp(options.startTemp);
+        chamber.init();
+        applySetting(chamber.getControl(), options);
+        if (options.tracePrefix) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s%u.trace", options.tracePrefix, i);
+            if (!traces[i].open(path)) {
+                fprintf(stderr, "cannot open trace file %s\n", path);
+                return 1;
+            }
+            chamber.setTraceRecorder(&traces[i]);
+        }
+    }
+
+    // simulate the shared history once, then give every chamber its own setting from there
+    unsigned long forkSeconds = std::min((unsigned long)(options.forkHours*3600), seconds);
+    if (forkSeconds) {
+        scenarios[0].run(chambers[0], 0, forkSeconds, options.events);
+        ChamberSnapshot history;
+        chambers[0].save(history);
+        for (unsigned int i = 0; i < options.chambers; i++) {
+            chambers[i].restore(history);
+            if (options.ambient)
+                chambers[i].getSimulator().setRoomTempSource(&ambient[i]);     // not the profile of the history
+            applySetting(chambers[i].getControl(), options, i*options.forkStep);
+        }
+    }
+
+    SimulationPool pool(options.threads);
+    GlycolChiller chiller(50, options.chillerPower);
+    unsigned int threads = pool.getThreadCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (options.chillerPower > 0) {
+        // coupled chambers step together, one second at a time
+        for (SimulatedChamber& chamber : chambers) {
+            chiller.add(chamber);
+        }
+        if (options.openValves) {
+            chiller.setStrategy(options.warmestFirst ? VALVES_WARMEST_FIRST : VALVES_FIRST_COME, options.openValves);
+        }
+        for (unsigned long t = forkSeconds; t < seconds; t++) {
+            chiller.beginStep();
+            for (unsigned int i = 0; i < options.chambers; i++) {
+                scenarios[i].run(chambers[i], t, t+1);
+            }
+            chiller.endStep();
+        }
+        threads = 1;
+    }
+    else {
+        pool.run(options.chambers, [&](unsigned int i) {
+            scenarios[i].run(chambers[i], forkSeconds, seconds, options.events);
+        });
+    }
+    double elapsed = secondsSince(start);
+    seconds -= forkSeconds;
+
+    for (unsigned int i = 0; i < options.chambers; i++) {
+        Simulator& sim = chambers[i].getSimulator();
+        printf("chamber %u: beer %.3f fridge %.3f state %d control ticks %lu door openings %u\n", i, sim.getBeerTemp(),
+            sim.getFridgeTemp(), chambers[i].getControl().getState(), chambers[i].getControlTicks(), doorOpenings[i]);
+    }
+#if BREWPI_CONTROL_KPI
+    for (unsigned int i = 0; i < options.chambers; i++) {
+        printKpi("chamber", i, chambers[i].getControl().kpi);
+    }
+#endif
+    for (unsigned int i = 0; i < options.chambers; i++) {
+        Simulator& sim = chambers[i].getSimulator();
+        printf("chamber %u: heat %.3f Wh cool %.3f Wh", i, sim.getHeatEnergy(), sim.getCoolEnergy());
+#if BREWPI_ENERGY_METER
+        TempControl& control = chambers[i].getControl();
+        printf(", metered heat %.3f Wh cool %.3f Wh", control.getHeaterOnTime()*control.cc.heaterPower/3600.0,
+            control.getCoolerOnTime()*control.cc.coolerPower/3600.0);
+#endif
+        printf("\n");
+    }
+    if (options.chillerPower > 0) {
+        printf("chiller: glycol %.2f max %.2f on %lu s %.3f Wh peak open valves %u, valve wait per chamber",
+            chiller.getTemp(), chiller.getMaxTemp(), chiller.getChillerOnTime(), chiller.getChillerEnergy(),
+            chiller.getMaxOpenValves());
+        for (unsigned int i = 0; i < options.chambers; i++) {
+            printf(" %lu", chiller.getWaitTime(i));
+        }
+        printf(" s\n");
+    }
+    printThroughput(seconds, options.chambers, elapsed, threads);
+    return 0;
+}
+
+/**
+ * Runs physical variants of the default chamber in a ChamberBatch, each driven by its own controller.
+ * Every parameter of a variant is drawn uniformly between half and 1.5 times the default, with a fixed seed.
+ */
+static int runVariants(const BatchOptions& options, unsigned long seconds)
+{
+    const double minRoomTemp = 13.0, maxRoomTemp = 18.0;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> spread(0.5, 1.5);
+    std::vector<ChamberVariant> variants(options.variants);
+    for (ChamberVariant& v : variants) {
+        v.fridgeVolume *= spread(random);
+        v.beerVolume *= spread(random);
+        v.heatPower *= spread(random);
+        v.coolPower *= spread(random);
+        v.Ke *= spread(random);
+        v.Kb *= spread(random);
+    }
+    ChamberBatch batch(variants);
+
+    std::vector<ChamberController> controllers(options.variants);
+    for (unsigned int i = 0; i < options.variants; i++) {
+        batch.setTemperatures(i, options.startTemp, options.startTemp);
+        controllers[i].initControl();
+        controllers[i].setProbeTemperatures(options.startTemp, options.startTemp, dailyRoomTemp(minRoomTemp, maxRoomTemp, 0));
+        controllers[i].initSensors();
+        applySetting(controllers[i].getControl(), options);
+    }
+
+    // give each thread a block of whole vectors
+    SimulationPool pool(options.threads);
+    unsigned int width = ChamberBatch::getVectorWidth();
+    unsigned int blockSize = (options.variants + pool.getThreadCount() - 1) / pool.getThreadCount();
+    blockSize = (blockSize + width - 1) / width * width;
+    unsigned int blocks = (options.variants + blockSize - 1) / blockSize;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pool.run(blocks, [&](unsigned int block) {
+        unsigned int begin = block*blockSize;
+        unsigned int end = std::min(begin + blockSize, options.variants);
+        for (unsigned long t = 0; t < seconds; t++) {
+            double room = dailyRoomTemp(minRoomTemp, maxRoomTemp, t);
+            for (unsigned int i = begin; i < end; i++) {
+                ChamberController& controller = controllers[i];
+                controller.setProbeTemperatures(batch.getBeerTemp(i), batch.getFridgeTemp(i), room);
+                controller.updateControl();
+                controller.getTicks().incMillis(1000);
+                TempControl& control = controller.getControl();
+                batch.setOutputs(i, control.stateIsHeating() ? 1.0 : 0.0, control.stateIsCooling() ? 1.0 : 0.0);
+            }
+            batch.step(room, 0, begin, end);
+        }
+    });
+    double elapsed = secondsSince(start);
+
+    for (unsigned int i = 0; i < options.variants && i < 10; i++) {
+        printf("variant %u: beer %.3f fridge %.3f\n", i, batch.getBeerTemp(i), batch.getFridgeTemp(i));
+    }
+#if BREWPI_CONTROL_KPI
+    for (unsigned int i = 0; i < options.variants && i < 10; i++) {
+        printKpi("variant", i, controllers[i].getControl().kpi);
+    }
+#endif
+    printThroughput(seconds, options.variants, elapsed, pool.getThreadCount());
+
+    // the physics kernel alone, without controllers
+    start = std::chrono::steady_clock::now();
+    for (unsigned long t = 0; t < seconds; t++) {
+        batch.step(dailyRoomTemp(minRoomTemp, maxRoomTemp, t), 0);
+    }
+    elapsed = secondsSince(start);
+    printf("model only: %.0f chamber-seconds per second with vectors of %u\n",
+        elapsed > 0 ? double(seconds)*options.variants/elapsed : 0, width);
+    return 0;
+}
+
+int runBatch(int argc, const char* argv[])
+{
+    BatchOptions options;
+    if (!parseBatchOptions(argc, argv, options)) {
+        return 1;
+    }
+    unsigned long seconds = (unsigned long)(options.days*24*3600);
+    return options.variants ? runVariants(options, seconds) : runChambers(options, seconds);
+}
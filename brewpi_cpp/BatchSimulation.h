@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+/**
+ * Headless fast-forward simulation for the desktop build.
+ * Runs one or more SimulatedChambers in a tight loop without display, serial link or real-time pacing, and reports
+ * how many simulated seconds were run per wall clock second.
+ *
+ * Invoked as: brewpi --batch [-d days] [-m b|f] [-s setting] [-t start temp] [-n chambers] [-j threads] [-e 1] [-v variants]
+ * -e 1 uses next-event stepping, see SimulatedChamber::advance.
+ * -v n simulates n physical variants with the vectorized ChamberBatch model instead of n identical chambers.
+ * -p n opens the door of each chamber n times per day on average, at random, for -P seconds on average (30).
+ * -g W cools all chambers with glycol from one chiller of that power, see GlycolChiller. -G n allows at most n open
+ * valves at once, given first come first served or with -w 1 to the warmest fridge first.
+ * -a file takes the room temperature from a recorded profile, a trace or a text file, see AmbientProfile.
+ * -F file replaces the fermentation heat of the chambers by a measured curve, lines of hours since pitching and watts.
+ * Returns the process exit code.
+ */
+int runBatch(int argc, const char* argv[]);
+
+/**
+ * Parses a count given on the command line: a whole number of at least 1. Returns false for anything else, leaving
+ * count unchanged.
+ */
+bool parseCount(const char* val, unsigned int& count);
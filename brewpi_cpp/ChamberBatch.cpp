@@ -0,0 +1,115 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ChamberBatch.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256d vdouble;
+#define VECTOR_WIDTH 4
+#define vload _mm256_loadu_pd
+#define vstore _mm256_storeu_pd
+#define vset _mm256_set1_pd
+#define vadd _mm256_add_pd
+#define vsub _mm256_sub_pd
+#define vmul _mm256_mul_pd
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128d vdouble;
+#define VECTOR_WIDTH 2
+#define vload _mm_loadu_pd
+#define vstore _mm_storeu_pd
+#define vset _mm_set1_pd
+#define vadd _mm_add_pd
+#define vsub _mm_sub_pd
+#define vmul _mm_mul_pd
+#else
+typedef double vdouble;
+#define VECTOR_WIDTH 1
+#define vload(p) (*(p))
+#define vstore(p, v) (*(p) = (v))
+#define vset(v) (v)
+#define vadd(a, b) ((a)+(b))
+#define vsub(a, b) ((a)-(b))
+#define vmul(a, b) ((a)*(b))
+#endif
+
+ChamberBatch::ChamberBatch(const std::vector<ChamberVariant>& variants)
+    : count(variants.size())
+{
+    // pad to whole vectors, padding lanes are simulated but never read
+    unsigned int lanes = (count + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH;
+    Lanes* all[] = { &fridgeTemp, &beerTemp, &heat, &cool, &heatRate, &coolRate, &roomRate, &fermentRate,
+        &fridgeCapacity, &beerCapacity, &Ke, &Kb, &f11, &f12, &f21, &f22, &g11, &g12, &g21, &g22 };
+    for (Lanes* l : all) {
+        l->assign(lanes, 0.0);
+    }
+    ChamberVariant padding;
+    for (unsigned int i = 0; i < lanes; i++) {
+        const ChamberVariant& v = i < count ? variants[i] : padding;
+        fridgeCapacity[i] = fridgeHeatCapacity(v.fridgeVolume);
+        beerCapacity[i] = beerHeatCapacity(v.beerVolume, v.beerDensity);
+        Ke[i] = v.Ke;
+        Kb[i] = v.Kb;
+        heatRate[i] = v.heatPower / fridgeCapacity[i];
+        coolRate[i] = v.coolPower / fridgeCapacity[i];
+        roomRate[i] = v.Ke / fridgeCapacity[i];
+        fermentRate[i] = 1.0 / beerCapacity[i];
+    }
+    setStepLength(1);
+}
+
+unsigned int ChamberBatch::getVectorWidth()
+{
+    return VECTOR_WIDTH;
+}
+
+void ChamberBatch::setStepLength(unsigned long seconds)
+{
+    ThermalTransition t;
+    for (unsigned int i = 0; i < fridgeTemp.size(); i++) {
+        t.compute(fridgeCapacity[i], beerCapacity[i], Ke[i], Kb[i], seconds);
+        f11[i] = t.f11; f12[i] = t.f12; f21[i] = t.f21; f22[i] = t.f22;
+        g11[i] = t.g11; g12[i] = t.g12; g21[i] = t.g21; g22[i] = t.g22;
+    }
+}
+
+void ChamberBatch::step(double roomTemp, double fermentPower, unsigned int begin, unsigned int end)
+{
+    vdouble room = vset(roomTemp);
+    vdouble ferment = vset(fermentPower);
+    begin -= begin % VECTOR_WIDTH;
+    for (unsigned int i = begin; i < end; i += VECTOR_WIDTH) {
+        vdouble fridge = vload(&fridgeTemp[i]);
+        vdouble beer = vload(&beerTemp[i]);
+        // temperature independent input of each node, see ThermalTransition
+        vdouble fridgeInput = vadd(vsub(vmul(vload(&heat[i]), vload(&heatRate[i])), vmul(vload(&cool[i]), vload(&coolRate[i]))),
+            vmul(vload(&roomRate[i]), room));
+        vdouble beerInput = vmul(vload(&fermentRate[i]), ferment);
+
+        vdouble newFridge = vadd(vadd(vmul(vload(&f11[i]), fridge), vmul(vload(&f12[i]), beer)),
+            vadd(vmul(vload(&g11[i]), fridgeInput), vmul(vload(&g12[i]), beerInput)));
+        vdouble newBeer = vadd(vadd(vmul(vload(&f21[i]), fridge), vmul(vload(&f22[i]), beer)),
+            vadd(vmul(vload(&g21[i]), fridgeInput), vmul(vload(&g22[i]), beerInput)));
+        vstore(&fridgeTemp[i], newFridge);
+        vstore(&beerTemp[i], newBeer);
+    }
+}
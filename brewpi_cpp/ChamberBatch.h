@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Simulator.h"
+
+#include <vector>
+
+/**
+ * Physical parameters of one chamber in a ChamberBatch. Defaults are those of the Simulator.
+ */
+struct ChamberVariant
+{
+    double fridgeVolume;    // liters
+    double beerVolume;      // liters
+    double beerDensity;     // SG
+    double heatPower;       // W
+    double coolPower;       // W
+    double Ke;              // W/K, chamber <> room
+    double Kb;              // W/K, chamber <> beer
+
+    ChamberVariant() : fridgeVolume(400), beerVolume(20), beerDensity(1.060), heatPower(25), coolPower(60), Ke(1.67), Kb(3) {}
+};
+
+/**
+ * Steps the thermal model of many chambers at once.
+ * The two-node core of the Simulator model: fridge air and beer exchanging heat with each other and the room, driven
+ * by the heater, cooler and fermentation power, with the same exact discretization. The heater and cooler lag, the
+ * probe model and door losses of the Simulator are not included. All state is in structure-of-arrays layout so that
+ * one call updates a vector of chambers per instruction with SSE2 or AVX. Each chamber (lane) has its own physical
+ * parameters and its own heater and cooler input, so a matching set of controllers can drive the lanes.
+ */
+class ChamberBatch
+{
+public:
+    ChamberBatch(const std::vector<ChamberVariant>& variants);
+
+    unsigned int size() { return count; }
+
+    void setTemperatures(unsigned int lane, double fridge, double beer) { fridgeTemp[lane] = fridge; beerTemp[lane] = beer; }
+    double getFridgeTemp(unsigned int lane) { return fridgeTemp[lane]; }
+    double getBeerTemp(unsigned int lane) { return beerTemp[lane]; }
+
+    /**
+     * Sets the control input of a lane, held until it is set again. A value between 0 and 1 gives a duty cycle.
+     */
+    void setOutputs(unsigned int lane, double heating, double cooling) { heat[lane] = heating; cool[lane] = cooling; }
+
+    /**
+     * Sets the number of seconds each step advances. This recomputes the discretization of every lane, so call it
+     * once before stepping, not from the threads doing the steps. The default is 1 second.
+     */
+    void setStepLength(unsigned long seconds);
+
+    /**
+     * Advances lanes [begin, end) by one step, with the room temperature and fermentation power held constant over
+     * the step. Lanes are processed in whole vectors, so when different threads step different ranges, the ranges
+     * should start and end at a multiple of getVectorWidth().
+     */
+    void step(double roomTemp, double fermentPower, unsigned int begin, unsigned int end);
+
+    void step(double roomTemp, double fermentPower) { step(roomTemp, fermentPower, 0, count); }
+
+    /**
+     * Number of lanes processed per instruction.
+     */
+    static unsigned int getVectorWidth();
+
+private:
+    typedef std::vector<double> Lanes;
+
+    unsigned int count;
+
+    Lanes fridgeTemp, beerTemp;
+    Lanes heat, cool;
+    // temperature change per second of the fridge for full heat, full cool and per degree room temperature,
+    // and of the beer per Watt fermentation
+    Lanes heatRate, coolRate, roomRate, fermentRate;
+    Lanes fridgeCapacity, beerCapacity, Ke, Kb;
+    Lanes f11, f12, f21, f22, g11, g12, g21, g22;
+};
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ChamberController.h"
+#include "Simulator.h"
+#include "TraceRecorder.h"
+
+ChamberController::ChamberController()
+    : beerProbe(true), fridgeProbe(true), roomProbe(true),
+    beerSensor(TEMP_SENSOR_TYPE_BEER, &beerProbe), fridgeSensor(TEMP_SENSOR_TYPE_FRIDGE, &fridgeProbe),
+    door(false), control(ticks), controlTicks(0), trace(NULL)
+{
+    control.beerSensor = &beerSensor;
+    control.fridgeSensor = &fridgeSensor;
+    control.ambientSensor = &roomProbe;
+    control.heater = &heater;
+    control.cooler = &cooler;
+    control.light = &light;
+    control.fan = &fan;
+    control.door = &door;
+}
+
+ControllerSnapshot::ControllerSnapshot()
+    : time(0), controlTicks(0), beerProbe(true), fridgeProbe(true), roomProbe(true),
+    beerSensor(TEMP_SENSOR_TYPE_BEER), fridgeSensor(TEMP_SENSOR_TYPE_FRIDGE),
+    heater(false), cooler(false), light(false), fan(false), doorOpen(false)
+{
+}
+
+void ChamberController::initControl()
+{
+    control.init();
+    control.loadDefaultSettings();
+    control.loadDefaultConstants();
+}
+
+void ChamberController::initSensors()
+{
+    // initialize the filters with the assigned initial temp value
+    beerSensor.init();
+    fridgeSensor.init();
+}
+
+void ChamberController::updateControl()
+{
+    control.updateTemperatures();
+    control.detectPeaks();
+    control.updatePID();
+    control.updateState();
+    control.updateOutputs();
+    if (trace)
+        trace->record(control, ticks.millis());
+    controlTicks++;
+}
+
+void ChamberController::setProbeTemperatures(double beer, double fridge, double room)
+{
+    const double resolution = 0.0625;
+    beerProbe.setValue(doubleToTemp(quantize(beer, resolution)));
+    fridgeProbe.setValue(doubleToTemp(quantize(fridge, resolution)));
+    roomProbe.setValue(doubleToTemp(quantize(room, resolution)));
+}
+
+void ChamberController::setProbeValues(temperature beer, temperature fridge, temperature room)
+{
+    beerProbe.setValue(beer);
+    fridgeProbe.setValue(fridge);
+    roomProbe.setValue(room);
+}
+
+void ChamberController::save(ControllerSnapshot& snapshot)
+{
+    snapshot.time = ticks.millis();
+    snapshot.controlTicks = controlTicks;
+    snapshot.control.save(control);
+    snapshot.beerProbe = beerProbe;
+    snapshot.fridgeProbe = fridgeProbe;
+    snapshot.roomProbe = roomProbe;
+    snapshot.beerSensor.copyState(beerSensor);
+    snapshot.fridgeSensor.copyState(fridgeSensor);
+    snapshot.heater = heater.isActive();
+    snapshot.cooler = cooler.isActive();
+    snapshot.light = light.isActive();
+    snapshot.fan = fan.isActive();
+    snapshot.doorOpen = door.sense();
+}
+
+void ChamberController::restore(const ControllerSnapshot& snapshot)
+{
+    ticks.setMillis(snapshot.time);
+    controlTicks = snapshot.controlTicks;
+    snapshot.control.restore(control);
+    beerProbe = snapshot.beerProbe;
+    fridgeProbe = snapshot.fridgeProbe;
+    roomProbe = snapshot.roomProbe;
+    beerSensor.copyState(snapshot.beerSensor);
+    fridgeSensor.copyState(snapshot.fridgeSensor);
+    heater.setActive(snapshot.heater);
+    cooler.setActive(snapshot.cooler);
+    light.setActive(snapshot.light);
+    fan.setActive(snapshot.fan);
+    door.setValue(snapshot.doorOpen);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TempControl.h"
+#include "TempSensor.h"
+#include "TempSensorExternal.h"
+#include "Actuator.h"
+#include "Sensor.h"
+#include "Ticks.h"
+#include "Snapshot.h"
+
+#if TEMP_CONTROL_STATIC
+#error "ChamberController needs a TempControl instance per chamber. Build with TEMP_CONTROL_STATIC 0."
+#endif
+
+class TraceRecorder;
+
+/**
+ * The state of a ChamberController between two control ticks.
+ */
+struct ControllerSnapshot
+{
+    ControllerSnapshot();
+
+    ticks_millis_t time;
+    unsigned long controlTicks;
+    TempControlState control;
+    ExternalTempSensor beerProbe;
+    ExternalTempSensor fridgeProbe;
+    ExternalTempSensor roomProbe;
+    TempSensor beerSensor;
+    TempSensor fridgeSensor;
+    bool heater;
+    bool cooler;
+    bool light;
+    bool fan;
+    bool doorOpen;
+};
+
+/**
+ * A controller for one virtual fridge: its own clock, external temperature probes, value actuators and TempControl.
+ * Controllers share no mutable state with each other or with the global tempControl, so independent controllers can
+ * be run on different threads. The eeprom, serial link and display stay with the global instance.
+ * Whatever simulates the fridge feeds the probes and reads back the outputs.
+ */
+class ChamberController
+{
+public:
+    ChamberController();
+
+    /**
+     * Gives the controller the state setup() gives the global controller, with default settings and constants.
+     */
+    void initControl();
+
+    /**
+     * Initializes the sensor filters with the current probe values.
+     */
+    void initSensors();
+
+    /**
+     * Runs the control loop once: the same steps as brewpiLoop() does every second.
+     */
+    void updateControl();
+
+    /**
+     * Sets the probe values, rounded to the 1/16 degree resolution of the real sensors.
+     */
+    void setProbeTemperatures(double beer, double fridge, double room);
+
+    /**
+     * Sets the probe values to exact fixed point temperatures.
+     */
+    void setProbeValues(temperature beer, temperature fridge, temperature room);
+
+    void setDoorOpen(bool open) { door.setValue(open); }
+
+    /**
+     * Number of times the control loop ran.
+     */
+    unsigned long getControlTicks() { return controlTicks; }
+
+    /**
+     * Saves the complete state of the controller.
+     */
+    void save(ControllerSnapshot& snapshot);
+
+    /**
+     * Continues from a saved state. The snapshot can come from another controller, which forks that controller.
+     */
+    void restore(const ControllerSnapshot& snapshot);
+
+    /**
+     * Records every control tick to the given recorder, or stops recording when NULL.
+     */
+    void setTraceRecorder(TraceRecorder* recorder) { trace = recorder; }
+
+    TempControl& getControl() { return control; }
+    ExternalTicks& getTicks() { return ticks; }
+
+protected:
+    ExternalTicks ticks;
+
+    ExternalTempSensor beerProbe;
+    ExternalTempSensor fridgeProbe;
+    ExternalTempSensor roomProbe;
+    TempSensor beerSensor;
+    TempSensor fridgeSensor;
+
+    ValueActuator heater;
+    ValueActuator cooler;
+    ValueActuator light;
+    ValueActuator fan;
+    ValueSensor<bool> door;
+
+    TempControl control;
+
+    unsigned long controlTicks;
+
+    TraceRecorder* trace;
+
+private:
+    // control points at the probes and actuators of this object, so a copy would drive those of the original
+    ChamberController(const ChamberController&);
+    ChamberController& operator=(const ChamberController&);
+};
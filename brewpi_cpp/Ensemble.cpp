@@ -0,0 +1,109 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Ensemble.h"
+
+#include <algorithm>
+#include <random>
+
+void EnsembleMember::apply(Simulator& simulator) const
+{
+    simulator.setFridgeVolume((unsigned int)lround(chamber.fridgeVolume));
+    simulator.setBeerVolume(chamber.beerVolume);
+    simulator.setBeerDensity(chamber.beerDensity);
+    simulator.setRoomCoefficient(chamber.Ke);
+    simulator.setBeerCoefficient(chamber.Kb);
+    simulator.setHeatPower((int)lround(chamber.heatPower));
+    simulator.setCoolPower((int)lround(chamber.coolPower));
+    simulator.setSensorNoise(sensorNoise);
+}
+
+static ParameterRange around(double value, double spread)
+{
+    ParameterRange range = { value*(1 - spread), value*(1 + spread) };
+    return range;
+}
+
+EnsembleRanges::EnsembleRanges(double spread)
+{
+    ChamberVariant defaults;
+    fridgeVolume = around(defaults.fridgeVolume, spread);
+    beerVolume = around(defaults.beerVolume, spread);
+    Ke = around(defaults.Ke, spread);
+    Kb = around(defaults.Kb, spread);
+    heatPower = around(defaults.heatPower, spread);
+    coolPower = around(defaults.coolPower, spread);
+    sensorNoise.low = 0;
+    sensorNoise.high = 0.1;
+}
+
+std::vector<EnsembleMember> latinHypercube(const EnsembleRanges& ranges, unsigned int count, unsigned int seed)
+{
+    std::vector<EnsembleMember> members(count);
+    if (!count)
+        return members;
+
+    struct Parameter {
+        const ParameterRange& range;
+        double EnsembleMember::* field;
+        double ChamberVariant::* chamberField;
+    };
+    const Parameter parameters[] = {
+        { ranges.fridgeVolume, NULL, &ChamberVariant::fridgeVolume },
+        { ranges.beerVolume, NULL, &ChamberVariant::beerVolume },
+        { ranges.Ke, NULL, &ChamberVariant::Ke },
+        { ranges.Kb, NULL, &ChamberVariant::Kb },
+        { ranges.heatPower, NULL, &ChamberVariant::heatPower },
+        { ranges.coolPower, NULL, &ChamberVariant::coolPower },
+        { ranges.sensorNoise, &EnsembleMember::sensorNoise, NULL }
+    };
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> within(0, 1);
+    std::vector<unsigned int> strata(count);
+    for (const Parameter& parameter : parameters) {
+        // every member gets its own stratum of this parameter, in random order
+        for (unsigned int i = 0; i < count; i++)
+            strata[i] = i;
+        std::shuffle(strata.begin(), strata.end(), random);
+        for (unsigned int i = 0; i < count; i++) {
+            double u = (strata[i] + within(random))/count;
+            double value = parameter.range.low + u*(parameter.range.high - parameter.range.low);
+            if (parameter.field)
+                members[i].*parameter.field = value;
+            else
+                members[i].chamber.*parameter.chamberField = value;
+        }
+    }
+    return members;
+}
+
+double percentile(std::vector<double> values, double percent)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    double position = percent/100*(values.size() - 1);
+    size_t below = size_t(position);
+    if (below + 1 >= values.size())
+        return values.back();
+    return values[below] + (position - below)*(values[below + 1] - values[below]);
+}
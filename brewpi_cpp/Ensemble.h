@@ -0,0 +1,79 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "ChamberBatch.h"
+
+#include <vector>
+
+/**
+ * The physical parameters of one fridge in an ensemble.
+ */
+struct EnsembleMember
+{
+    ChamberVariant chamber;
+    double sensorNoise;     // degrees
+
+    EnsembleMember() : sensorNoise(0) {}
+
+    /**
+     * Gives a simulator the parameters of this member.
+     */
+    void apply(Simulator& simulator) const;
+};
+
+/**
+ * A range sampled uniformly between low and high.
+ */
+struct ParameterRange
+{
+    double low;
+    double high;
+};
+
+/**
+ * The uncertainty of each parameter of an ensemble. The physical parameters span the Simulator defaults plus and minus
+ * the given fraction, sensor noise goes up to 0.1 degree.
+ */
+struct EnsembleRanges
+{
+    EnsembleRanges(double spread = 0.5);
+
+    ParameterRange fridgeVolume;
+    ParameterRange beerVolume;
+    ParameterRange Ke;
+    ParameterRange Kb;
+    ParameterRange heatPower;
+    ParameterRange coolPower;
+    ParameterRange sensorNoise;
+};
+
+/**
+ * Draws a Latin hypercube sample: the range of every parameter is split in count equal strata and each stratum is
+ * used by exactly one member, so even small ensembles cover every range evenly. Reproducible with the same seed.
+ */
+std::vector<EnsembleMember> latinHypercube(const EnsembleRanges& ranges, unsigned int count, unsigned int seed);
+
+/**
+ * The value below which the given percentage of the values lie, interpolated linearly between the sorted values.
+ */
+double percentile(std::vector<double> values, double percent);
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "GlycolChiller.h"
+
+#include <algorithm>
+
+GlycolChiller::GlycolChiller(double volume, double chillerPower, double setting)
+    : strategy(VALVES_ALL), maxOpenValves(0), openValves(0), peakOpenValves(0),
+    temp(setting), heatCapacity(volume*1000*VOL_HC_GLYCOL), chillerPower(chillerPower), setting(setting),
+    hysteresis(1.0), cop(2.5), roomTemp(15.0), roomConductance(2.0), chillerOn(false),
+    time(0), chillerOnTime(0), chillerEnergy(0), maxTemp(setting)
+{
+}
+
+void GlycolChiller::add(SimulatedChamber& chamber, double conductance)
+{
+    Loop loop = { &chamber, conductance, false, false, 0, 0, 0 };
+    loops.push_back(loop);
+}
+
+void GlycolChiller::setStrategy(ValveStrategy strategy, unsigned int maxOpenValves)
+{
+    this->strategy = strategy;
+    this->maxOpenValves = maxOpenValves;
+}
+
+bool GlycolChiller::before(const Loop& a, const Loop& b)
+{
+    if (strategy == VALVES_WARMEST_FIRST)
+        return a.chamber->getSimulator().getFridgeTemp() > b.chamber->getSimulator().getFridgeTemp();
+    return a.callingSince < b.callingSince;
+}
+
+void GlycolChiller::beginStep()
+{
+    // open valves stay open while their chamber calls for cooling, free valves go to the waiting chambers
+    openValves = 0;
+    waiting.clear();
+    for (unsigned int i = 0; i < loops.size(); i++) {
+        Loop& loop = loops[i];
+        bool calling = loop.chamber->getControl().stateIsCooling();
+        if (calling && !loop.calling)
+            loop.callingSince = time;
+        loop.calling = calling;
+        if (!calling)
+            loop.open = false;
+        else if (loop.open)
+            openValves++;
+        else
+            waiting.push_back(i);
+    }
+    if (strategy != VALVES_ALL) {
+        std::stable_sort(waiting.begin(), waiting.end(),
+            [this](unsigned int a, unsigned int b) { return before(loops[a], loops[b]); });
+    }
+    for (unsigned int i : waiting) {
+        Loop& loop = loops[i];
+        if (strategy == VALVES_ALL || openValves < maxOpenValves) {
+            loop.open = true;
+            openValves++;
+        }
+        else
+            loop.waitTime++;
+    }
+    peakOpenValves = std::max(peakOpenValves, openValves);
+
+    for (Loop& loop : loops) {
+        Simulator& simulator = loop.chamber->getSimulator();
+        simulator.setCoolant(temp, loop.conductance);
+        simulator.setCoolingAvailable(loop.open);
+        loop.coolHeat = simulator.getCoolHeat();
+    }
+}
+
+void GlycolChiller::endStep()
+{
+    double heat = 0;
+    for (Loop& loop : loops) {
+        heat += loop.chamber->getSimulator().getCoolHeat() - loop.coolHeat;
+    }
+
+    if (temp > setting + hysteresis/2)
+        chillerOn = true;
+    else if (temp < setting - hysteresis/2)
+        chillerOn = false;
+    if (chillerOn) {
+        heat -= chillerPower;
+        chillerOnTime++;
+        chillerEnergy += chillerPower/cop;
+    }
+    heat += roomConductance*(roomTemp - temp);
+    temp += heat/heatCapacity;
+    maxTemp = std::max(maxTemp, temp);
+    time++;
+}
+
+void GlycolChiller::step()
+{
+    beginStep();
+    for (Loop& loop : loops) {
+        loop.chamber->step();
+    }
+    endStep();
+}
+
+void GlycolChiller::run(unsigned long seconds)
+{
+    for (unsigned long i = 0; i < seconds; i++) {
+        step();
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "SimulatedChamber.h"
+
+#include <vector>
+
+/**
+ * Heat capacity of glycol coolant per unit volume, per degree: about 30% propylene glycol in water.
+ */
+#define VOL_HC_GLYCOL 3.8        // J/cm^3/K
+
+/**
+ * How the valves of the chambers share a chiller.
+ */
+enum ValveStrategy {
+    VALVES_ALL,                 // every chamber calling for cooling gets glycol
+    VALVES_FIRST_COME,          // at most maxOpenValves, the chamber waiting longest gets the next free valve
+    VALVES_WARMEST_FIRST        // at most maxOpenValves, the chamber with the warmest fridge gets the next free valve
+};
+
+/**
+ * A glycol chiller cooling several SimulatedChambers from one reservoir. A chamber calling for cooling opens its
+ * valve, and its fridge then loses conductance*(fridge-glycol) W to the glycol instead of the fixed cooler power.
+ * The heat ends up in the reservoir, which a chiller of fixed power keeps around its setting with a thermostat.
+ * The chambers step in lockstep, one second at a time. Valves follow the cooling demand of the previous second.
+ */
+class GlycolChiller
+{
+public:
+    /**
+     * @param volume        reservoir volume in liters
+     * @param chillerPower  cooling power of the chiller in W
+     * @param setting       glycol temperature the chiller keeps
+     */
+    GlycolChiller(double volume = 50, double chillerPower = 1000, double setting = -2.0);
+
+    /**
+     * Connects a chamber with a jacket or coil of the given conductance in W/K. The chamber must stay in place
+     * while connected.
+     */
+    void add(SimulatedChamber& chamber, double conductance = 5);
+
+    void setStrategy(ValveStrategy strategy, unsigned int maxOpenValves);
+
+    /**
+     * The chiller switches on above the setting plus half the hysteresis and off below the setting minus half of it.
+     */
+    void setHysteresis(double hysteresis) { this->hysteresis = hysteresis; }
+
+    /**
+     * Room around the reservoir and the conductance of its insulation in W/K.
+     */
+    void setRoom(double temp, double conductance) { roomTemp = temp; roomConductance = conductance; }
+
+    /**
+     * Coefficient of performance: heat removed per unit of electrical energy.
+     */
+    void setCop(double cop) { this->cop = cop; }
+
+    /**
+     * Runs all chambers for one second: sets the valves and the glycol of each chamber, steps them and puts the heat
+     * they returned in the reservoir.
+     */
+    void step();
+
+    void run(unsigned long seconds);
+
+    /**
+     * The two halves of step(), for callers that step the chambers themselves, for example through a Scenario.
+     */
+    void beginStep();
+    void endStep();
+
+    double getTemp() { return temp; }
+    double getMaxTemp() { return maxTemp; }
+    unsigned long getChillerOnTime() { return chillerOnTime; }
+    double getChillerEnergy() { return chillerEnergy/3600; }     // Wh of electrical energy
+
+    /**
+     * Seconds a chamber called for cooling with its valve closed.
+     */
+    unsigned long getWaitTime(unsigned int chamber) { return loops[chamber].waitTime; }
+    unsigned int getOpenValves() { return openValves; }
+    unsigned int getMaxOpenValves() { return peakOpenValves; }
+
+private:
+    struct Loop
+    {
+        SimulatedChamber* chamber;
+        double conductance;
+        bool open;
+        bool calling;
+        unsigned long callingSince;
+        unsigned long waitTime;
+        double coolHeat;        // heat removed from the chamber at the start of the step
+    };
+
+    bool before(const Loop& a, const Loop& b);
+
+    std::vector<Loop> loops;
+    std::vector<unsigned int> waiting;
+    ValveStrategy strategy;
+    unsigned int maxOpenValves;
+    unsigned int openValves;
+    unsigned int peakOpenValves;
+
+    double temp;                // C
+    double heatCapacity;        // J/K
+    double chillerPower;        // W
+    double setting;
+    double hysteresis;
+    double cop;
+    double roomTemp;
+    double roomConductance;     // W/K
+    bool chillerOn;
+    unsigned long time;
+    unsigned long chillerOnTime;
+    double chillerEnergy;       // J
+    double maxTemp;
+};
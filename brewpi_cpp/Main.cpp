@@ -22,6 +22,11 @@
 #include "Brewpi.h"
 #include "EepromAccess.h"
 #include "unistd.h"
+#include "string.h"
+#include "BatchSimulation.h"
+#include "Autotuner.h"
+#include "TraceRecorder.h"
+#include "TraceReplay.h"
 
 // setup and loop are in brewpi_config so they can be reused across projects
 extern void setup(void);
@@ -68,6 +73,28 @@ void loadEeprom(const char* source)
 
 int main(int argc, const char* argv[])
 {
+    if (argc > 1 && !strcmp(argv[1], "--batch")) {
+        return runBatch(argc-1, argv+1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "--tune")) {
+        return runTuner(argc-1, argv+1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "--ensemble")) {
+        return runEnsemble(argc-1, argv+1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "--replay")) {
+        return runReplay(argc-1, argv+1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "--compare")) {
+        return runCompare(argc-1, argv+1);
+    }
+    if (argc > 2 && !strcmp(argv[1], "--trace")) {
+        if (!traceRecorder.open(argv[2])) {
+            fprintf(stderr, "cannot open trace file %s\n", argv[2]);
+            return 1;
+        }
+    }
+
     char buf[256];
     sprintf(buf, "%s.eeprom", argv[0]);    
     loadEeprom(buf);
@@ -78,6 +105,7 @@ int main(int argc, const char* argv[])
 		loop();
                 saveEepromIfNeeded(buf);
 	}
+        traceRecorder.close();
         return 0;
 }
 
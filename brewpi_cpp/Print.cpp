@@ -114,6 +114,10 @@ int StdIO::read() {
     return c;
 }
 
+int StdIO::peek() {
+    return in.peek();
+}
+
 void StdIO::flush() { fflush(out); }
 
 
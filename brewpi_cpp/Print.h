@@ -65,6 +65,7 @@ class Stream : public Print
 		void begin(unsigned long);
 
 		int read();
+		int peek();
                 
                 size_t write(uint8_t w);
 		void flush();
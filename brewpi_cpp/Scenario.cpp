@@ -0,0 +1,251 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Scenario.h"
+#include "SimulatedChamber.h"
+#include "JsonKeys.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+
+struct ScenarioKey
+{
+    const char* key;
+    ScenarioAction action;
+};
+
+static const ScenarioKey scenarioKeys[] = {
+    { JSONKEY_mode, SCENARIO_MODE },
+    { JSONKEY_beerSetting, SCENARIO_BEER_SETTING },
+    { JSONKEY_fridgeSetting, SCENARIO_FRIDGE_SETTING },
+    { "d", SCENARIO_DOOR },
+    { "da", SCENARIO_DOOR_AIR_EXCHANGE },
+    { "bc", SCENARIO_BEER_CONNECTED },
+    { "fc", SCENARIO_FRIDGE_CONNECTED },
+    { "rmi", SCENARIO_ROOM_MIN },
+    { "rmx", SCENARIO_ROOM_MAX },
+    { "fp", SCENARIO_FERMENT_POWER },
+    { "fpl", SCENARIO_FERMENT_LAG },
+    { "fpg", SCENARIO_FERMENT_LOG },
+    { "fpa", SCENARIO_FERMENT_ACTIVE },
+    { "fps", SCENARIO_FERMENT_STATIONARY },
+    { "hl", SCENARIO_HEAT_LAG },
+    { "hl2", SCENARIO_HEAT_LAG2 },
+    { "cl", SCENARIO_COOL_LAG },
+    { "cl2", SCENARIO_COOL_LAG2 },
+    { "sm", SCENARIO_SENSOR_MODEL },
+    { "bw", SCENARIO_BEER_WELL },
+    { "fw", SCENARIO_FRIDGE_WELL },
+    { "bs", SCENARIO_BEER_STUCK },
+    { "fs", SCENARIO_FRIDGE_STUCK },
+    { "bd", SCENARIO_BEER_DROPOUT },
+    { "fd", SCENARIO_FRIDGE_DROPOUT }
+};
+
+/**
+ * Parses a time like 90, 36h or 2d5m30s into seconds.
+ */
+static bool parseTime(const char* text, unsigned long& seconds)
+{
+    double total = 0;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p || value < 0)
+            return false;
+        switch (*end) {
+            case 'd': value *= 24*3600; end++; break;
+            case 'h': value *= 3600; end++; break;
+            case 'm': value *= 60; end++; break;
+            case 's': end++; break;
+            case 0: break;
+            default: return false;
+        }
+        total += value;
+        p = end;
+    }
+    seconds = (unsigned long)(total + 0.5);
+    return p != text;
+}
+
+bool Scenario::parseLine(const char* line)
+{
+    char buf[256];
+    strncpy(buf, line, sizeof(buf)-1);
+    buf[sizeof(buf)-1] = 0;
+    char* comment = strchr(buf, '#');
+    if (comment)
+        *comment = 0;
+
+    const char* separators = " \t\r\n";
+    char* timeText = strtok(buf, separators);
+    if (!timeText)
+        return true;    // blank line
+    char* key = strtok(NULL, separators);
+    char* valueText = strtok(NULL, separators);
+    if (!key || !valueText || strtok(NULL, separators))
+        return false;
+
+    ScenarioEvent event;
+    if (!parseTime(timeText, event.time))
+        return false;
+
+    const ScenarioKey* found = NULL;
+    for (const ScenarioKey& k : scenarioKeys) {
+        if (!strcmp(k.key, key))
+            found = &k;
+    }
+    if (!found)
+        return false;
+    event.action = found->action;
+
+    if (event.action == SCENARIO_MODE) {
+        if (valueText[1] || !strchr("fbpot", valueText[0]))
+            return false;
+        event.value = valueText[0];
+    }
+    else {
+        char* end;
+        event.value = strtod(valueText, &end);
+        if (*end)
+            return false;
+    }
+    addEvent(event);
+    return true;
+}
+
+void Scenario::addEvent(const ScenarioEvent& event)
+{
+    std::vector<ScenarioEvent>::iterator pos = std::upper_bound(events.begin(), events.end(), event,
+        [](const ScenarioEvent& a, const ScenarioEvent& b) { return a.time < b.time; });
+    events.insert(pos, event);
+}
+
+unsigned int Scenario::addDoorOpenings(double openingsPerDay, double meanOpenSeconds, unsigned long begin,
+    unsigned long end, unsigned int seed)
+{
+    if (openingsPerDay <= 0)
+        return 0;
+    std::mt19937 random(seed);
+    std::exponential_distribution<double> interval(openingsPerDay/(24*3600));
+    std::exponential_distribution<double> duration(1/std::max(meanOpenSeconds, 1.0));
+    unsigned int openings = 0;
+    double time = begin;
+    for (;;) {
+        time += interval(random);
+        if (time >= end)
+            break;
+        ScenarioEvent open = { (unsigned long)time, SCENARIO_DOOR, 1 };
+        time += std::max(duration(random), 1.0);
+        ScenarioEvent close = { (unsigned long)time, SCENARIO_DOOR, 0 };
+        addEvent(open);
+        addEvent(close);
+        openings++;
+    }
+    return openings;
+}
+
+bool Scenario::load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open scenario %s\n", path);
+        return false;
+    }
+    bool valid = true;
+    char line[256];
+    for (unsigned int lineNumber = 1; fgets(line, sizeof(line), f); lineNumber++) {
+        if (!parseLine(line)) {
+            fprintf(stderr, "%s:%u: invalid event: %s", path, lineNumber, line);
+            valid = false;
+        }
+    }
+    fclose(f);
+    return valid;
+}
+
+void Scenario::apply(SimulatedChamber& chamber, const ScenarioEvent& event)
+{
+    TempControl& control = chamber.getControl();
+    Simulator& simulator = chamber.getSimulator();
+    switch (event.action) {
+        case SCENARIO_MODE: control.setMode(char(event.value)); break;
+        case SCENARIO_BEER_SETTING: control.setBeerTemp(doubleToTemp(event.value)); break;
+        case SCENARIO_FRIDGE_SETTING: control.setFridgeTemp(doubleToTemp(event.value)); break;
+        case SCENARIO_DOOR: chamber.setDoorOpen(event.value != 0); break;
+        case SCENARIO_DOOR_AIR_EXCHANGE: simulator.setDoorAirExchange(event.value); break;
+        case SCENARIO_BEER_CONNECTED: simulator.setConnected(control.beerSensor, event.value != 0); break;
+        case SCENARIO_FRIDGE_CONNECTED: simulator.setConnected(control.fridgeSensor, event.value != 0); break;
+        case SCENARIO_ROOM_MIN: simulator.setMinRoomTemp(event.value); break;
+        case SCENARIO_ROOM_MAX: simulator.setMaxRoomTemp(event.value); break;
+        case SCENARIO_FERMENT_POWER: simulator.setFermentMaxPowerOutput(event.value); break;
+        case SCENARIO_FERMENT_LAG:
+        case SCENARIO_FERMENT_LOG:
+        case SCENARIO_FERMENT_ACTIVE:
+        case SCENARIO_FERMENT_STATIONARY: {
+            FermentPhases phases = simulator.getFermentPhases();
+            if (event.action == SCENARIO_FERMENT_LAG)
+                phases.lagPhase = event.value;
+            else if (event.action == SCENARIO_FERMENT_LOG)
+                phases.logPhase = event.value;
+            else if (event.action == SCENARIO_FERMENT_ACTIVE)
+                phases.activePhase = event.value;
+            else
+                phases.stationaryPhase = event.value;
+            simulator.setFermentPhases(phases);
+            break;
+        }
+        case SCENARIO_HEAT_LAG: simulator.getHeaterLag().tau1 = event.value; break;
+        case SCENARIO_HEAT_LAG2: simulator.getHeaterLag().tau2 = event.value; break;
+        case SCENARIO_COOL_LAG: simulator.getCoolerLag().tau1 = event.value; break;
+        case SCENARIO_COOL_LAG2: simulator.getCoolerLag().tau2 = event.value; break;
+        case SCENARIO_SENSOR_MODEL: simulator.setSensorModel(event.value != 0); break;
+        case SCENARIO_BEER_WELL: simulator.getBeerProbe().wellLag = event.value; break;
+        case SCENARIO_FRIDGE_WELL: simulator.getFridgeProbe().wellLag = event.value; break;
+        case SCENARIO_BEER_STUCK: simulator.getBeerProbe().stuck = event.value != 0; break;
+        case SCENARIO_FRIDGE_STUCK: simulator.getFridgeProbe().stuck = event.value != 0; break;
+        case SCENARIO_BEER_DROPOUT: simulator.getBeerProbe().dropoutRate = event.value; break;
+        case SCENARIO_FRIDGE_DROPOUT: simulator.getFridgeProbe().dropoutRate = event.value; break;
+    }
+}
+
+void Scenario::run(SimulatedChamber& chamber, unsigned long begin, unsigned long end, bool eventStepping) const
+{
+    std::vector<ScenarioEvent>::const_iterator next = std::lower_bound(events.begin(), events.end(), begin,
+        [](const ScenarioEvent& event, unsigned long time) { return event.time < time; });
+
+    unsigned long time = begin;
+    while (time < end) {
+        for (; next != events.end() && next->time <= time; ++next)
+            apply(chamber, *next);
+        unsigned long until = next != events.end() ? std::min(next->time, end) : end;
+        if (eventStepping)
+            time += chamber.advance(until - time);
+        else {
+            chamber.step();
+            time++;
+        }
+    }
+}
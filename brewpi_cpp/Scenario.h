@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+class SimulatedChamber;
+
+enum ScenarioAction {
+    SCENARIO_MODE,              // mode: the control mode, as in the j command
+    SCENARIO_BEER_SETTING,      // beerSet
+    SCENARIO_FRIDGE_SETTING,    // fridgeSet
+    SCENARIO_DOOR,              // d: 1 opens the door, 0 closes it
+    SCENARIO_DOOR_AIR_EXCHANGE, // da: fridge volumes of air replaced per minute while the door is open
+    SCENARIO_BEER_CONNECTED,    // bc: 0 disconnects the beer sensor
+    SCENARIO_FRIDGE_CONNECTED,  // fc: 0 disconnects the fridge sensor
+    SCENARIO_ROOM_MIN,          // rmi: lowest daily room temperature
+    SCENARIO_ROOM_MAX,          // rmx: highest daily room temperature
+    SCENARIO_FERMENT_POWER,     // fp: maximum fermentation power in watts
+    SCENARIO_FERMENT_LAG,       // fpl, fpg, fpa, fps: lag, log, active and stationary fermentation phases in hours
+    SCENARIO_FERMENT_LOG,
+    SCENARIO_FERMENT_ACTIVE,
+    SCENARIO_FERMENT_STATIONARY,
+    SCENARIO_HEAT_LAG,          // hl, hl2: time constants of the heater lag stages in seconds
+    SCENARIO_HEAT_LAG2,
+    SCENARIO_COOL_LAG,          // cl, cl2: time constants of the cooler lag stages in seconds
+    SCENARIO_COOL_LAG2,
+    SCENARIO_SENSOR_MODEL,      // sm: 1 reads the beer and fridge sensors through the DS18B20 probe model
+    SCENARIO_BEER_WELL,         // bw, fw: time constants of the beer and fridge thermowells in seconds
+    SCENARIO_FRIDGE_WELL,
+    SCENARIO_BEER_STUCK,        // bs, fs: 1 makes the beer or fridge probe stuck at its reading, 0 frees it
+    SCENARIO_FRIDGE_STUCK,
+    SCENARIO_BEER_DROPOUT,      // bd, fd: probability that a read of the beer or fridge probe fails
+    SCENARIO_FRIDGE_DROPOUT
+};
+
+struct ScenarioEvent
+{
+    unsigned long time;         // simulated seconds since the start of the run
+    ScenarioAction action;
+    double value;               // the mode character for SCENARIO_MODE
+};
+
+/**
+ * A list of events applied to a simulated chamber at fixed simulated times, so a scenario runs at full speed without
+ * an external driver. Scenario files have one event per line: a time, a key and a value. The keys are those of the
+ * j command for settings and of the y simulator command for the rest:
+ *
+ *   # time  key        value
+ *   0       mode       b
+ *   0       beerSet    20
+ *   36h     beerSet    18
+ *   2d      d          1      # door open for 5 minutes
+ *   2d5m    d          0
+ *   3d      bc         0      # beer sensor lost
+ *   3.5d    rmi        25     # warm spell
+ *   3.5d    rmx        28
+ *   4d      fp         15
+ *   5d      bs         1      # beer probe stuck
+ *
+ * Times are in seconds, or a sequence of numbers with d, h, m or s units. Anything after # is a comment.
+ */
+class Scenario
+{
+public:
+    /**
+     * Reads a scenario file. Errors are reported on stderr with their line number.
+     * @return false when the file cannot be read or has errors.
+     */
+    bool load(const char* path);
+
+    /**
+     * Parses one line of a scenario file and adds its event.
+     * @return false when the line is not a valid event or comment.
+     */
+    bool parseLine(const char* line);
+
+    void addEvent(const ScenarioEvent& event);
+
+    /**
+     * Adds door openings between begin and end as a Poisson process, openingsPerDay on average. Each opening lasts an
+     * exponentially distributed time with the given mean, at least a second, and the next one can only start after the
+     * door closed. The same seed gives the same openings.
+     * @return the number of openings added.
+     */
+    unsigned int addDoorOpenings(double openingsPerDay, double meanOpenSeconds, unsigned long begin, unsigned long end,
+        unsigned int seed);
+
+    /**
+     * Runs a chamber from begin until end, in simulated seconds since the start of the scenario.
+     * Events before begin are taken to be applied already. With next-event stepping the steps end at the events.
+     */
+    void run(SimulatedChamber& chamber, unsigned long begin, unsigned long end, bool events = false) const;
+
+    /**
+     * Applies one event to a chamber.
+     */
+    static void apply(SimulatedChamber& chamber, const ScenarioEvent& event);
+
+    const std::vector<ScenarioEvent>& getEvents() const { return events; }
+
+private:
+    std::vector<ScenarioEvent> events;    // ordered by time, events at the same time in file order
+};
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SimulatedChamber.h"
+
+#include <limits.h>
+#include <math.h>
+
+SimulatedChamber::SimulatedChamber()
+    : maxEventStep(300)
+{
+    simulator.setTempControl(&control);
+}
+
+void SimulatedChamber::init()
+{
+    initControl();
+    // the controller meters energy with the power of the simulated outputs
+    control.cc.heaterPower = simulator.getHeatPower();
+    control.cc.coolerPower = simulator.getCoolPower();
+    simulator.step();
+    initSensors();
+}
+
+void SimulatedChamber::save(ChamberSnapshot& snapshot)
+{
+    ChamberController::save(snapshot);
+    snapshot.simulator = simulator;
+}
+
+void SimulatedChamber::restore(const ChamberSnapshot& snapshot)
+{
+    ChamberController::restore(snapshot);
+    simulator = snapshot.simulator;
+    simulator.setTempControl(&control);
+}
+
+void SimulatedChamber::step()
+{
+    uint16_t tick = control.getTickTime();
+    updateControl();
+    simulator.stepMillis(tick);
+    ticks.incMillis(tick);
+}
+
+void SimulatedChamber::run(unsigned long seconds)
+{
+    unsigned long steps = seconds*1000/control.getTickTime();
+    while (steps--) {
+        step();
+    }
+}
+
+void SimulatedChamber::runEvents(unsigned long seconds)
+{
+    while (seconds) {
+        seconds -= advance(seconds);
+    }
+}
+
+unsigned long SimulatedChamber::advance(unsigned long maxSeconds)
+{
+    if (control.getTickTime() != 1000) {
+        run(1);
+        return 1;
+    }
+    double beerBefore = simulator.getBeerTemp();
+    double fridgeBefore = simulator.getFridgeTemp();
+    step();
+    if (maxSeconds <= 1) {
+        return 1;
+    }
+    double beerRate = simulator.getBeerTemp() - beerBefore;
+    double fridgeRate = simulator.getFridgeTemp() - fridgeBefore;
+
+    // skip a multiple of the slope period, so the slope filter stays in phase
+    unsigned long skip = min(quietTime(beerRate, fridgeRate), maxSeconds-1);
+    skip -= skip % beerSensor.samplesPerSlope;
+    if (!skip) {
+        return 1;
+    }
+
+    // the model is at the sample of the last control tick + 1, run it to the last skipped sample
+    if (skip > 1) {
+        simulator.step(skip-1);
+    }
+    shiftFilters(beerSensor, simulator.getBeerTemp() - beerBefore);
+    shiftFilters(fridgeSensor, simulator.getFridgeTemp() - fridgeBefore);
+    simulator.step();
+    ticks.incMillis(skip*1000);
+    if (control.modeIsBeer()) {
+        control.integralUpdateCounter += skip;
+    }
+#if BREWPI_CONTROL_KPI
+    // the outputs and the state hold over the skipped ticks
+    control.kpi.repeat(skip);
+#endif
+    return skip + 1;
+}
+
+// Seconds until value, moving at rate degrees per second, crosses threshold. Halved, because the rate is not constant.
+static unsigned long timeToCross(long value, long threshold, double rate)
+{
+    double seconds = (threshold - value)/(rate*TEMP_FIXED_POINT_SCALE);
+    if (!(seconds >= 0) || seconds >= 2.0*ULONG_MAX) {
+        return ULONG_MAX;   // moving away or not moving at all
+    }
+    return (unsigned long)(seconds/2);
+}
+
+unsigned long SimulatedChamber::quietTime(double beerRate, double fridgeRate)
+{
+    uint8_t state = control.getState();
+    if (control.doPosPeakDetect || control.doNegPeakDetect || control.doorOpen
+        || (state != IDLE && state != STATE_OFF && state != WAITING_TO_COOL && state != WAITING_TO_HEAT)) {
+        return 0;
+    }
+    // slope filter startup and sensor errors are handled by normal steps
+    if (beerSensor.updateCounter > beerSensor.samplesPerSlope || fridgeSensor.updateCounter > fridgeSensor.samplesPerSlope
+        || beerSensor.failedReadCount || fridgeSensor.failedReadCount) {
+        return 0;
+    }
+
+    unsigned long quiet = maxEventStep;
+    if (state == WAITING_TO_COOL || state == WAITING_TO_HEAT) {
+        uint16_t waitTime = control.getWaitTime();
+        quiet = min(quiet, (unsigned long)(waitTime ? waitTime - 1 : 0));
+    }
+
+    ControlSettings& cs = control.cs;
+    ControlConstants& cc = control.cc;
+    if (cs.mode == MODE_OFF || cs.mode == MODE_TEST || cs.fridgeSetting == INVALID_TEMP) {
+        return quiet;
+    }
+    if (control.modeIsBeer()) {
+        quiet = min(quiet, (unsigned long)(control.integralTicks - control.integralUpdateCounter));
+
+        long beer = beerSensor.readFastFiltered();
+        quiet = min(quiet, timeToCross(beer, cs.beerSetting + 16, beerRate));
+        quiet = min(quiet, timeToCross(beer, cs.beerSetting - 16, beerRate));
+
+        // the fridge setting moves against the beer temperature through the proportional part
+        fridgeRate += beerRate*cc.Kp/TEMP_FIXED_POINT_SCALE;
+    }
+    long fridgeError = fridgeSensor.readFastFiltered() - cs.fridgeSetting;
+    quiet = min(quiet, timeToCross(fridgeError, cc.idleRangeHigh, fridgeRate));
+    quiet = min(quiet, timeToCross(fridgeError, cc.idleRangeLow, fridgeRate));
+    return quiet;
+}
+
+void SimulatedChamber::shiftFilters(TempSensor& sensor, double offset)
+{
+    temperature_precise preciseOffset = temperature_precise(offset*TEMP_FIXED_POINT_SCALE*(1L<<TEMP_PRECISE_EXTRA_FRACTION_BITS));
+    sensor.fastFilter.shift(preciseOffset);
+    sensor.slowFilter.shift(preciseOffset);
+    sensor.prevOutputForSlope += preciseOffset;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ChamberController.h"
+#include "Simulator.h"
+
+/**
+ * The state of a SimulatedChamber: its controller and its thermal model.
+ */
+struct ChamberSnapshot : public ControllerSnapshot
+{
+    Simulator simulator;
+};
+
+/**
+ * A complete simulated fridge: a ChamberController driving its own thermal model.
+ * The sensor noise and probe dropouts of the simulator use a generator per simulator, seeded with setRandomSeed(), so
+ * chambers can run in parallel.
+ */
+class SimulatedChamber : public ChamberController
+{
+public:
+    SimulatedChamber();
+
+    /**
+     * Brings the chamber to the same state setup() gives the global controller, with default settings and constants.
+     * The heater and cooler power constants are those of the simulator, so the metered energy can be compared.
+     * Set the simulator parameters before calling this, the initial temperatures seed the sensor filters.
+     */
+    void init();
+
+    /**
+     * Runs the control loop once and advances the model and the clock by one control tick, a second by default.
+     */
+    void step();
+
+    /**
+     * Sets the control tick, see TempControl::setTickTime. Use a divisor of 1000, so that run() and advance() can
+     * count whole seconds.
+     */
+    void setTickTime(uint16_t millis) { control.setTickTime(millis); }
+
+    /**
+     * Runs the given number of simulated seconds.
+     */
+    void run(unsigned long seconds);
+
+    /**
+     * Next-event stepping. Runs the control loop once, then skips the control ticks in which nothing can change:
+     * the outputs are off, no peak detection is pending and the wait time, the next integrator update and the
+     * predicted threshold crossings are all further away. The model jumps over the skipped time in one exact step, and
+     * the sensor filters are moved as if the temperature had followed a ramp.
+     * This is an approximation: filter states are not bit-identical to fixed stepping.
+     * With a tick shorter than a second nothing is skipped, it runs the ticks of one second.
+     * @return the number of simulated seconds advanced, at least 1 and at most maxSeconds.
+     */
+    unsigned long advance(unsigned long maxSeconds);
+
+    /**
+     * Runs the given number of simulated seconds with next-event stepping.
+     */
+    void runEvents(unsigned long seconds);
+
+    /**
+     * Sets the longest time skipped at once with next-event stepping.
+     */
+    void setMaxEventStep(unsigned long seconds) { maxEventStep = seconds; }
+
+    /**
+     * Saves the controller and the model. A long shared history can be simulated once, saved, and restored into any
+     * number of chambers that each continue differently.
+     */
+    void save(ChamberSnapshot& snapshot);
+    void restore(const ChamberSnapshot& snapshot);
+
+    Simulator& getSimulator() { return simulator; }
+
+private:
+    // the simulator points at the controller of this object
+    SimulatedChamber(const SimulatedChamber&);
+    SimulatedChamber& operator=(const SimulatedChamber&);
+
+    unsigned long quietTime(double beerRate, double fridgeRate);
+    static void shiftFilters(TempSensor& sensor, double offset);
+
+    Simulator simulator;
+
+    unsigned long maxEventStep;
+};
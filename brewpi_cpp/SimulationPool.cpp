@@ -0,0 +1,53 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SimulationPool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+SimulationPool::SimulationPool(unsigned int threads)
+{
+    if (!threads) {
+        threads = std::thread::hardware_concurrency();
+    }
+    this->threads = threads ? threads : 1;
+}
+
+void SimulationPool::run(unsigned int count, const Job& job)
+{
+    std::atomic<unsigned int> next(0);
+    auto worker = [&]() {
+        for (unsigned int i; (i = next++) < count; ) {
+            job(i);
+        }
+    };
+
+    unsigned int workers = threads < count ? threads : count;
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < workers; t++) {
+        pool.push_back(std::thread(worker));
+    }
+    worker();   // the calling thread does its share
+    for (auto& t : pool) {
+        t.join();
+    }
+}
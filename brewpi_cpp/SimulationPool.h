@@ -0,0 +1,49 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+
+/**
+ * Runs a number of independent jobs on a fixed set of worker threads.
+ * Jobs are handed out one at a time, so long and short simulations balance out over the workers.
+ * Each job gets its index and must only touch state owned by that index, e.g. its own SimulatedChamber.
+ */
+class SimulationPool
+{
+public:
+    typedef std::function<void(unsigned int index)> Job;
+
+    /**
+     * @param threads number of worker threads. 0 uses one per hardware thread.
+     */
+    SimulationPool(unsigned int threads = 0);
+
+    /**
+     * Runs job(0) .. job(count-1) and returns when all are done.
+     */
+    void run(unsigned int count, const Job& job);
+
+    unsigned int getThreadCount() { return threads; }
+
+private:
+    unsigned int threads;
+};
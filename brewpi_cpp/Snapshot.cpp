@@ -0,0 +1,83 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Snapshot.h"
+#include "EepromAccess.h"
+#include "DeviceManager.h"
+
+SimulationSnapshot::SimulationSnapshot()
+    : beerSensor(TEMP_SENSOR_TYPE_BEER), fridgeSensor(TEMP_SENSOR_TYPE_FRIDGE),
+    beerProbe(false), fridgeProbe(false), roomProbe(false),
+    heater(false), cooler(false), light(false), fan(false), time(0)
+{
+}
+
+// In the simulator all installed temperature sensors are external sensors, the others are the default sensor.
+static bool isExternal(BasicTempSensor& sensor)
+{
+    return !deviceManager.isDefaultTempSensor(&sensor);
+}
+
+static void saveProbe(BasicTempSensor& sensor, ExternalTempSensor& probe)
+{
+    if (isExternal(sensor))
+        probe = (ExternalTempSensor&)sensor;
+}
+
+static void restoreProbe(BasicTempSensor& sensor, const ExternalTempSensor& probe)
+{
+    if (isExternal(sensor))
+        (ExternalTempSensor&)sensor = probe;
+}
+
+void SimulationSnapshot::save()
+{
+    control.save(tempControl);
+    beerSensor.copyState(*tempControl.beerSensor);
+    fridgeSensor.copyState(*tempControl.fridgeSensor);
+    saveProbe(tempControl.beerSensor->sensor(), beerProbe);
+    saveProbe(tempControl.fridgeSensor->sensor(), fridgeProbe);
+    saveProbe(*tempControl.ambientSensor, roomProbe);
+    heater = tempControl.heater->isActive();
+    cooler = tempControl.cooler->isActive();
+    light = tempControl.light->isActive();
+    fan = tempControl.fan->isActive();
+    simulator = ::simulator;
+    time = ticks.millis();
+    eepromAccess.readBlock(eeprom, 0, sizeof(eeprom));
+}
+
+void SimulationSnapshot::restore() const
+{
+    control.restore(tempControl);
+    tempControl.beerSensor->copyState(beerSensor);
+    tempControl.fridgeSensor->copyState(fridgeSensor);
+    restoreProbe(tempControl.beerSensor->sensor(), beerProbe);
+    restoreProbe(tempControl.fridgeSensor->sensor(), fridgeProbe);
+    restoreProbe(*tempControl.ambientSensor, roomProbe);
+    tempControl.heater->setActive(heater);
+    tempControl.cooler->setActive(cooler);
+    tempControl.light->setActive(light);
+    tempControl.fan->setActive(fan);
+    ::simulator = simulator;
+    ticks.setMillis(time);
+    eepromAccess.writeBlock(0, eeprom, sizeof(eeprom));
+}
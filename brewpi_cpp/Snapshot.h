@@ -0,0 +1,61 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TempControl.h"
+#include "ChamberManager.h"
+#include "EepromFormat.h"
+#include "TempSensor.h"
+#include "TempSensorExternal.h"
+#include "Simulator.h"
+#include "Ticks.h"
+
+/**
+ * The complete state of the global simulation: tempControl, its sensor filters, probe values and actuators, the
+ * simulator, the clock and the emulated eeprom. Restoring it continues the simulation from the moment it was saved,
+ * apart from the serial link and display. Only the chamber in tempControl is saved, not those waiting in the
+ * ChamberManager.
+ */
+class SimulationSnapshot
+{
+public:
+    SimulationSnapshot();
+
+    void save();
+    void restore() const;
+
+private:
+    TempControlState control;
+    TempSensor beerSensor;
+    TempSensor fridgeSensor;
+    ExternalTempSensor beerProbe;
+    ExternalTempSensor fridgeProbe;
+    ExternalTempSensor roomProbe;
+    bool heater;
+    bool cooler;
+    bool light;
+    bool fan;
+    Simulator simulator;
+    ticks_millis_t time;
+    uint8_t eeprom[EepromFormat::MAX_EEPROM_SIZE];
+};
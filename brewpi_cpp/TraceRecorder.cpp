@@ -0,0 +1,200 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "TraceRecorder.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+TraceRecorder traceRecorder;
+
+static void makeHeader(TraceHeader& header)
+{
+    memcpy(header.magic, "BPTR", 4);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+}
+
+static bool validHeader(const TraceHeader& header)
+{
+    TraceHeader expected;
+    makeHeader(expected);
+    return !memcmp(&header, &expected, sizeof(header));
+}
+
+TraceRecorder::TraceRecorder()
+    : file(NULL), buffered(0)
+{
+}
+
+bool TraceRecorder::open(const char* path)
+{
+    close();
+    TraceHeader header;
+    file = fopen(path, "rb+");
+    if (!file) {
+        if (errno != ENOENT)
+            return false;
+        file = fopen(path, "wb+");
+        if (!file)
+            return false;
+        makeHeader(header);
+        fwrite(&header, sizeof(header), 1, file);
+        return true;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 || !validHeader(header)) {
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    // Continue after the last whole record. A run killed while writing leaves part of a record, which would misalign
+    // every record appended after it, so the next record overwrites it.
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    long partial = (length - sizeof(header)) % sizeof(TraceRecord);
+    fseek(file, length - partial, SEEK_SET);
+    return true;
+}
+
+void TraceRecorder::close()
+{
+    if (file) {
+        flush();
+        fclose(file);
+        file = NULL;
+    }
+}
+
+void TraceRecorder::flush()
+{
+    if (file && buffered) {
+        fwrite(buffer, sizeof(TraceRecord), buffered, file);
+        fflush(file);
+        buffered = 0;
+    }
+}
+
+void TraceRecorder::record(TempControl& control, uint32_t time)
+{
+    if (!file)
+        return;
+    capture(control, time, buffer[buffered]);
+    if (++buffered == bufferSize)
+        flush();
+}
+
+void TraceRecorder::capture(TempControl& control, uint32_t time, TraceRecord& record)
+{
+    record.time = time;
+    record.beerRaw = control.beerSensor->readRaw();
+    record.fridgeRaw = control.fridgeSensor->readRaw();
+    record.roomRaw = control.getRoomTemp();
+    record.beerFast = control.beerSensor->readFastFiltered();
+    record.beerSlow = control.beerSensor->readSlowFiltered();
+    record.fridgeFast = control.fridgeSensor->readFastFiltered();
+    record.fridgeSlow = control.fridgeSensor->readSlowFiltered();
+
+    record.mode = control.cs.mode;
+    record.beerSetting = control.cs.beerSetting;
+    record.fridgeSetting = control.cs.fridgeSetting;
+    record.heatEstimator = control.cs.heatEstimator;
+    record.coolEstimator = control.cs.coolEstimator;
+
+    record.beerDiff = control.cv.beerDiff;
+    record.diffIntegral = control.cv.diffIntegral;
+    record.beerSlope = control.cv.beerSlope;
+    record.p = control.cv.p;
+    record.i = control.cv.i;
+    record.d = control.cv.d;
+    record.estimatedPeak = control.cv.estimatedPeak;
+    record.negPeakEstimate = control.cv.negPeakEstimate;
+    record.posPeakEstimate = control.cv.posPeakEstimate;
+    record.negPeak = control.cv.negPeak;
+    record.posPeak = control.cv.posPeak;
+
+    record.state = control.getState();
+    record.outputs = (control.heater->isActive() ? TRACE_HEATER : 0)
+        | (control.cooler->isActive() ? TRACE_COOLER : 0)
+        | (control.light->isActive() ? TRACE_LIGHT : 0)
+        | (control.fan->isActive() ? TRACE_FAN : 0)
+        | (control.isDoorOpen() ? TRACE_DOOR_OPEN : 0);
+}
+
+TraceReader::TraceReader()
+    : data(NULL), length(0), records(NULL), count(0)
+{
+}
+
+bool TraceReader::open(const char* path)
+{
+    close();
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+#ifdef _WIN32
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* buf = malloc(length ? length : 1);
+    if (fread(buf, 1, length, f) != length) {
+        free(buf);
+        buf = NULL;
+    }
+    data = buf;
+#else
+    struct stat st;
+    if (!fstat(fileno(f), &st) && st.st_size > 0) {
+        length = st.st_size;
+        void* map = mmap(NULL, length, PROT_READ, MAP_SHARED, fileno(f), 0);
+        data = map == MAP_FAILED ? NULL : map;
+    }
+#endif
+    fclose(f);
+    if (!data || length < sizeof(TraceHeader) || !validHeader(*(const TraceHeader*)data)) {
+        close();
+        return false;
+    }
+    records = (const TraceRecord*)((const char*)data + sizeof(TraceHeader));
+    count = (length - sizeof(TraceHeader)) / sizeof(TraceRecord);    // a partly written last record is left out
+    return true;
+}
+
+void TraceReader::close()
+{
+    if (data) {
+#ifdef _WIN32
+        free((void*)data);
+#else
+        munmap((void*)data, length);
+#endif
+    }
+    data = NULL;
+    length = 0;
+    records = NULL;
+    count = 0;
+}
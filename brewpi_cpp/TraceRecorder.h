@@ -0,0 +1,175 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TempControl.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum TraceOutputs {
+    TRACE_HEATER = 1<<0,
+    TRACE_COOLER = 1<<1,
+    TRACE_LIGHT = 1<<2,
+    TRACE_FAN = 1<<3,
+    TRACE_DOOR_OPEN = 1<<4
+};
+
+#pragma pack(push, 1)
+
+/**
+ * Starts every trace file. The records follow directly, so a file can be mapped and indexed as an array of records.
+ */
+struct TraceHeader
+{
+    char magic[4];          // "BPTR"
+    uint16_t version;
+    uint16_t recordSize;
+};
+
+/**
+ * The state of one controller after one control tick. All temperatures are the raw fixed point values, with the
+ * sensor values in the internal Celsius format. Fields are little endian, as written by the host.
+ */
+struct TraceRecord
+{
+    uint32_t time;                  // ticks.millis() at the control tick
+    // unfiltered sensor values
+    temperature beerRaw;
+    temperature fridgeRaw;
+    temperature roomRaw;
+    // filtered sensor values
+    temperature beerFast;
+    temperature beerSlow;
+    temperature fridgeFast;
+    temperature fridgeSlow;
+    // ControlSettings
+    char mode;
+    temperature beerSetting;
+    temperature fridgeSetting;
+    temperature heatEstimator;
+    temperature coolEstimator;
+    // ControlVariables
+    temperature beerDiff;
+    int32_t diffIntegral;
+    temperature beerSlope;
+    temperature p;
+    temperature i;
+    temperature d;
+    temperature estimatedPeak;
+    temperature negPeakEstimate;
+    temperature posPeakEstimate;
+    temperature negPeak;
+    temperature posPeak;
+    uint8_t state;
+    uint8_t outputs;                // TraceOutputs flags
+};
+
+#pragma pack(pop)
+
+const uint16_t TRACE_VERSION = 1;
+
+/**
+ * Writes a record for every control tick to an append-only trace file, at 53 bytes per tick.
+ * Records are collected in memory and written in blocks. Appending to an existing trace continues it, provided the
+ * record layout matches.
+ */
+class TraceRecorder
+{
+public:
+    TraceRecorder();
+    ~TraceRecorder() { close(); }
+
+    /**
+     * Opens the trace file for appending, creating it when it does not exist. A partial record at the end, left by a
+     * run that was killed while writing, is overwritten by the next record.
+     * @return false when the file cannot be opened or holds a different record layout.
+     */
+    bool open(const char* path);
+
+    /**
+     * Writes the buffered records and closes the file.
+     */
+    void close();
+
+    bool isOpen() { return file != NULL; }
+
+    /**
+     * Records the state of the controller. Does nothing when no file is open.
+     */
+    void record(TempControl& control, uint32_t time);
+
+    /**
+     * Writes the buffered records to the file.
+     */
+    void flush();
+
+    /**
+     * Fills a record with the state of the controller.
+     */
+    static void capture(TempControl& control, uint32_t time, TraceRecord& record);
+
+private:
+    TraceRecorder(const TraceRecorder&);
+    TraceRecorder& operator=(const TraceRecorder&);
+
+    static const unsigned int bufferSize = 1024;
+
+    FILE* file;
+    unsigned int buffered;
+    TraceRecord buffer[bufferSize];
+};
+
+/**
+ * Gives read access to a trace file by mapping it into memory, so even multi-week traces load instantly.
+ */
+class TraceReader
+{
+public:
+    TraceReader();
+    ~TraceReader() { close(); }
+
+    /**
+     * @return false when the file cannot be read or is not a trace with the current record layout.
+     */
+    bool open(const char* path);
+    void close();
+
+    size_t size() { return count; }
+    const TraceRecord& operator[](size_t index) { return records[index]; }
+
+private:
+    TraceReader(const TraceReader&);
+    TraceReader& operator=(const TraceReader&);
+
+    const void* data;
+    size_t length;
+    const TraceRecord* records;
+    size_t count;
+};
+
+/**
+ * Records the global controller, opened with the --trace option.
+ */
+extern TraceRecorder traceRecorder;
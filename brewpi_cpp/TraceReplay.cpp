@@ -0,0 +1,168 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "TraceReplay.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+void TraceReplay::start(const TraceRecord& first)
+{
+    initControl();
+    ticks.setMillis(first.time);
+    setProbeValues(first.beerRaw, first.fridgeRaw, first.roomRaw);
+    setDoorOpen((first.outputs & TRACE_DOOR_OPEN) != 0);
+    initSensors();
+    control.cs.heatEstimator = first.heatEstimator;
+    control.cs.coolEstimator = first.coolEstimator;
+    applySettings(first);
+}
+
+void TraceReplay::applySettings(const TraceRecord& record)
+{
+    if (record.mode != control.cs.mode)
+        control.setMode(record.mode);
+    // in beer modes the fridge setting is an output of the controller
+    if (record.mode == MODE_FRIDGE_CONSTANT) {
+        if (record.fridgeSetting != control.cs.fridgeSetting)
+            control.setFridgeTemp(record.fridgeSetting);
+    }
+    else if (record.beerSetting != control.cs.beerSetting) {
+        control.setBeerTemp(record.beerSetting);
+    }
+}
+
+void TraceReplay::replay(const TraceRecord& input)
+{
+    ticks.setMillis(input.time);
+    setProbeValues(input.beerRaw, input.fridgeRaw, input.roomRaw);
+    setDoorOpen((input.outputs & TRACE_DOOR_OPEN) != 0);
+    applySettings(input);
+    updateControl();
+}
+
+unsigned long TraceReplay::run(TraceReader& trace, TraceRecorder* output, FILE* log, unsigned long maxLogged)
+{
+    if (!trace.size())
+        return 0;
+    start(trace[0]);
+    setTraceRecorder(output);
+
+    unsigned long differences = 0;
+    TraceRecord decision;
+    for (size_t i = 0; i < trace.size(); i++) {
+        replay(trace[i]);
+        TraceRecorder::capture(control, trace[i].time, decision);
+        if (!sameDecision(trace[i], decision)) {
+            if (log && differences < maxLogged) {
+                fprintf(log, "%10lu s recorded ", (unsigned long)(trace[i].time/1000));
+                printDecision(log, trace[i]);
+                fprintf(log, " replayed ");
+                printDecision(log, decision);
+                fputc('\n', log);
+            }
+            differences++;
+        }
+    }
+    setTraceRecorder(NULL);
+    return differences;
+}
+
+void TraceReplay::printDecision(FILE* out, const TraceRecord& record)
+{
+    fprintf(out, "state %2d %c%c%c%c", record.state,
+        record.outputs & TRACE_HEATER ? 'H' : '-',
+        record.outputs & TRACE_COOLER ? 'C' : '-',
+        record.outputs & TRACE_LIGHT ? 'L' : '-',
+        record.outputs & TRACE_FAN ? 'F' : '-');
+}
+
+int runReplay(int argc, const char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: --replay <trace> [-o <output trace>] [-n <max reported ticks>]\n");
+        return 1;
+    }
+    const char* outputPath = NULL;
+    unsigned long maxReported = 20;
+    for (int i = 2; i+1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-o"))
+            outputPath = argv[i+1];
+        else if (!strcmp(argv[i], "-n"))
+            maxReported = strtoul(argv[i+1], NULL, 10);
+        else {
+            fprintf(stderr, "unknown replay option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    TraceReader trace;
+    if (!trace.open(argv[1])) {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+    TraceRecorder output;
+    if (outputPath) {
+        remove(outputPath);
+        if (!output.open(outputPath)) {
+            fprintf(stderr, "cannot open trace file %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    TraceReplay replay;
+    unsigned long differences = replay.run(trace, outputPath ? &output : NULL, stdout, maxReported);
+    printf("replayed %lu ticks, %lu with a different decision\n", (unsigned long)trace.size(), differences);
+    return differences ? 2 : 0;
+}
+
+int runCompare(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: --compare <trace> <trace> [-n <max reported ticks>]\n");
+        return 1;
+    }
+    unsigned long maxReported = argc > 4 && !strcmp(argv[3], "-n") ? strtoul(argv[4], NULL, 10) : 20;
+
+    TraceReader a, b;
+    if (!a.open(argv[1]) || !b.open(argv[2])) {
+        fprintf(stderr, "cannot read traces %s and %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    size_t count = std::min(a.size(), b.size());
+    unsigned long differences = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (TraceReplay::sameDecision(a[i], b[i]))
+            continue;
+        if (differences++ < maxReported) {
+            printf("%10lu s ", (unsigned long)(a[i].time/1000));
+            TraceReplay::printDecision(stdout, a[i]);
+            printf(" | ");
+            TraceReplay::printDecision(stdout, b[i]);
+            printf("\n");
+        }
+    }
+    if (a.size() != b.size())
+        printf("traces differ in length: %lu and %lu ticks\n", (unsigned long)a.size(), (unsigned long)b.size());
+    printf("compared %lu ticks, %lu with a different decision\n", (unsigned long)count, differences);
+    return differences || a.size() != b.size() ? 2 : 0;
+}
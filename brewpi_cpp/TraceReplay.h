@@ -0,0 +1,82 @@
+/*
+ * Copyright 2013 BrewPi/Elco Jacobs.
+ * Copyright 2013 Matthew McGowan.
+ *
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "ChamberController.h"
+#include "TraceRecorder.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+/**
+ * Runs the control loop of this build on the sensor values and door states of a recorded trace, as fast as the CPU
+ * allows. Settings changes in the trace are applied when they occur, the constants are the defaults of this build
+ * unless changed before start(). The sensor filters start at the first recorded value, so a trace from a fresh start
+ * replays exactly, while a trace taken from a running controller can differ until the filters have settled.
+ */
+class TraceReplay : public ChamberController
+{
+public:
+    /**
+     * Initializes the controller and its filters with the inputs and settings of the first record.
+     */
+    void start(const TraceRecord& first);
+
+    /**
+     * Feeds the inputs of a record to the controller and runs one control tick at the recorded time.
+     */
+    void replay(const TraceRecord& input);
+
+    /**
+     * Replays a whole trace, recording every tick to output when not NULL.
+     * When log is not NULL, the first maxLogged ticks where this build decides differently from the trace are
+     * written to it.
+     * @return the number of ticks with a different decision.
+     */
+    unsigned long run(TraceReader& trace, TraceRecorder* output = NULL, FILE* log = NULL,
+        unsigned long maxLogged = ULONG_MAX);
+
+    /**
+     * Decisions are the control state and the actuator outputs. The door is an input.
+     */
+    static bool sameDecision(const TraceRecord& a, const TraceRecord& b)
+    {
+        return a.state == b.state && (a.outputs & ~TRACE_DOOR_OPEN) == (b.outputs & ~TRACE_DOOR_OPEN);
+    }
+
+    static void printDecision(FILE* out, const TraceRecord& record);
+
+private:
+    void applySettings(const TraceRecord& record);
+};
+
+/**
+ * Command line entry for --replay <trace> [-o <output trace>] [-n <max reported ticks>].
+ * Reports the ticks where this build decides differently from the recorded one.
+ */
+int runReplay(int argc, const char* argv[]);
+
+/**
+ * Command line entry for --compare <trace> <trace> [-n <max reported ticks>].
+ * Reports the ticks where the decisions in two traces differ, e.g. the replay output of two builds.
+ */
+int runCompare(int argc, const char* argv[]);
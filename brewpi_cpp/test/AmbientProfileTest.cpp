@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+#include "AmbientProfile.h"
+#include "SimulatedChamber.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* profilePath = "AmbientProfileTest.csv";
+static const char* tracePath = "AmbientProfileTest.trace";
+
+TEST(AmbientProfileTest, interpolatesTextSamples) {
+    FILE* f = fopen(profilePath, "w");
+    ASSERT_TRUE(f != NULL);
+    fprintf(f, "time,room\n# weekend setback\n0,20\n3600; 14\n7200 14\n\n10800,\t20\n");
+    fclose(f);
+
+    AmbientProfile profile;
+    ASSERT_TRUE(profile.open(profilePath));
+    EXPECT_EQ(20.0, profile.roomTemp(0));
+    EXPECT_NEAR(17.0, profile.roomTemp(1800), 1e-9);
+    EXPECT_NEAR(14.0, profile.roomTemp(5000), 1e-9);
+    EXPECT_NEAR(16.0, profile.roomTemp(7200 + 1200), 1e-9);
+    EXPECT_EQ(20.0, profile.roomTemp(100000)) << "the last value holds";
+    // going back reads from the start again
+    EXPECT_NEAR(19.0, profile.roomTemp(600), 1e-9);
+
+    // the simulator takes the room temperature from the profile
+    SimulatedChamber chamber;
+    Simulator& sim = chamber.getSimulator();
+    sim.setRoomTempSource(&profile);
+    sim.step(1800);
+    EXPECT_NEAR(17.0, sim.roomTemp(), 1e-9);
+    sim.setRoomTempSource(NULL);
+    EXPECT_NEAR(dailyRoomTemp(sim.getMinRoomTemp(), sim.getMaxRoomTemp(), 1800), sim.roomTemp(), 1e-9);
+    remove(profilePath);
+}
+
+TEST(AmbientProfileTest, readsRoomSensorOfTrace) {
+    FILE* f = fopen(tracePath, "wb");
+    ASSERT_TRUE(f != NULL);
+    TraceHeader header;
+    memcpy(header.magic, "BPTR", 4);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, f);
+    TraceRecord record;
+    memset(&record, 0, sizeof(record));
+    double temps[] = { 10.0, 12.0, -100, 16.0 };
+    for (int i = 0; i < 4; i++) {
+        record.time = 5000 + i*60000;       // a minute apart, starting at 5 s
+        record.roomRaw = temps[i] < -50 ? INVALID_TEMP : intToTemp(int(temps[i]));
+        fwrite(&record, sizeof(record), 1, f);
+    }
+    fclose(f);
+
+    AmbientProfile profile;
+    ASSERT_TRUE(profile.open(tracePath));
+    EXPECT_EQ(10.0, profile.roomTemp(0));
+    EXPECT_NEAR(11.0, profile.roomTemp(30), 1e-9);
+    // the record without a room sensor value is skipped
+    EXPECT_NEAR(14.0, profile.roomTemp(120), 1e-9);
+    EXPECT_EQ(16.0, profile.roomTemp(3600));
+    profile.close();
+    remove(tracePath);
+}
+
+TEST(AmbientProfileTest, missingFileFails) {
+    AmbientProfile profile;
+    EXPECT_FALSE(profile.open("AmbientProfileTest.missing"));
+    EXPECT_EQ(0.0, profile.roomTemp(0));
+}
@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+#include "Autotuner.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static TuningScenario shortScenario()
+{
+    TuningScenario scenario;
+    scenario.days = 1;
+    scenario.setting = 18.0;
+    scenario.startTemp = 20.0;
+    return scenario;
+}
+
+TEST(AutotunerTest, gridCoversAllCombinations) {
+    Autotuner tuner(shortScenario());
+    TuningRange kp = { "Kp", 5, 20, 4 };
+    TuningRange filter = { "beerSlowFilt", 2, 4, 3 };
+    ASSERT_TRUE(tuner.addRange(kp));
+    ASSERT_TRUE(tuner.addRange(filter));
+    std::vector<ControlConstants> points = tuner.gridPoints();
+    ASSERT_EQ(12u, points.size());
+    EXPECT_EQ(intToTempDiff(5), points[0].Kp);
+    EXPECT_EQ(intToTempDiff(10), points[1].Kp);
+    EXPECT_EQ(intToTempDiff(20), points[11].Kp);
+    EXPECT_EQ(2, points[0].beerSlowFilter);
+    EXPECT_EQ(4, points[11].beerSlowFilter);
+    EXPECT_EQ(TempControl::ccDefaults.Ki, points[5].Ki) << "constants not searched keep their default";
+}
+
+TEST(AutotunerTest, rejectsUnknownKeys) {
+    Autotuner tuner(shortScenario());
+    TuningRange range = { "beerSet", 10, 20, 2 };
+    EXPECT_FALSE(tuner.addRange(range));
+}
+
+TEST(AutotunerTest, resultsAreRankedByScore) {
+    Autotuner tuner(shortScenario());
+    TuningRange kp = { "Kp", 2, 20, 3 };
+    tuner.addRange(kp);
+    std::vector<TuningResult> results = tuner.run(tuner.randomPoints(4, 7), 2);
+    ASSERT_EQ(4u, results.size());
+    for (unsigned int i=1; i<results.size(); i++)
+        EXPECT_LE(results[i-1].score, results[i].score);
+    for (const TuningResult& result : results) {
+        EXPECT_GT(result.coolCycles, 0u) << "cooling from 20 to 18 needs the compressor";
+        EXPECT_LT(result.settlingTime, 24*3600ul);
+        TuningResult again = tuner.evaluate(result.cc);
+        EXPECT_EQ(result.score, again.score) << "evaluation is deterministic";
+    }
+}
+
+TEST(AutotunerTest, printsPiLinkCommand) {
+    Autotuner tuner(shortScenario());
+    TuningRange kp = { "Kp", 5, 5, 1 };
+    TuningRange idle = { "idleRangeH", 0.5, 0.5, 1 };
+    TuningRange filter = { "beerSlopeFilt", 3, 3, 1 };
+    tuner.addRange(kp);
+    tuner.addRange(idle);
+    tuner.addRange(filter);
+    char buf[100] = { 0 };
+    FILE* out = fmemopen(buf, sizeof(buf), "w");
+    tuner.printJson(out, tuner.gridPoints().front());
+    fclose(out);
+    EXPECT_STREQ("j{\"Kp\":5.000,\"idleRangeH\":0.500,\"beerSlopeFilt\":3}\n", buf);
+}
@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+#include "ChamberBatch.h"
+#include "SimulatedChamber.h"
+
+static std::vector<ChamberVariant> makeVariants(unsigned int count) {
+    std::vector<ChamberVariant> variants(count);
+    for (unsigned int i=0; i<count; i++) {
+        variants[i].fridgeVolume = 100 + 50*i;
+        variants[i].beerVolume = 10 + 5*i;
+        variants[i].heatPower = 20 + i;
+        variants[i].coolPower = 50 + 3*i;
+        variants[i].Ke = 1 + 0.2*i;
+        variants[i].Kb = 2 + 0.5*i;
+    }
+    return variants;
+}
+
+TEST(ChamberBatchTest, lanesMatchSimulator) {
+    const unsigned int count = 7;   // not a multiple of the vector width
+    std::vector<ChamberVariant> variants = makeVariants(count);
+    ChamberBatch batch(variants);
+    for (unsigned int i=0; i<count; i++)
+        batch.setTemperatures(i, 25.0, 20.0);
+    for (int t=0; t<3600; t++)
+        batch.step(15.0, 0);
+
+    for (unsigned int i=0; i<count; i++) {
+        SimulatedChamber chamber;
+        Simulator& sim = chamber.getSimulator();
+        sim.setFridgeVolume(variants[i].fridgeVolume);
+        sim.setBeerVolume(variants[i].beerVolume);
+        sim.setRoomCoefficient(variants[i].Ke);
+        sim.setBeerCoefficient(variants[i].Kb);
+        sim.setMinRoomTemp(15.0);
+        sim.setMaxRoomTemp(15.0);
+        sim.setFermentMaxPowerOutput(0);
+        sim.setFridgeTemp(25.0);
+        sim.setBeerTemp(20.0);
+        sim.step(3600);
+        EXPECT_NEAR(sim.getFridgeTemp(), batch.getFridgeTemp(i), 1e-9) << "lane " << i;
+        EXPECT_NEAR(sim.getBeerTemp(), batch.getBeerTemp(i), 1e-9) << "lane " << i;
+    }
+}
+
+TEST(ChamberBatchTest, outputsArePerLane) {
+    std::vector<ChamberVariant> variants(5);
+    ChamberBatch batch(variants);
+    for (unsigned int i=0; i<variants.size(); i++)
+        batch.setTemperatures(i, 18.0, 18.0);
+    batch.setOutputs(1, 1.0, 0.0);
+    batch.setOutputs(3, 0.0, 1.0);
+    batch.setStepLength(60);
+    for (int t=0; t<60; t++)
+        batch.step(18.0, 0);
+
+    EXPECT_NEAR(18.0, batch.getFridgeTemp(0), 1e-9);
+    EXPECT_GT(batch.getFridgeTemp(1), 19.0);
+    EXPECT_NEAR(18.0, batch.getFridgeTemp(2), 1e-9);
+    EXPECT_LT(batch.getFridgeTemp(3), 17.0);
+    EXPECT_NEAR(18.0, batch.getFridgeTemp(4), 1e-9);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "SimulatedChamber.h"
+#include "BeerProfile.h"
+#include "EepromAccess.h"
+#include "EepromManager.h"
+
+/*
+ * Chamber set ups shared by the tests.
+ */
+
+// Beer and fridge air at beerTemp, controlling the beer to setting.
+inline void startChamber(SimulatedChamber& chamber, double beerTemp, temperature setting) {
+    chamber.getSimulator().setBeerTemp(beerTemp);
+    chamber.getSimulator().setFridgeTemp(beerTemp);
+    chamber.init();
+    chamber.getControl().setMode(MODE_BEER_CONSTANT);
+    chamber.getControl().setBeerTemp(setting);
+}
+
+// Stores a beer profile of count points as the profile of the chamber and returns its eeprom address.
+inline eptr_t storeProfile(uint8_t chamber, const uint16_t* minutes, const temperature* temps, uint8_t count) {
+    ProfileBlock block;
+    clear((uint8_t*)&block, sizeof(block));
+    block.count = count;
+    for (uint8_t i = 0; i < count; i++) {
+        block.points[i].minutes = minutes[i];
+        block.points[i].temp = temps[i];
+    }
+    eptr_t address = eepromManager.profileOffset(chamber);
+    eepromAccess.writeBlock(address, &block, sizeof(block));
+    return address;
+}
+
+// Controlling the fridge air to fridgeSetting, from the temperatures and room already set in the simulator.
+inline void startFridgeConstant(SimulatedChamber& chamber, double fridgeSetting) {
+    chamber.init();
+    chamber.getControl().setMode(MODE_FRIDGE_CONSTANT);
+    chamber.getControl().setFridgeTemp(doubleToTemp(fridgeSetting));
+}
@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+#include "Ensemble.h"
+#include "Autotuner.h"
+
+TEST(EnsembleTest, latinHypercubeUsesEveryStratumOnce) {
+    EnsembleRanges ranges;
+    const unsigned int count = 10;
+    std::vector<EnsembleMember> members = latinHypercube(ranges, count, 3);
+    ASSERT_EQ(count, members.size());
+    std::vector<int> strata(count, 0);
+    for (const EnsembleMember& member : members) {
+        double u = (member.chamber.Ke - ranges.Ke.low)/(ranges.Ke.high - ranges.Ke.low);
+        ASSERT_GE(u, 0);
+        ASSERT_LT(u, 1);
+        strata[int(u*count)]++;
+        EXPECT_GE(member.sensorNoise, ranges.sensorNoise.low);
+        EXPECT_LE(member.sensorNoise, ranges.sensorNoise.high);
+        EXPECT_EQ(ChamberVariant().beerDensity, member.chamber.beerDensity) << "density is not sampled";
+    }
+    for (unsigned int i = 0; i < count; i++)
+        EXPECT_EQ(1, strata[i]) << "stratum " << i;
+
+    std::vector<EnsembleMember> again = latinHypercube(ranges, count, 3);
+    for (unsigned int i = 0; i < count; i++)
+        EXPECT_EQ(members[i].chamber.coolPower, again[i].chamber.coolPower) << "same seed, same sample";
+}
+
+TEST(EnsembleTest, percentileInterpolatesBetweenSortedValues) {
+    std::vector<double> values = { 4, 1, 3, 2, 5 };
+    EXPECT_EQ(1, percentile(values, 0));
+    EXPECT_EQ(3, percentile(values, 50));
+    EXPECT_EQ(5, percentile(values, 100));
+    EXPECT_DOUBLE_EQ(4.8, percentile(values, 95));
+    EXPECT_EQ(0, percentile(std::vector<double>(), 50));
+}
+
+TEST(EnsembleTest, ensembleJudgesByPercentileOfMembers) {
+    TuningScenario scenario;
+    scenario.days = 1;
+    scenario.setting = 18.0;
+    scenario.startTemp = 20.0;
+    Autotuner tuner(scenario);
+    TuningRange kp = { "Kp", 5, 5, 1 };
+    tuner.addRange(kp);
+    ControlConstants cc = tuner.gridPoints().front();
+
+    std::vector<EnsembleMember> members = latinHypercube(EnsembleRanges(), 4, 1);
+    tuner.setEnsemble(members, 100);
+    std::vector<TuningResult> memberResults = tuner.evaluateEnsemble(cc, 2);
+    ASSERT_EQ(4u, memberResults.size());
+    double worst = 0;
+    for (unsigned int m = 0; m < members.size(); m++) {
+        EXPECT_EQ(tuner.evaluate(cc, &members[m]).score, memberResults[m].score) << "members run in order";
+        worst = memberResults[m].score > worst ? memberResults[m].score : worst;
+    }
+
+    std::vector<TuningResult> results = tuner.run(std::vector<ControlConstants>(1, cc), 2);
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(worst, results[0].score) << "100th percentile is the worst member";
+
+    EnsembleSummary summary = summarize(memberResults, scenario.days);
+    EXPECT_LE(summary.overshoot[0], summary.overshoot[1]);
+    EXPECT_LE(summary.coolCyclesPerDay[0], summary.coolCyclesPerDay[1]);
+    EXPECT_GT(summary.coolCyclesPerDay[1], 0) << "cooling from 20 to 18 needs the compressor";
+}
@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "GlycolChiller.h"
+#include "ChamberFixtures.h"
+
+// Fridge constant from 20 degrees, in a room held at 15 degrees and without fermentation heat.
+static void coolInSteadyRoomWithoutFermentation(SimulatedChamber& chamber, double fridgeSetting) {
+    Simulator& sim = chamber.getSimulator();
+    sim.setMinRoomTemp(15.0);
+    sim.setMaxRoomTemp(15.0);
+    sim.setFermentMaxPowerOutput(0);
+    sim.setFridgeTemp(20.0);
+    sim.setBeerTemp(20.0);
+    startFridgeConstant(chamber, fridgeSetting);
+}
+
+TEST(GlycolChillerTest, reservoirTakesTheHeatOfTheChambers) {
+    SimulatedChamber chambers[3];
+    GlycolChiller chiller(50, 0, -2.0);
+    chiller.setRoom(15.0, 0);
+    for (SimulatedChamber& chamber : chambers) {
+        coolInSteadyRoomWithoutFermentation(chamber, 4.0);
+        chiller.add(chamber);
+    }
+    chiller.run(3*3600);
+
+    double heat = 0;
+    for (SimulatedChamber& chamber : chambers) {
+        heat += chamber.getSimulator().getCoolHeat();
+        EXPECT_LT(chamber.getSimulator().getFridgeTemp(), 15.0);
+    }
+    EXPECT_GT(heat, 0);
+    EXPECT_NEAR(-2.0 + heat/(50*1000*VOL_HC_GLYCOL), chiller.getTemp(), 1e-6);
+    EXPECT_EQ(0.0, chiller.getChillerEnergy());
+}
+
+TEST(GlycolChillerTest, limitedValvesMakeChambersWait) {
+    SimulatedChamber free[4], limited[4];
+    GlycolChiller freeChiller, limitedChiller;
+    limitedChiller.setStrategy(VALVES_FIRST_COME, 1);
+    for (int i = 0; i < 4; i++) {
+        coolInSteadyRoomWithoutFermentation(free[i], 4.0);
+        coolInSteadyRoomWithoutFermentation(limited[i], 4.0);
+        freeChiller.add(free[i]);
+        limitedChiller.add(limited[i]);
+    }
+    for (int t = 0; t < 2*3600; t++) {
+        freeChiller.step();
+        limitedChiller.step();
+        ASSERT_LE(limitedChiller.getOpenValves(), 1u);
+    }
+    EXPECT_EQ(4u, freeChiller.getMaxOpenValves());
+    EXPECT_EQ(1u, limitedChiller.getMaxOpenValves());
+
+    double freeTemp = 0, limitedTemp = 0;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(0u, freeChiller.getWaitTime(i));
+        freeTemp += free[i].getSimulator().getFridgeTemp();
+        limitedTemp += limited[i].getSimulator().getFridgeTemp();
+    }
+    EXPECT_GT(limitedTemp, freeTemp + 4*1.0) << "waiting chambers cool down later";
+    // the first chamber got the valve first, the others waited for it
+    EXPECT_EQ(0u, limitedChiller.getWaitTime(0));
+    EXPECT_GT(limitedChiller.getWaitTime(3), 0u);
+}
@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+#include "Scenario.h"
+#include "SimulatedChamber.h"
+
+TEST(ScenarioTest, parsesEventsInTimeOrder) {
+    Scenario scenario;
+    EXPECT_TRUE(scenario.parseLine("# comment only"));
+    EXPECT_TRUE(scenario.parseLine(""));
+    EXPECT_TRUE(scenario.parseLine("2d5m30s d 1  # door"));
+    EXPECT_TRUE(scenario.parseLine("36h beerSet 18.5"));
+    EXPECT_TRUE(scenario.parseLine("0 mode f"));
+    EXPECT_TRUE(scenario.parseLine("1.5h fp 12"));
+
+    const std::vector<ScenarioEvent>& events = scenario.getEvents();
+    ASSERT_EQ(4u, events.size());
+    EXPECT_EQ(0u, events[0].time);
+    EXPECT_EQ(SCENARIO_MODE, events[0].action);
+    EXPECT_EQ('f', char(events[0].value));
+    EXPECT_EQ(5400u, events[1].time);
+    EXPECT_EQ(SCENARIO_FERMENT_POWER, events[1].action);
+    EXPECT_EQ(36*3600u, events[2].time);
+    EXPECT_EQ(18.5, events[2].value);
+    EXPECT_EQ(2*24*3600u + 5*60 + 30, events[3].time);
+    EXPECT_EQ(SCENARIO_DOOR, events[3].action);
+}
+
+TEST(ScenarioTest, rejectsInvalidLines) {
+    Scenario scenario;
+    EXPECT_FALSE(scenario.parseLine("10 unknown 1"));
+    EXPECT_FALSE(scenario.parseLine("10 mode x"));
+    EXPECT_FALSE(scenario.parseLine("10x beerSet 18"));
+    EXPECT_FALSE(scenario.parseLine("10 beerSet"));
+    EXPECT_FALSE(scenario.parseLine("10 beerSet 18 19"));
+    EXPECT_FALSE(scenario.parseLine("10 beerSet warm"));
+    EXPECT_TRUE(scenario.getEvents().empty());
+}
+
+TEST(ScenarioTest, eventsAreAppliedAtTheirTime) {
+    Scenario scenario;
+    scenario.parseLine("0 mode b");
+    scenario.parseLine("0 beerSet 20");
+    scenario.parseLine("10h beerSet 16");
+    scenario.parseLine("20h d 1");
+    scenario.parseLine("20h10m d 0");
+    scenario.parseLine("22h bc 0");
+
+    SimulatedChamber chamber;
+    chamber.getSimulator().setBeerTemp(20.0);
+    chamber.getSimulator().setFridgeTemp(20.0);
+    chamber.init();
+
+    scenario.run(chamber, 0, 10*3600);
+    EXPECT_EQ(MODE_BEER_CONSTANT, chamber.getControl().getMode());
+    EXPECT_EQ(intToTemp(20), chamber.getControl().getBeerSetting());
+    scenario.run(chamber, 10*3600, 20*3600 + 60);
+    EXPECT_EQ(intToTemp(16), chamber.getControl().getBeerSetting());
+    EXPECT_LT(chamber.getSimulator().getBeerTemp(), 18.0);
+    EXPECT_TRUE(chamber.getControl().isDoorOpen());
+    EXPECT_TRUE(chamber.getSimulator().doorState());
+    scenario.run(chamber, 20*3600 + 60, 22*3600 + 60);
+    EXPECT_FALSE(chamber.getControl().isDoorOpen());
+    EXPECT_FALSE(chamber.getControl().beerSensor->isConnected());
+}
+
+TEST(ScenarioTest, randomDoorOpeningsAreSeeded) {
+    Scenario a, b, c;
+    unsigned long days = 100;
+    unsigned int openings = a.addDoorOpenings(10, 30, 0, days*24*3600, 1);
+    EXPECT_NEAR(10.0*days, openings, 100);
+    EXPECT_EQ(openings, b.addDoorOpenings(10, 30, 0, days*24*3600, 1));
+    c.addDoorOpenings(10, 30, 0, days*24*3600, 2);
+
+    const std::vector<ScenarioEvent>& events = a.getEvents();
+    ASSERT_EQ(2*openings, events.size());
+    double openTime = 0;
+    for (unsigned int i = 0; i < events.size(); i += 2) {
+        EXPECT_EQ(SCENARIO_DOOR, events[i].action);
+        EXPECT_EQ(1, events[i].value);
+        EXPECT_EQ(0, events[i+1].value);
+        EXPECT_GT(events[i+1].time, events[i].time);
+        openTime += events[i+1].time - events[i].time;
+        EXPECT_EQ(events[i].time, b.getEvents()[i].time);
+    }
+    EXPECT_NEAR(30, openTime/openings, 3);
+    EXPECT_NE(events[0].time, c.getEvents()[0].time);
+}
@@ -0,0 +1,181 @@
+#include "gtest/gtest.h"
+#include "SimulatedChamber.h"
+#include "ChamberFixtures.h"
+#include "SimulationPool.h"
+#include "EepromManager.h"
+
+TEST(SimulatedChamberTest, chamberHasOwnClock) {
+    SimulatedChamber chamber;
+    startChamber(chamber, 22.0, intToTemp(18));
+    ticks_millis_t globalTime = ticks.millis();
+    chamber.run(100);
+    EXPECT_EQ(100000u, chamber.getTicks().millis());
+    EXPECT_EQ(globalTime, ticks.millis()) << "Running a chamber should not advance the global clock";
+}
+
+TEST(SimulatedChamberTest, chambersDoNotShareState) {
+    SimulatedChamber warm, cold;
+    startChamber(warm, 22.0, intToTemp(24));
+    startChamber(cold, 22.0, intToTemp(10));
+    warm.run(3600);
+    cold.run(3600);
+    EXPECT_GT(warm.getSimulator().getBeerTemp(), 22.0);
+    EXPECT_LT(cold.getSimulator().getBeerTemp(), 22.0);
+    EXPECT_EQ(intToTemp(24), warm.getControl().getBeerSetting());
+    EXPECT_EQ(intToTemp(10), cold.getControl().getBeerSetting());
+}
+
+TEST(SimulatedChamberTest, parallelRunMatchesSequentialRun) {
+    const unsigned int count = 8;
+    SimulatedChamber sequential[count], parallel[count];
+    for (unsigned int i=0; i<count; i++) {
+        startChamber(sequential[i], 20.0, intToTemp(12+i));
+        startChamber(parallel[i], 20.0, intToTemp(12+i));
+        sequential[i].run(4*3600);
+    }
+    SimulationPool pool(4);
+    pool.run(count, [&](unsigned int i) { parallel[i].run(4*3600); });
+    for (unsigned int i=0; i<count; i++) {
+        EXPECT_EQ(sequential[i].getSimulator().getBeerTemp(), parallel[i].getSimulator().getBeerTemp()) << "chamber " << i;
+        EXPECT_EQ(sequential[i].getControl().getState(), parallel[i].getControl().getState()) << "chamber " << i;
+    }
+}
+
+TEST(SimulatedChamberTest, eventSteppingFollowsFixedStepping) {
+    SimulatedChamber fixed, events;
+    startChamber(fixed, 20.0, intToTemp(18));
+    startChamber(events, 20.0, intToTemp(18));
+    fixed.run(3*24*3600);
+    events.runEvents(3*24*3600);
+    EXPECT_EQ(fixed.getTicks().millis(), events.getTicks().millis());
+    EXPECT_NEAR(fixed.getSimulator().getBeerTemp(), events.getSimulator().getBeerTemp(), 0.1);
+    EXPECT_LT(events.getControlTicks(), fixed.getControlTicks()/2) << "idle periods should be skipped";
+}
+
+// Wh, as the script computes it from the on-time in the T message
+static double meteredHeatEnergy(TempControl& control) {
+    return control.getHeaterOnTime()*control.cc.heaterPower/3600.0;
+}
+
+static double meteredCoolEnergy(TempControl& control) {
+    return control.getCoolerOnTime()*control.cc.coolerPower/3600.0;
+}
+
+TEST(SimulatedChamberTest, meteredEnergyMatchesSimulatedEnergy) {
+    SimulatedChamber fixed, events;
+    startChamber(fixed, 20.0, intToTemp(10));
+    startChamber(events, 20.0, intToTemp(10));
+    fixed.run(24*3600);
+    events.runEvents(24*3600);
+
+    // the controller meters the last second at its next update
+    const double tolerance = 60/3600.0;
+    Simulator& simulator = fixed.getSimulator();
+    EXPECT_GT(simulator.getCoolEnergy(), 0);
+    EXPECT_NEAR(simulator.getCoolEnergy(), meteredCoolEnergy(fixed.getControl()), tolerance);
+    EXPECT_NEAR(simulator.getHeatEnergy(), meteredHeatEnergy(fixed.getControl()), tolerance);
+    // skipped ticks are metered too
+    EXPECT_NEAR(events.getSimulator().getCoolEnergy(), meteredCoolEnergy(events.getControl()), tolerance);
+    EXPECT_NEAR(events.getSimulator().getHeatEnergy(), meteredHeatEnergy(events.getControl()), tolerance);
+}
+
+static void expectSameControl(TempControl& incremental, TempControl& full, unsigned long second) {
+    ASSERT_EQ(full.getState(), incremental.getState()) << "at second " << second;
+    ASSERT_EQ(full.getWaitTime(), incremental.getWaitTime()) << "at second " << second;
+    ASSERT_EQ(0, memcmp(&full.cs, &incremental.cs, sizeof(ControlSettings))) << "at second " << second;
+    ASSERT_EQ(0, memcmp(&full.cv, &incremental.cv, sizeof(ControlVariables))) << "at second " << second;
+    ASSERT_EQ(full.timeSinceIdle(), incremental.timeSinceIdle()) << "at second " << second;
+    ASSERT_EQ(full.timeSinceCooling(), incremental.timeSinceCooling()) << "at second " << second;
+    ASSERT_EQ(full.timeSinceHeating(), incremental.timeSinceHeating()) << "at second " << second;
+}
+
+TEST(SimulatedChamberTest, incrementalControlMatchesFullEvaluation) {
+    SimulatedChamber incremental, full;
+    startChamber(incremental, 20.0, intToTemp(18));
+    startChamber(full, 20.0, intToTemp(18));
+    SimulatedChamber* chambers[2] = { &incremental, &full };
+
+    // cool, heat, hold the fridge, open the door and switch off, each for a while
+    const unsigned long phase = 12*3600;
+    for (unsigned long second = 0; second < 6*phase; second++) {
+        for (SimulatedChamber* chamber : chambers) {
+            TempControl& control = chamber->getControl();
+            if (second == phase) {
+                control.setBeerTemp(intToTemp(12));
+            } else if (second == 2*phase) {
+                control.setBeerTemp(intToTemp(22));
+            } else if (second == 3*phase) {
+                control.setMode(MODE_FRIDGE_CONSTANT);
+                control.setFridgeTemp(intToTemp(5));
+            } else if (second == 4*phase || second == 4*phase + 600) {
+                chamber->setDoorOpen(second == 4*phase);
+            } else if (second == 5*phase) {
+                control.setMode(MODE_OFF);
+            }
+        }
+        full.getControl().forceUpdate();
+        incremental.step();
+        full.step();
+        ASSERT_NO_FATAL_FAILURE(expectSameControl(incremental.getControl(), full.getControl(), second));
+    }
+    EXPECT_EQ(full.getSimulator().getBeerTemp(), incremental.getSimulator().getBeerTemp());
+    EXPECT_EQ(full.getSimulator().getCoolEnergy(), incremental.getSimulator().getCoolEnergy());
+}
+
+/*
+ * Simulated milliseconds from the fridge air rising above the idle range to the controller leaving idle, with the
+ * room warming the fridge air and the cooler not yet allowed to run.
+ */
+static unsigned long fridgeDetectionLatency(uint16_t tickMillis) {
+    SimulatedChamber chamber;
+    Simulator& simulator = chamber.getSimulator();
+    simulator.setMinRoomTemp(30.0);
+    simulator.setMaxRoomTemp(30.0);
+    chamber.setTickTime(tickMillis);
+    startChamber(chamber, 20.0, intToTemp(20));
+    TempControl& control = chamber.getControl();
+    control.setMode(MODE_FRIDGE_CONSTANT);
+    control.setFridgeTemp(intToTemp(20));
+
+    double threshold = 20.0 + double(control.cc.idleRangeHigh)/TEMP_FIXED_POINT_SCALE;
+    unsigned long crossed = 0;
+    while (control.getState() == IDLE && chamber.getTicks().millis() < 3600000u) {
+        chamber.step();
+        if (!crossed && simulator.getFridgeTemp() > threshold) {
+            crossed = chamber.getTicks().millis();
+        }
+    }
+    EXPECT_NE(0u, crossed);
+    return chamber.getTicks().millis() - crossed;
+}
+
+TEST(SimulatedChamberTest, shorterTickDetectsFridgeChangesSooner) {
+    unsigned long second = fridgeDetectionLatency(1000);
+    unsigned long quarter = fridgeDetectionLatency(250);
+    EXPECT_LT(quarter, second*3/4) << "1000 ms tick: " << second << " ms, 250 ms tick: " << quarter << " ms";
+}
+
+TEST(SimulatedChamberTest, tickTimeIsKeptInRange) {
+    SimulatedChamber chamber;
+    chamber.setTickTime(0);
+    EXPECT_EQ(MIN_TICK_MILLIS, chamber.getControl().getTickTime());
+    chamber.setTickTime(5000);
+    EXPECT_EQ(MAX_TICK_MILLIS, chamber.getControl().getTickTime());
+}
+
+TEST(SimulatedChamberTest, beerFollowsStoredProfile) {
+    // hold 20 for a day, then ramp to 22 in a day
+    const uint16_t minutes[] = { 0, 1440, 2880 };
+    const temperature temps[] = { intToTemp(20), intToTemp(20), intToTemp(22) };
+    eptr_t address = storeProfile(1, minutes, temps, 3);
+
+    SimulatedChamber chamber;
+    startChamber(chamber, 20.0, intToTemp(20));
+    TempControl& control = chamber.getControl();
+    control.setMode(MODE_BEER_PROFILE);
+    control.loadProfile(address);
+    chamber.run(36*3600);
+    EXPECT_EQ(1, control.profile.getSegment());
+    EXPECT_NEAR(intToTemp(21), control.getBeerSetting(), intToTempDiff(1)/100);
+    EXPECT_NEAR(21.0, chamber.getSimulator().getBeerTemp(), 0.3);
+}
@@ -0,0 +1,258 @@
+#include "gtest/gtest.h"
+#include "SimulatedChamber.h"
+#include "ChamberFixtures.h"
+
+static Simulator& constantRoom(SimulatedChamber& chamber) {
+    Simulator& sim = chamber.getSimulator();
+    sim.setMinRoomTemp(15.0);
+    sim.setMaxRoomTemp(15.0);
+    sim.setFermentMaxPowerOutput(0);
+    sim.setFridgeTemp(25.0);
+    sim.setBeerTemp(20.0);
+    return sim;
+}
+
+TEST(SimulatorTest, longStepEqualsManyShortSteps) {
+    SimulatedChamber shortSteps, longStep;
+    Simulator& a = constantRoom(shortSteps);
+    Simulator& b = constantRoom(longStep);
+    for (int i=0; i<600; i++)
+        a.step();
+    b.step(600);
+    EXPECT_NEAR(a.getFridgeTemp(), b.getFridgeTemp(), 1e-9);
+    EXPECT_NEAR(a.getBeerTemp(), b.getBeerTemp(), 1e-9);
+}
+
+TEST(SimulatorTest, matchesEulerIntegrationForSmallSteps) {
+    SimulatedChamber chamber;
+    Simulator& sim = constantRoom(chamber);
+    double cf = 400*1000*VOL_HC_AIR + 1000, cb = 20*1.060*1000*MASS_HC_WATER;
+    double ke = sim.getRoomCoefficient(), kb = sim.getBeerCoefficient();
+    double fridge = 25.0, beer = 20.0;
+    for (int i=0; i<3600*10; i++) {
+        double toBeer = kb*(fridge-beer);
+        fridge += (ke*(15.0-fridge) - toBeer)/cf/10;
+        beer += toBeer/cb/10;
+    }
+    sim.step(3600);
+    EXPECT_NEAR(fridge, sim.getFridgeTemp(), 1e-3);
+    EXPECT_NEAR(beer, sim.getBeerTemp(), 1e-3);
+}
+
+TEST(SimulatorTest, settlesAtRoomTemperature) {
+    SimulatedChamber chamber;
+    Simulator& sim = constantRoom(chamber);
+    sim.step(100*24*3600UL);
+    EXPECT_NEAR(15.0, sim.getFridgeTemp(), 1e-6);
+    EXPECT_NEAR(15.0, sim.getBeerTemp(), 1e-6);
+}
+
+TEST(SimulatorTest, actuatorLagLongStepEqualsManyShortSteps) {
+    ActuatorLag shortSteps, longStep;
+    shortSteps.tau1 = longStep.tau1 = 60;
+    shortSteps.tau2 = longStep.tau2 = 200;
+    double sum = 0;
+    for (int i=0; i<300; i++)
+        sum += shortSteps.step(true, 1);
+    EXPECT_NEAR(sum/300, longStep.step(true, 300), 1e-9);
+    EXPECT_NEAR(shortSteps.stage2, longStep.stage2, 1e-9);
+
+    // equal time constants and a single stage have their own solutions
+    shortSteps.tau1 = longStep.tau1 = 200;
+    sum = 0;
+    for (int i=0; i<300; i++)
+        sum += shortSteps.step(false, 1);
+    EXPECT_NEAR(sum/300, longStep.step(false, 300), 1e-9);
+    EXPECT_NEAR(shortSteps.stage2, longStep.stage2, 1e-9);
+
+    shortSteps.tau2 = longStep.tau2 = 0;
+    sum = 0;
+    for (int i=0; i<300; i++)
+        sum += shortSteps.step(true, 1);
+    EXPECT_NEAR(sum/300, longStep.step(true, 300), 1e-9);
+}
+
+TEST(SimulatorTest, coolerLagDelaysAndExtendsCooling) {
+    SimulatedChamber instant, lagging;
+    Simulator& a = constantRoom(instant);
+    Simulator& b = constantRoom(lagging);
+    b.setCoolerLag(60, 300);
+    startFridgeConstant(instant, 4.0);
+    startFridgeConstant(lagging, 4.0);
+
+    // both run the same until the compressor starts
+    while (!lagging.getControl().stateIsCooling()) {
+        instant.step();
+        lagging.step();
+    }
+    ASSERT_TRUE(instant.getControl().stateIsCooling());
+    instant.run(600);
+    lagging.run(600);
+    EXPECT_GT(b.getFridgeTemp(), a.getFridgeTemp() + 0.5) << "the evaporator takes time to get cold";
+
+    // after switching off, the evaporator keeps cooling for a while
+    while (lagging.getControl().stateIsCooling())
+        lagging.step();
+    double before = b.getFridgeTemp();
+    lagging.run(60);
+    EXPECT_LT(b.getFridgeTemp(), before);
+    EXPECT_GT(b.getCoolEnergy(), 0);
+}
+
+static temperature readBeerSensor(SimulatedChamber& chamber) {
+    return chamber.getControl().beerSensor->sensor().read();
+}
+
+TEST(SimulatorTest, probeThermowellLongStepEqualsManyShortSteps) {
+    SimulatedProbe shortSteps, longStep;
+    shortSteps.wellLag = longStep.wellLag = 120;
+    shortSteps.sample(20.0, 0, 0);
+    longStep.sample(20.0, 0, 0);
+    // the temperature around the probe ramps down by a degree per minute
+    for (int i=1; i<=300; i++)
+        shortSteps.sample(20.0 - i/60.0, 1, 0);
+    longStep.sample(15.0, 300, 0);
+    EXPECT_NEAR(shortSteps.wellTemp, longStep.wellTemp, 1e-9);
+    EXPECT_GT(longStep.wellTemp, 15.0 + 1.0) << "the thermowell lags behind the ramp";
+}
+
+TEST(SimulatorTest, probeReadingIsQuantizedAndConvertedBeforeTheRead) {
+    SimulatedChamber chamber;
+    Simulator& sim = constantRoom(chamber);
+    sim.setSensorModel(true);
+    chamber.init();
+    for (int i=0; i<100; i++) {
+        double before = sim.getBeerTemp();
+        sim.step();
+        double after = sim.getBeerTemp();
+        // sampled when the conversion finished, a quarter second before the end of the step
+        double sampled = after - (after-before)*(1.0-DS18B20_CONVERSION_TIME);
+        temperature read = readBeerSensor(chamber);
+        EXPECT_EQ(0, (read - C_OFFSET) % (TEMP_FIXED_POINT_SCALE/16));
+        EXPECT_NEAR(sampled, double(read - C_OFFSET)/TEMP_FIXED_POINT_SCALE, 1.0/32 + 1e-6);
+    }
+}
+
+TEST(SimulatorTest, stuckProbeAndDropouts) {
+    SimulatedChamber chamber;
+    Simulator& sim = constantRoom(chamber);
+    sim.setSensorModel(true);
+    chamber.init();
+    SimulatedProbe& probe = sim.getBeerProbe();
+
+    probe.stuck = true;
+    temperature stuck = readBeerSensor(chamber);
+    sim.step(3600);
+    EXPECT_EQ(stuck, readBeerSensor(chamber));
+    probe.stuck = false;
+    sim.step();
+    EXPECT_NE(stuck, readBeerSensor(chamber));
+
+    // every read drops out, then the sensor comes back
+    probe.dropoutRate = 1.0;
+    sim.step();
+    EXPECT_EQ(TEMP_SENSOR_DISCONNECTED, readBeerSensor(chamber));
+    probe.dropoutRate = 0;
+    sim.step();
+    EXPECT_NE(TEMP_SENSOR_DISCONNECTED, readBeerSensor(chamber));
+
+    // a disconnected sensor is not reconnected by the model
+    probe.dropoutRate = 0.5;
+    sim.setConnected(chamber.getControl().beerSensor, false);
+    for (int i=0; i<20; i++) {
+        sim.step();
+        EXPECT_EQ(TEMP_SENSOR_DISCONNECTED, readBeerSensor(chamber));
+    }
+    probe.dropoutRate = 0;
+    sim.step();
+    EXPECT_EQ(TEMP_SENSOR_DISCONNECTED, readBeerSensor(chamber));
+
+    // about the given fraction of reads drops out
+    sim.setConnected(chamber.getControl().beerSensor, true);
+    probe.dropoutRate = 0.1;
+    int dropouts = 0;
+    for (int i=0; i<10000; i++) {
+        sim.step();
+        if (readBeerSensor(chamber)==TEMP_SENSOR_DISCONNECTED)
+            dropouts++;
+    }
+    EXPECT_NEAR(1000, dropouts, 100);
+}
+
+TEST(SimulatorTest, fermentCurveInterpolatesPhases) {
+    FermentPhases phases(8, 12, 24, 48);
+    FermentCurve curve;
+    curve.build(phases);
+    EXPECT_NEAR(92*3600.0/(FERMENT_CURVE_POINTS-1), curve.interval, 1e-9);
+    for (int i=0; i<FERMENT_CURVE_POINTS-1; i++) {
+        unsigned long t = (unsigned long)(i*curve.interval + 0.5);
+        EXPECT_NEAR(phases.output(t/3600.0), curve.at(t), 1.0/255) << "point " << i;
+        // linear between the points
+        unsigned long mid = (unsigned long)((i+0.5)*curve.interval);
+        double expected = (curve.points[i] + (mid/curve.interval-i)*(curve.points[i+1]-curve.points[i]))/255;
+        EXPECT_NEAR(expected, curve.at(mid), 1e-9);
+    }
+    EXPECT_EQ(1.0, curve.at(30*3600UL)) << "active phase";
+    EXPECT_EQ(0.0, curve.at(93*3600UL)) << "after the stationary phase";
+}
+
+TEST(SimulatorTest, measuredFermentCurveKeepsItsEnergy) {
+    SimulatedChamber chamber;
+    Simulator& sim = chamber.getSimulator();
+    // a triangle with a peak of 5 W at 10 hours: 50 Wh
+    const double hours[] = { 0, 10, 20 };
+    const double watts[] = { 0, 5, 0 };
+    sim.setFermentCurve(hours, watts, 3);
+    EXPECT_EQ(5.0, sim.getFermentMaxPowerOutput());
+    const FermentCurve& curve = sim.getFermentCurve();
+    double energy = 0;
+    for (unsigned long t=0; t<24*3600UL; t+=60)
+        energy += curve.at(t)*sim.getFermentMaxPowerOutput()*60/3600;
+    EXPECT_NEAR(50.0, energy, 0.5);
+    EXPECT_NEAR(0.5, curve.at(5*3600UL), 1.0/255);
+
+    // an invalid curve gives no output
+    sim.setFermentCurve(hours, watts, 1);
+    EXPECT_EQ(0.0, sim.getFermentMaxPowerOutput());
+    EXPECT_EQ(0.0, sim.getFermentCurve().at(10*3600UL));
+}
+
+TEST(SimulatorTest, openDoorExchangesAirWithTheRoom) {
+    SimulatedChamber closed, open, noExchange;
+    Simulator& a = constantRoom(closed);
+    Simulator& b = constantRoom(open);
+    Simulator& c = constantRoom(noExchange);
+    c.setDoorAirExchange(0);
+    open.setDoorOpen(true);
+    noExchange.setDoorOpen(true);
+    a.step(60);
+    b.step(60);
+    c.step(60);
+    EXPECT_LT(b.getFridgeTemp(), a.getFridgeTemp() - 3.0) << "room air at 15 degrees replaces the fridge air";
+    EXPECT_GT(b.getFridgeTemp(), 15.0);
+    EXPECT_NEAR(a.getFridgeTemp(), c.getFridgeTemp(), 1e-9);
+
+    // still exact for long steps
+    SimulatedChamber shortSteps;
+    Simulator& d = constantRoom(shortSteps);
+    shortSteps.setDoorOpen(true);
+    for (int i=0; i<60; i++)
+        d.step();
+    EXPECT_NEAR(b.getFridgeTemp(), d.getFridgeTemp(), 1e-9);
+}
+
+TEST(SimulatorTest, runFactorPacesFractionalFactorsWithoutDrift) {
+    // 12.5 times real time for 0.4 seconds is 5 simulated seconds
+    ticks_millis_t start = ticks.millis();
+    setRunFactor(long_temperature(12.5*TEMP_FIXED_POINT_SCALE));
+    uint32_t begin = micros();
+    while (micros() - begin < 400000)
+        updateSimulationTicks();
+    setRunFactor(0);
+    ticks_millis_t simulated = ticks.millis() - start;
+    EXPECT_GE(simulated, 4000u);
+    EXPECT_LE(simulated, 5000u);
+
+    updateSimulationTicks();
+    EXPECT_EQ(simulated, ticks.millis() - start) << "a run factor of 0 pauses";
+}
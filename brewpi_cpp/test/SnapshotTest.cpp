@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "SimulatedChamber.h"
+#include "ChamberFixtures.h"
+#include "Snapshot.h"
+#include "EepromAccess.h"
+
+static void expectSameState(SimulatedChamber& a, SimulatedChamber& b) {
+    EXPECT_EQ(a.getSimulator().getBeerTemp(), b.getSimulator().getBeerTemp());
+    EXPECT_EQ(a.getSimulator().getFridgeTemp(), b.getSimulator().getFridgeTemp());
+    EXPECT_EQ(a.getTicks().millis(), b.getTicks().millis());
+    EXPECT_EQ(a.getControl().getState(), b.getControl().getState());
+    EXPECT_EQ(a.getControl().getBeerTemp(), b.getControl().getBeerTemp());
+    EXPECT_EQ(a.getControl().cv.diffIntegral, b.getControl().cv.diffIntegral);
+    EXPECT_EQ(a.getControl().getFridgeSetting(), b.getControl().getFridgeSetting());
+}
+
+TEST(SnapshotTest, forkContinuesLikeOriginal) {
+    SimulatedChamber original, fork;
+    startChamber(original, 22.0, intToTemp(18));
+    original.run(10*3600);
+
+    ChamberSnapshot snapshot;
+    original.save(snapshot);
+    fork.restore(snapshot);
+    expectSameState(original, fork);
+
+    original.run(24*3600);
+    fork.run(24*3600);
+    expectSameState(original, fork);
+}
+
+TEST(SnapshotTest, restoreUndoesDivergentBranch) {
+    SimulatedChamber chamber, reference;
+    startChamber(chamber, 22.0, intToTemp(18));
+    startChamber(reference, 22.0, intToTemp(18));
+    chamber.run(30*3600);
+    reference.run(30*3600);
+
+    ChamberSnapshot snapshot;
+    chamber.save(snapshot);
+    chamber.getControl().setBeerTemp(intToTemp(20));
+    chamber.run(8*3600);
+    EXPECT_GT(chamber.getSimulator().getBeerTemp(), 19.0);
+
+    chamber.restore(snapshot);
+    chamber.run(8*3600);
+    reference.run(8*3600);
+    expectSameState(chamber, reference);
+}
+
+TEST(SnapshotTest, globalSnapshotRestoresClockEepromAndController) {
+    tempControl.init();     // as in setup()
+    SimulationSnapshot snapshot;
+    uint8_t marker = 0x5A;
+    eepromAccess.writeBlock(1000, &marker, 1);
+    temperature setting = tempControl.cs.beerSetting;
+    ticks_millis_t time = ticks.millis();
+    snapshot.save();
+
+    uint8_t other = 0;
+    eepromAccess.writeBlock(1000, &other, 1);
+    tempControl.cs.beerSetting = setting + intToTempDiff(3);
+    ticks.incMillis(5000);
+    simulator.setBeerTemp(simulator.getBeerTemp() + 3);
+    double beerTemp = simulator.getBeerTemp() - 3;
+
+    snapshot.restore();
+    uint8_t restored = 0;
+    eepromAccess.readBlock(&restored, 1000, 1);
+    EXPECT_EQ(marker, restored);
+    EXPECT_EQ(setting, tempControl.cs.beerSetting);
+    EXPECT_EQ(time, ticks.millis());
+    EXPECT_EQ(beerTemp, simulator.getBeerTemp());
+}
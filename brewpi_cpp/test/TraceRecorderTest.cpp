@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "TraceRecorder.h"
+#include "SimulatedChamber.h"
+#include "ChamberFixtures.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* tracePath = "TraceRecorderTest.trace";
+
+TEST(TraceRecorderTest, recordsEveryControlTick) {
+    remove(tracePath);
+    SimulatedChamber chamber;
+    startChamber(chamber, 20.0, intToTemp(18));
+    {
+        TraceRecorder recorder;
+        ASSERT_TRUE(recorder.open(tracePath));
+        chamber.setTraceRecorder(&recorder);
+        chamber.run(3000);     // more than one buffer
+        chamber.setTraceRecorder(NULL);
+    }
+
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(tracePath));
+    ASSERT_EQ(3000u, reader.size());
+    bool cooled = false;
+    for (size_t i=1; i<reader.size(); i++) {
+        EXPECT_EQ(reader[i-1].time + 1000, reader[i].time);
+        cooled |= (reader[i].outputs & TRACE_COOLER) != 0;
+    }
+    EXPECT_TRUE(cooled);
+
+    TempControl& control = chamber.getControl();
+    const TraceRecord& last = reader[reader.size()-1];
+    EXPECT_EQ(control.getBeerTemp(), last.beerFast);
+    EXPECT_EQ(control.getFridgeTemp(), last.fridgeFast);
+    EXPECT_EQ(control.cs.beerSetting, last.beerSetting);
+    EXPECT_EQ(control.cv.diffIntegral, last.diffIntegral);
+    EXPECT_EQ(control.getState(), last.state);
+    EXPECT_EQ(MODE_BEER_CONSTANT, last.mode);
+    reader.close();
+    remove(tracePath);
+}
+
+TEST(TraceRecorderTest, appendsToExistingTrace) {
+    remove(tracePath);
+    SimulatedChamber chamber;
+    startChamber(chamber, 20.0, intToTemp(18));
+    TraceRecorder recorder;
+    chamber.setTraceRecorder(&recorder);
+    ASSERT_TRUE(recorder.open(tracePath));
+    chamber.run(10);
+    recorder.close();
+    ASSERT_TRUE(recorder.open(tracePath));
+    chamber.run(10);
+    recorder.close();
+
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(tracePath));
+    ASSERT_EQ(20u, reader.size());
+    EXPECT_EQ(reader[9].time + 1000, reader[10].time);
+    reader.close();
+    remove(tracePath);
+}
+
+TEST(TraceRecorderTest, appendsAfterPartialRecord) {
+    remove(tracePath);
+    SimulatedChamber chamber;
+    startChamber(chamber, 20.0, intToTemp(18));
+    TraceRecorder recorder;
+    chamber.setTraceRecorder(&recorder);
+    ASSERT_TRUE(recorder.open(tracePath));
+    chamber.run(10);
+    recorder.close();
+
+    // a run killed in the middle of writing a record
+    FILE* f = fopen(tracePath, "ab");
+    TraceRecord half;
+    memset(&half, 0xAA, sizeof(half));
+    fwrite(&half, sizeof(half)/2, 1, f);
+    fclose(f);
+
+    ASSERT_TRUE(recorder.open(tracePath));
+    chamber.run(10);
+    recorder.close();
+
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(tracePath));
+    ASSERT_EQ(20u, reader.size());
+    EXPECT_EQ(reader[9].time + 1000, reader[10].time);
+    EXPECT_EQ(MODE_BEER_CONSTANT, reader[19].mode);
+    reader.close();
+    remove(tracePath);
+}
+
+TEST(TraceRecorderTest, rejectsOtherFiles) {
+    FILE* f = fopen(tracePath, "wb");
+    fputs("T:{\"BeerTemp\":18.00}\n", f);
+    fclose(f);
+    TraceRecorder recorder;
+    EXPECT_FALSE(recorder.open(tracePath));
+    TraceReader reader;
+    EXPECT_FALSE(reader.open(tracePath));
+    remove(tracePath);
+}
@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "TraceReplay.h"
+#include "SimulatedChamber.h"
+
+#include <stdio.h>
+
+static const char* tracePath = "TraceReplayTest.trace";
+
+static void recordChamber(unsigned long seconds)
+{
+    remove(tracePath);
+    SimulatedChamber chamber;
+    chamber.getSimulator().setBeerTemp(22.0);
+    chamber.getSimulator().setFridgeTemp(22.0);
+    chamber.init();
+    chamber.getControl().setMode(MODE_BEER_CONSTANT);
+    chamber.getControl().setBeerTemp(intToTemp(18));
+
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.open(tracePath));
+    chamber.setTraceRecorder(&recorder);
+    chamber.run(seconds/2);
+    chamber.setDoorOpen(true);
+    chamber.run(600);
+    chamber.setDoorOpen(false);
+    chamber.getControl().setBeerTemp(intToTemp(16));
+    chamber.run(seconds/2 - 600);
+    chamber.setTraceRecorder(NULL);
+}
+
+TEST(TraceReplayTest, replayReproducesRecordedDecisions) {
+    recordChamber(2*24*3600);
+    TraceReader trace;
+    ASSERT_TRUE(trace.open(tracePath));
+    ASSERT_EQ(2*24*3600u, trace.size());
+
+    TraceReplay replay;
+    EXPECT_EQ(0u, replay.run(trace));
+    EXPECT_EQ(trace.size(), replay.getControlTicks());
+    EXPECT_EQ(intToTemp(16), replay.getControl().getBeerSetting());
+    trace.close();
+    remove(tracePath);
+}
+
+TEST(TraceReplayTest, replayShowsEffectOfChangedConstants) {
+    recordChamber(24*3600);
+    TraceReader trace;
+    ASSERT_TRUE(trace.open(tracePath));
+
+    TraceReplay replay;
+    replay.start(trace[0]);
+    replay.getControl().cc.Kp = intToTempDiff(2);
+    TraceRecord decision;
+    unsigned long differences = 0;
+    for (size_t i=0; i<trace.size(); i++) {
+        replay.replay(trace[i]);
+        TraceRecorder::capture(replay.getControl(), trace[i].time, decision);
+        differences += !TraceReplay::sameDecision(trace[i], decision);
+    }
+    EXPECT_GT(differences, 0u);
+    trace.close();
+    remove(tracePath);
+}
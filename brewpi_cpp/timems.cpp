@@ -22,9 +22,18 @@
 #include "stdint.h"
 #include "timems.h"
 
+#include <chrono>
+
 static msec_t startupMillis = time_ms();
 
 msec_t millisSinceStartup()
 {
     return time_ms()-startupMillis;
 }
+
+static const std::chrono::steady_clock::time_point startupTime = std::chrono::steady_clock::now();
+
+usec_t microsSinceStartup()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startupTime).count();
+}
@@ -24,4 +24,11 @@ msec_t time_ms(void)
 
 #endif
 
-msec_t millisSinceStartup();
\ No newline at end of file
+msec_t millisSinceStartup();
+
+typedef int64_t usec_t;
+
+/**
+ * Microseconds since startup from a monotonic clock, so it does not jump when the system time is set.
+ */
+usec_t microsSinceStartup();
\ No newline at end of file